@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: MIT
+
+// Timing, statistics and output helpers shared by the benchmark programs.
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CUBE96_BENCH_HAVE_TSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace cube96_bench {
+
+using Clock = std::chrono::steady_clock;
+
+inline double elapsed_ns(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// Time-stamp counter ticks, or 0 where there is none.  The TSC runs at a
+// constant reference rate, so "cycles" below are reference cycles; they match
+// core cycles only with frequency scaling and turbo disabled.
+inline std::uint64_t read_cycles() {
+#if defined(CUBE96_BENCH_HAVE_TSC)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+inline constexpr bool have_cycle_counter() {
+#if defined(CUBE96_BENCH_HAVE_TSC)
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Order statistics of one configuration's samples, by nearest rank.
+struct Summary {
+  std::size_t count = 0;
+  double min = 0.0;
+  double mean = 0.0;
+  double p50 = 0.0;
+  double p99 = 0.0;
+  double p999 = 0.0;
+};
+
+inline Summary summarize(std::vector<double> samples) {
+  Summary s;
+  s.count = samples.size();
+  if (samples.empty()) {
+    return s;
+  }
+  std::sort(samples.begin(), samples.end());
+  auto rank = [&](double q) {
+    const auto i = static_cast<std::size_t>(std::ceil(q * static_cast<double>(samples.size())));
+    return samples[std::min(samples.size(), std::max<std::size_t>(i, 1)) - 1];
+  };
+  double total = 0.0;
+  for (double v : samples) {
+    total += v;
+  }
+  s.min = samples.front();
+  s.mean = total / static_cast<double>(samples.size());
+  s.p50 = rank(0.50);
+  s.p99 = rank(0.99);
+  s.p999 = rank(0.999);
+  return s;
+}
+
+// Parses a byte count with an optional K, M or G (binary) suffix.
+inline bool parse_size(const std::string &text, std::uint64_t &out) {
+  if (text.empty()) {
+    return false;
+  }
+  char *end = nullptr;
+  errno = 0;
+  const unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+  if (end == text.c_str() || errno != 0) {
+    return false;
+  }
+  std::uint64_t scale = 1;
+  const std::string suffix(end);
+  if (suffix == "K" || suffix == "k") {
+    scale = 1ull << 10;
+  } else if (suffix == "M" || suffix == "m") {
+    scale = 1ull << 20;
+  } else if (suffix == "G" || suffix == "g") {
+    scale = 1ull << 30;
+  } else if (!suffix.empty()) {
+    return false;
+  }
+  out = value * scale;
+  return value <= (~0ull) / scale;
+}
+
+inline bool parse_count(const std::string &text, std::uint64_t max, std::uint64_t &out) {
+  char *end = nullptr;
+  errno = 0;
+  const unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+  if (text.empty() || end == text.c_str() || *end != '\0' || errno != 0 || value > max) {
+    return false;
+  }
+  out = value;
+  return true;
+}
+
+inline std::vector<std::string> split_list(const std::string &text) {
+  std::vector<std::string> items;
+  std::stringstream ss(text);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+inline std::string json_escape(const std::string &text) {
+  std::string out;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  return out;
+}
+
+// Six significant digits, with non-finite values as JSON null.
+inline std::string json_number(double value) {
+  if (!std::isfinite(value)) {
+    return "null";
+  }
+  std::ostringstream ss;
+  ss.precision(6);
+  ss << value;
+  return ss.str();
+}
+
+} // namespace cube96_bench
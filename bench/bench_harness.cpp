@@ -0,0 +1,1047 @@
+// SPDX-License-Identifier: MIT
+
+// cube96_bench: sweeps message size, implementation, layout, mode and thread
+// count, and reports ns/block, cycles/byte, per-message latency percentiles
+// and, where Linux perf counters are available, instructions/byte, IPC and
+// miss rates as text, JSON or CSV.  --compare checks a run against an earlier
+// JSON report and fails on regressions.
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_common.hpp"
+#include "bench_perf.hpp"
+#include "cube96/cipher.hpp"
+#include "cube96/ctr.hpp"
+#include "cube96/parallel.hpp"
+#include "cube96/perm.hpp"
+#include "cube96/profile.hpp"
+#if defined(CUBE96_HAVE_FAST_IMPL)
+#include "cube96/impl_dispatch.hpp"
+#include "cube96/sbox.hpp"
+#endif
+
+namespace {
+
+using cube96::CubeCipher;
+using namespace cube96_bench;
+
+constexpr std::size_t kBlock = CubeCipher::BlockBytes;
+constexpr std::uint64_t kMaxMessage = 1ull << 30;
+constexpr int kExitRegression = 2;
+
+enum class Mode { Block, Ecb, EcbDecrypt, Ctr };
+enum class Format { Text, Json, Csv };
+
+const char *mode_name(Mode mode) {
+  switch (mode) {
+  case Mode::Block:
+    return "block";
+  case Mode::Ecb:
+    return "ecb";
+  case Mode::EcbDecrypt:
+    return "ecb-dec";
+  case Mode::Ctr:
+    return "ctr";
+  }
+  return "?";
+}
+
+const char *impl_name(CubeCipher::Impl impl) {
+  return impl == CubeCipher::Impl::Fast ? "fast" : "hardened";
+}
+
+struct Options {
+  std::vector<std::uint64_t> sizes;
+  std::vector<CubeCipher::Impl> impls;
+  std::vector<cube96::Layout> layouts;
+  std::vector<Mode> modes;
+  std::vector<std::size_t> threads{1};
+  std::size_t warmup = 2;
+  std::size_t reps = 0;  // 0: adaptive, see measure()
+  std::size_t min_reps = 10;
+  double min_time_ms = 50.0;
+  std::size_t max_samples = 100000;
+  Format format = Format::Text;
+  std::string output;
+  std::string compare;
+  double threshold = 5.0;  // percent
+  bool micro = false;
+  bool profile = false;
+  bool perf = true;
+};
+
+struct Result {
+  std::string impl;
+  std::string engine;
+  std::string layout;
+  std::string mode;
+  std::size_t threads = 1;
+  std::uint64_t bytes = 0;
+  Summary ns;
+  double cycles_p50 = 0.0;  // per message; 0 without a cycle counter
+  PerfTotals perf;          // per message, single-threaded runs only
+
+  std::string key() const {
+    return impl + "/" + layout + "/" + mode + "/t" + std::to_string(threads) + "/" +
+           std::to_string(bytes);
+  }
+  double blocks() const { return static_cast<double>((bytes + kBlock - 1) / kBlock); }
+  double ns_per_block() const { return ns.p50 / blocks(); }
+  double cycles_per_byte() const {
+    return cycles_p50 > 0.0 ? cycles_p50 / static_cast<double>(bytes) : -1.0;
+  }
+  double mib_per_s() const {
+    return static_cast<double>(bytes) / ns.p50 * 1e9 / (1024.0 * 1024.0);
+  }
+  // Hardware counter ratios, or -1 where a counter is missing.
+  double instructions_per_byte() const {
+    return perf.has(PerfEvent::Instructions)
+               ? perf[PerfEvent::Instructions] / static_cast<double>(bytes)
+               : -1.0;
+  }
+  double ipc() const {
+    return perf.has(PerfEvent::Instructions) && perf.has(PerfEvent::Cycles) &&
+                   perf[PerfEvent::Cycles] > 0.0
+               ? perf[PerfEvent::Instructions] / perf[PerfEvent::Cycles]
+               : -1.0;
+  }
+  double per_block(PerfEvent e) const { return perf.has(e) ? perf[e] / blocks() : -1.0; }
+};
+
+// Runs `op` for `warmup` untimed calls, then times single calls until either
+// `reps` samples exist or, adaptively, at least `min_reps` samples and
+// `min_time_ms` of measurement (capped at `max_samples`).  With `perf`, the
+// hardware counters run around each timed call and are averaged per call.
+template <typename Op>
+void measure(const Options &opts, Op &&op, Result &result, const PerfCounters *perf) {
+  for (std::size_t i = 0; i < opts.warmup; ++i) {
+    op();
+  }
+  std::vector<double> ns;
+  std::vector<double> cycles;
+  if (perf != nullptr) {
+    perf->reset();
+  }
+  const auto start = Clock::now();
+  for (;;) {
+    if (perf != nullptr) {
+      perf->enable();
+    }
+    const auto t0 = Clock::now();
+    const std::uint64_t c0 = read_cycles();
+    op();
+    const std::uint64_t c1 = read_cycles();
+    const auto t1 = Clock::now();
+    if (perf != nullptr) {
+      perf->disable();
+    }
+    ns.push_back(elapsed_ns(t0, t1));
+    cycles.push_back(static_cast<double>(c1 - c0));
+    if (opts.reps != 0) {
+      if (ns.size() >= opts.reps) {
+        break;
+      }
+    } else if (ns.size() >= opts.min_reps &&
+               (elapsed_ns(start, t1) >= opts.min_time_ms * 1e6 ||
+                ns.size() >= opts.max_samples)) {
+      break;
+    }
+  }
+  if (perf != nullptr) {
+    result.perf = perf->read();
+    for (double &v : result.perf.value) {
+      v /= static_cast<double>(ns.size());
+    }
+  }
+  result.ns = summarize(std::move(ns));
+  result.cycles_p50 = have_cycle_counter() ? summarize(std::move(cycles)).p50 : 0.0;
+}
+
+// Fixed-point value, or "-" for a missing one (negative by convention).
+void print_optional(std::ostream &out, int width, double value) {
+  out << std::setw(width);
+  if (value >= 0.0) {
+    out << value;
+  } else {
+    out << "-";
+  }
+}
+
+// The hardware counter columns only appear when perf counters are open.
+void print_text_header(std::ostream &out, bool perf) {
+  out << std::left << std::setw(9) << "impl" << std::setw(9) << "layout" << std::setw(8)
+      << "mode" << std::right << std::setw(4) << "thr" << std::setw(12) << "bytes"
+      << std::setw(8) << "reps" << std::setw(11) << "ns/block" << std::setw(10)
+      << "cyc/byte" << std::setw(10) << "MiB/s" << std::setw(13) << "p50 ns"
+      << std::setw(13) << "p99 ns" << std::setw(13) << "p999 ns";
+  if (perf) {
+    out << std::setw(9) << "ins/B" << std::setw(7) << "IPC" << std::setw(10) << "L1D/blk"
+        << std::setw(10) << "brm/blk";
+  }
+  out << '\n';
+}
+
+void print_text_row(std::ostream &out, const Result &r, bool perf) {
+  out << std::left << std::setw(9) << r.impl << std::setw(9) << r.layout << std::setw(8)
+      << r.mode << std::right << std::setw(4) << r.threads << std::setw(12) << r.bytes
+      << std::setw(8) << r.ns.count << std::fixed << std::setprecision(2) << std::setw(11)
+      << r.ns_per_block();
+  print_optional(out, 10, r.cycles_per_byte());
+  out << std::setw(10) << r.mib_per_s() << std::setprecision(0) << std::setw(13) << r.ns.p50
+      << std::setw(13) << r.ns.p99 << std::setw(13) << r.ns.p999;
+  if (perf) {
+    out << std::setprecision(2);
+    print_optional(out, 9, r.instructions_per_byte());
+    print_optional(out, 7, r.ipc());
+    print_optional(out, 10, r.per_block(PerfEvent::L1dMisses));
+    print_optional(out, 10, r.per_block(PerfEvent::BranchMisses));
+  }
+  out << '\n';
+  out.unsetf(std::ios::fixed);
+}
+
+std::string json_optional(double value) { return value >= 0.0 ? json_number(value) : "null"; }
+std::string csv_optional(double value) { return value >= 0.0 ? json_number(value) : ""; }
+
+// `perf` is null when counters were not requested.
+void write_json(std::ostream &out, const std::vector<Result> &results,
+                const PerfCounters *perf) {
+  out << "{\n  \"schema\": \"cube96-bench/1\",\n  \"cycle_counter\": \""
+      << (have_cycle_counter() ? "tsc" : "none") << "\",\n  \"perf_counters\": "
+      << (perf != nullptr && perf->available() ? "true" : "false");
+  if (perf != nullptr && !perf->error().empty()) {
+    out << ",\n  \"perf_error\": \"" << json_escape(perf->error()) << "\"";
+  }
+  out << ",\n  \"results\": [";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const Result &r = results[i];
+    out << (i == 0 ? "\n" : ",\n") << "    {\"impl\": \"" << json_escape(r.impl)
+        << "\", \"engine\": \"" << json_escape(r.engine) << "\", \"layout\": \"" << r.layout
+        << "\", \"mode\": \"" << r.mode << "\", \"threads\": " << r.threads
+        << ", \"bytes\": " << r.bytes << ", \"reps\": " << r.ns.count
+        << ", \"ns_per_block\": " << json_number(r.ns_per_block())
+        << ", \"cycles_per_byte\": "
+        << (r.cycles_per_byte() >= 0.0 ? json_number(r.cycles_per_byte()) : "null")
+        << ", \"mib_per_s\": " << json_number(r.mib_per_s())
+        << ", \"mean_ns\": " << json_number(r.ns.mean) << ", \"min_ns\": "
+        << json_number(r.ns.min) << ", \"p50_ns\": " << json_number(r.ns.p50)
+        << ", \"p99_ns\": " << json_number(r.ns.p99) << ", \"p999_ns\": "
+        << json_number(r.ns.p999)
+        << ", \"instructions_per_byte\": " << json_optional(r.instructions_per_byte())
+        << ", \"ipc\": " << json_optional(r.ipc()) << ", \"l1d_misses_per_block\": "
+        << json_optional(r.per_block(PerfEvent::L1dMisses))
+        << ", \"branch_misses_per_block\": "
+        << json_optional(r.per_block(PerfEvent::BranchMisses)) << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+void write_csv(std::ostream &out, const std::vector<Result> &results) {
+  out << "impl,engine,layout,mode,threads,bytes,reps,ns_per_block,cycles_per_byte,"
+         "mib_per_s,mean_ns,min_ns,p50_ns,p99_ns,p999_ns,instructions_per_byte,ipc,"
+         "l1d_misses_per_block,branch_misses_per_block\n";
+  for (const Result &r : results) {
+    out << r.impl << ',' << r.engine << ',' << r.layout << ',' << r.mode << ',' << r.threads
+        << ',' << r.bytes << ',' << r.ns.count << ',' << json_number(r.ns_per_block()) << ','
+        << (r.cycles_per_byte() >= 0.0 ? json_number(r.cycles_per_byte()) : "") << ','
+        << json_number(r.mib_per_s()) << ',' << json_number(r.ns.mean) << ','
+        << json_number(r.ns.min) << ',' << json_number(r.ns.p50) << ','
+        << json_number(r.ns.p99) << ',' << json_number(r.ns.p999) << ','
+        << csv_optional(r.instructions_per_byte()) << ',' << csv_optional(r.ipc()) << ','
+        << csv_optional(r.per_block(PerfEvent::L1dMisses)) << ','
+        << csv_optional(r.per_block(PerfEvent::BranchMisses)) << '\n';
+  }
+}
+
+// Just enough JSON to read back a report written by write_json.
+struct JsonValue {
+  enum class Type { Null, Bool, Number, String, Array, Object } type = Type::Null;
+  double number = 0.0;
+  std::string string;
+  std::vector<JsonValue> items;
+  std::vector<std::pair<std::string, JsonValue>> members;
+
+  const JsonValue *find(const std::string &name) const {
+    for (const auto &member : members) {
+      if (member.first == name) {
+        return &member.second;
+      }
+    }
+    return nullptr;
+  }
+};
+
+class JsonParser {
+public:
+  explicit JsonParser(const std::string &text) : p_(text.c_str()), end_(p_ + text.size()) {}
+
+  bool parse(JsonValue &out) {
+    if (!value(out, 0)) {
+      return false;
+    }
+    skip_space();
+    return p_ == end_;
+  }
+
+private:
+  void skip_space() {
+    while (p_ != end_ && std::isspace(static_cast<unsigned char>(*p_))) {
+      ++p_;
+    }
+  }
+
+  bool literal(const char *word) {
+    const std::size_t n = std::strlen(word);
+    if (static_cast<std::size_t>(end_ - p_) < n || std::strncmp(p_, word, n) != 0) {
+      return false;
+    }
+    p_ += n;
+    return true;
+  }
+
+  bool string(std::string &out) {
+    if (p_ == end_ || *p_ != '"') {
+      return false;
+    }
+    ++p_;
+    while (p_ != end_ && *p_ != '"') {
+      if (*p_ == '\\') {
+        if (++p_ == end_) {
+          return false;
+        }
+      }
+      out += *p_++;
+    }
+    if (p_ == end_) {
+      return false;
+    }
+    ++p_;
+    return true;
+  }
+
+  bool value(JsonValue &out, int depth) {
+    skip_space();
+    if (p_ == end_ || depth > 16) {
+      return false;
+    }
+    if (*p_ == '{') {
+      out.type = JsonValue::Type::Object;
+      ++p_;
+      skip_space();
+      if (p_ != end_ && *p_ == '}') {
+        ++p_;
+        return true;
+      }
+      for (;;) {
+        std::pair<std::string, JsonValue> member;
+        skip_space();
+        if (!string(member.first)) {
+          return false;
+        }
+        skip_space();
+        if (p_ == end_ || *p_++ != ':' || !value(member.second, depth + 1)) {
+          return false;
+        }
+        out.members.push_back(std::move(member));
+        skip_space();
+        if (p_ != end_ && *p_ == ',') {
+          ++p_;
+        } else if (p_ != end_ && *p_ == '}') {
+          ++p_;
+          return true;
+        } else {
+          return false;
+        }
+      }
+    }
+    if (*p_ == '[') {
+      out.type = JsonValue::Type::Array;
+      ++p_;
+      skip_space();
+      if (p_ != end_ && *p_ == ']') {
+        ++p_;
+        return true;
+      }
+      for (;;) {
+        JsonValue item;
+        if (!value(item, depth + 1)) {
+          return false;
+        }
+        out.items.push_back(std::move(item));
+        skip_space();
+        if (p_ != end_ && *p_ == ',') {
+          ++p_;
+        } else if (p_ != end_ && *p_ == ']') {
+          ++p_;
+          return true;
+        } else {
+          return false;
+        }
+      }
+    }
+    if (*p_ == '"') {
+      out.type = JsonValue::Type::String;
+      return string(out.string);
+    }
+    if (literal("null")) {
+      out.type = JsonValue::Type::Null;
+      return true;
+    }
+    if (literal("true") || literal("false")) {
+      out.type = JsonValue::Type::Bool;
+      out.number = p_[-2] == 'u' ? 1.0 : 0.0;  // "true" ends in "ue"
+      return true;
+    }
+    char *num_end = nullptr;
+    const std::string rest(p_, static_cast<std::size_t>(std::min<std::ptrdiff_t>(end_ - p_, 64)));
+    out.number = std::strtod(rest.c_str(), &num_end);
+    if (num_end == rest.c_str()) {
+      return false;
+    }
+    out.type = JsonValue::Type::Number;
+    p_ += num_end - rest.c_str();
+    return true;
+  }
+
+  const char *p_;
+  const char *end_;
+};
+
+// Matches results to the baseline by impl/layout/mode/threads/bytes and flags
+// any whose median ns/block grew by more than the threshold.  Returns the
+// number of regressions, or -1 when the baseline cannot be read.
+int compare_with_baseline(const Options &opts, const std::vector<Result> &results,
+                          std::ostream &report) {
+  std::ifstream in(opts.compare);
+  if (!in) {
+    std::cerr << "Cannot read baseline " << opts.compare << ": " << std::strerror(errno) << '\n';
+    return -1;
+  }
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  JsonValue root;
+  const JsonValue *list = nullptr;
+  if (JsonParser(buffer.str()).parse(root)) {
+    list = root.find("results");
+  }
+  if (list == nullptr || list->type != JsonValue::Type::Array) {
+    std::cerr << "Baseline " << opts.compare << " is not a cube96_bench JSON report." << '\n';
+    return -1;
+  }
+
+  std::map<std::string, double> baseline;
+  for (const JsonValue &item : list->items) {
+    const JsonValue *fields[] = {item.find("impl"),    item.find("layout"),
+                                 item.find("mode"),    item.find("threads"),
+                                 item.find("bytes"),   item.find("ns_per_block")};
+    if (std::find(std::begin(fields), std::end(fields), nullptr) != std::end(fields)) {
+      continue;
+    }
+    Result r;
+    r.impl = fields[0]->string;
+    r.layout = fields[1]->string;
+    r.mode = fields[2]->string;
+    r.threads = static_cast<std::size_t>(fields[3]->number);
+    r.bytes = static_cast<std::uint64_t>(fields[4]->number);
+    baseline[r.key()] = fields[5]->number;
+  }
+
+  int regressions = 0;
+  std::size_t matched = 0;
+  report << "Comparison against " << opts.compare << " (median ns/block, threshold "
+         << opts.threshold << "%):\n";
+  for (const Result &r : results) {
+    const auto it = baseline.find(r.key());
+    if (it == baseline.end() || it->second <= 0.0) {
+      continue;
+    }
+    ++matched;
+    const double change = (r.ns_per_block() / it->second - 1.0) * 100.0;
+    const bool regressed = change > opts.threshold;
+    regressions += regressed ? 1 : 0;
+    report << (regressed ? "  REGRESSION " : "  ok         ") << std::left << std::setw(40)
+           << r.key() << std::right << std::fixed << std::setprecision(2) << std::setw(10)
+           << it->second << " -> " << std::setw(10) << r.ns_per_block() << std::showpos
+           << std::setw(9) << change << "%" << std::noshowpos << '\n';
+    report.unsetf(std::ios::fixed);
+  }
+  report << matched << " of " << results.size() << " results matched the baseline, "
+         << regressions << " regressed.\n";
+  return regressions;
+}
+
+#if defined(CUBE96_HAVE_FAST_IMPL)
+// Compares one Fast round done as separate sub_bytes_fast + apply_permutation
+// calls against the fused SubBytes + permutation table the cipher compiles per
+// round at setKey.  Each round is chained on the previous output so the
+// timings measure latency rather than independent throughput.
+void run_round_bench(std::ostream &out, std::size_t rounds) {
+  cube96::SplitMix64 prng(0x5EEDu);
+  const auto &primitives = cube96::primitive_set();
+  cube96::Permutation perm = cube96::identity_permutation();
+  for (int step = 0; step < 12; ++step) {
+    perm = cube96::compose(perm, primitives[prng.next() % primitives.size()]);
+  }
+  std::vector<cube96::GatherTable> fused(1);
+  cube96::compile_gather_table(perm, fused[0], cube96::AES_SBOX);
+
+  std::array<std::uint8_t, kBlock> block{};
+  std::array<std::uint8_t, kBlock> tmp{};
+  for (std::size_t i = 0; i < block.size(); ++i) {
+    block[i] = static_cast<std::uint8_t>(i * 29u + 3u);
+  }
+
+  auto start = Clock::now();
+  for (std::size_t i = 0; i < rounds; ++i) {
+    cube96::sub_bytes_fast(block.data());
+    cube96::apply_permutation(perm, block.data(), tmp.data());
+    block = tmp;
+  }
+  const double split_ns = elapsed_ns(start, Clock::now()) / static_cast<double>(rounds);
+
+  cube96::State96 s = cube96::load_state(block.data());
+  start = Clock::now();
+  for (std::size_t i = 0; i < rounds; ++i) {
+    s = cube96::apply_gather_table(fused[0], s);
+  }
+  const double fused_ns = elapsed_ns(start, Clock::now()) / static_cast<double>(rounds);
+  cube96::store_state(s, block.data());
+
+  out << "Fast round (sub_bytes_fast + apply_permutation): " << std::fixed
+      << std::setprecision(2) << split_ns << " ns\n"
+      << "Fast round (fused table, " << sizeof(cube96::GatherTable) / 1024
+      << " KiB/round): " << fused_ns << " ns (" << split_ns / fused_ns << "x), checksum "
+      << static_cast<int>(block[0]) << '\n';
+  out.unsetf(std::ios::fixed);
+}
+#endif
+
+// Key setup latency.  The round permutation derivation is timed both as the
+// original twelve single-primitive compositions plus invert() and through
+// derive_round_permutation's pair table; setKey is then timed end to end for
+// each engine, including its table or network compilation.
+void run_schedule_bench(std::ostream &out, std::size_t seeds, std::size_t keys) {
+  const auto &primitives = cube96::primitive_set();
+  cube96::primitive_pairs();  // build outside the timed loop
+  std::uint8_t checksum = 0;
+
+  auto start = Clock::now();
+  for (std::size_t i = 0; i < seeds; ++i) {
+    cube96::SplitMix64 prng(i * 0x9E3779B97F4A7C15ull);
+    cube96::Permutation perm = cube96::identity_permutation();
+    for (std::size_t step = 0; step < cube96::kPrimitiveSteps; ++step) {
+      perm = cube96::compose(perm, primitives[prng.next() % primitives.size()]);
+    }
+    checksum = static_cast<std::uint8_t>(checksum + cube96::invert(perm)[i % perm.size()]);
+  }
+  const double single_ns = elapsed_ns(start, Clock::now()) / static_cast<double>(seeds);
+
+  start = Clock::now();
+  for (std::size_t i = 0; i < seeds; ++i) {
+    cube96::Permutation perm{};
+    cube96::Permutation inv{};
+    cube96::derive_round_permutation(i * 0x9E3779B97F4A7C15ull, cube96::kDefaultLayout, &perm,
+                                     &inv);
+    checksum = static_cast<std::uint8_t>(checksum + inv[i % inv.size()]);
+  }
+  const double paired_ns = elapsed_ns(start, Clock::now()) / static_cast<double>(seeds);
+
+  out << "Round permutation (12 compositions + invert): " << std::fixed << std::setprecision(2)
+      << single_ns << " ns\n"
+      << "Round permutation (pair table, 6 + 6 compositions): " << paired_ns << " ns ("
+      << single_ns / paired_ns << "x), checksum " << static_cast<int>(checksum) << '\n';
+
+  std::vector<CubeCipher::Impl> impls;
+  if (CubeCipher::hasFastImpl()) {
+    impls.push_back(CubeCipher::Impl::Fast);
+  }
+  impls.push_back(CubeCipher::Impl::Hardened);
+  for (auto impl : impls) {
+    CubeCipher cipher(impl);
+    std::array<std::uint8_t, CubeCipher::KeyBytes> key{};
+    start = Clock::now();
+    for (std::size_t i = 0; i < keys; ++i) {
+      key[i % key.size()] = static_cast<std::uint8_t>(key[i % key.size()] + 1u);
+      cipher.setKey(key.data());
+    }
+    out << "setKey latency (" << cipher.engineName() << " engine): "
+        << elapsed_ns(start, Clock::now()) / 1000.0 / static_cast<double>(keys) << " us\n";
+  }
+  out.unsetf(std::ios::fixed);
+}
+
+// Where the time goes inside the engines, from the CUBE96_ENABLE_PROFILING
+// counters: one table per engine, path (encryptBlock loop or batch) and
+// direction, in timer ticks per block with the timer's own cost per stage
+// subtracted.
+void print_profile_table(std::ostream &out, const cube96::ProfileTable &table,
+                         const cube96::ProfileSnapshot &snapshot, double blocks) {
+  constexpr std::size_t kStages = cube96::kProfileStages;
+  std::array<double, kStages> totals{};
+  out << "  " << std::left << std::setw(7) << "round" << std::right;
+  for (std::size_t k = 0; k < kStages; ++k) {
+    out << std::setw(11) << cube96::profile_stage_name(static_cast<cube96::ProfileStage>(k));
+  }
+  out << std::setw(11) << "total" << '\n' << std::fixed << std::setprecision(1);
+  for (std::size_t slot = 0; slot < cube96::kProfileSlots; ++slot) {
+    double row = 0.0;
+    out << "  " << std::left << std::setw(7)
+        << (slot == cube96::kProfileFinal ? std::string("final") : std::to_string(slot))
+        << std::right;
+    for (std::size_t k = 0; k < kStages; ++k) {
+      const cube96::ProfileCounter &c = table[slot][k];
+      const double net = std::max(0.0, static_cast<double>(c.ticks) -
+                                           snapshot.overhead_ticks * static_cast<double>(c.calls));
+      row += net / blocks;
+      totals[k] += net / blocks;
+      out << std::setw(11) << net / blocks;
+    }
+    out << std::setw(11) << row << '\n';
+  }
+  double all = 0.0;
+  for (double t : totals) {
+    all += t;
+  }
+  out << "  " << std::left << std::setw(7) << "share" << std::right;
+  for (double t : totals) {
+    out << std::setw(10) << (all > 0.0 ? 100.0 * t / all : 0.0) << '%';
+  }
+  out << std::setw(11) << all << '\n';
+  out.unsetf(std::ios::fixed);
+}
+
+void run_profile(std::ostream &out, const Options &opts, const std::uint8_t *key) {
+  if (!cube96::profiling_enabled()) {
+    out << "Stage profile unavailable: configure with -DCUBE96_ENABLE_PROFILING=ON.\n";
+    return;
+  }
+  constexpr std::size_t kBlocks = 1u << 14;
+  std::vector<std::uint8_t> data(kBlocks * kBlock);
+  for (std::size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<std::uint8_t>(i * 131u + 17u);
+  }
+  for (auto impl : opts.impls) {
+    CubeCipher cipher(impl);
+    cipher.setKey(key);
+    for (bool batch : {false, true}) {
+      for (bool decrypt : {false, true}) {
+        cube96::profile_reset();
+        if (batch) {
+          if (decrypt) {
+            cipher.decryptBlocks(data.data(), data.data(), kBlocks);
+          } else {
+            cipher.encryptBlocks(data.data(), data.data(), kBlocks);
+          }
+        } else {
+          for (std::size_t i = 0; i < kBlocks; ++i) {
+            std::uint8_t *block = data.data() + i * kBlock;
+            if (decrypt) {
+              cipher.decryptBlock(block, block);
+            } else {
+              cipher.encryptBlock(block, block);
+            }
+          }
+        }
+        const cube96::ProfileSnapshot snapshot = cube96::profile_snapshot();
+        out << "Stage profile: " << cipher.engineName() << ", "
+            << (batch ? decrypt ? "decryptBlocks" : "encryptBlocks"
+                      : decrypt ? "decryptBlock" : "encryptBlock")
+            << ", " << kBlocks << " blocks (" << snapshot.unit << " ticks per block, "
+            << std::fixed << std::setprecision(0) << snapshot.overhead_ticks
+            << " subtracted per stage)\n";
+        out.unsetf(std::ios::fixed);
+        print_profile_table(out, decrypt ? snapshot.decrypt : snapshot.encrypt, snapshot,
+                            static_cast<double>(kBlocks));
+      }
+    }
+  }
+}
+
+int usage() {
+  std::cerr
+      << "Usage: cube96_bench [options]\n"
+         "  --sizes LIST       message sizes; items are N[K|M|G] or A:B for A, 4A, 16A, ..."
+         " up to B\n"
+         "                     (default 12:4M, at most 1G)\n"
+         "  --impl LIST        fast,hardened (default: all built)\n"
+         "  --layout LIST      zslice,rowmajor (default: both)\n"
+         "  --mode LIST        block,ecb,ecb-dec,ctr (default: all)\n"
+         "  --threads LIST     thread counts; a single N sweeps 1, 2, 4, ..., N"
+         " (0 = all cores)\n"
+         "  --warmup N         untimed calls per configuration (default 2)\n"
+         "  --reps N           timed calls per configuration (default: adaptive)\n"
+         "  --min-reps N       adaptive: at least N calls (default 10)\n"
+         "  --min-time MS      adaptive: at least MS milliseconds (default 50)\n"
+         "  --format FMT       text, json or csv (default text)\n"
+         "  --output FILE      write the report to FILE instead of stdout\n"
+         "  --compare FILE     compare with a JSON report; exit 2 on regressions\n"
+         "  --threshold PCT    regression threshold for --compare (default 5)\n"
+         "  --micro            also run the round and key-schedule micro-benchmarks\n"
+         "  --profile          print per-round stage timings (CUBE96_ENABLE_PROFILING builds)\n"
+         "  --no-perf          do not open hardware performance counters\n";
+  return EXIT_FAILURE;
+}
+
+bool parse_sizes(const std::string &text, std::vector<std::uint64_t> &sizes) {
+  sizes.clear();
+  for (const std::string &item : split_list(text)) {
+    const std::size_t colon = item.find(':');
+    std::uint64_t lo = 0;
+    std::uint64_t hi = 0;
+    if (colon == std::string::npos) {
+      if (!parse_size(item, lo)) {
+        return false;
+      }
+      hi = lo;
+    } else if (!parse_size(item.substr(0, colon), lo) || !parse_size(item.substr(colon + 1), hi)) {
+      return false;
+    }
+    if (lo < kBlock || hi > kMaxMessage || lo > hi) {
+      return false;
+    }
+    for (std::uint64_t size = lo; size <= hi; size *= 4) {
+      sizes.push_back(size);
+    }
+  }
+  return !sizes.empty();
+}
+
+bool parse_options(int argc, char **argv, Options &opts) {
+  std::string sizes = "12:4M";
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--micro") {
+      opts.micro = true;
+      continue;
+    }
+    if (arg == "--profile") {
+      opts.profile = true;
+      continue;
+    }
+    if (arg == "--no-perf") {
+      opts.perf = false;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const std::string value = argv[++i];
+    std::uint64_t n = 0;
+    if (arg == "--sizes") {
+      sizes = value;
+    } else if (arg == "--impl") {
+      opts.impls.clear();
+      for (const std::string &name : split_list(value)) {
+        if (name == "fast" && CubeCipher::hasFastImpl()) {
+          opts.impls.push_back(CubeCipher::Impl::Fast);
+        } else if (name == "hardened") {
+          opts.impls.push_back(CubeCipher::Impl::Hardened);
+        } else {
+          std::cerr << "Unknown or disabled implementation '" << name << "'.\n";
+          return false;
+        }
+      }
+    } else if (arg == "--layout") {
+      opts.layouts.clear();
+      for (const std::string &name : split_list(value)) {
+        if (name != "zslice" && name != "rowmajor") {
+          return false;
+        }
+        opts.layouts.push_back(name == "zslice" ? cube96::Layout::ZSlice
+                                                : cube96::Layout::RowMajor);
+      }
+    } else if (arg == "--mode") {
+      opts.modes.clear();
+      for (const std::string &name : split_list(value)) {
+        const Mode all[] = {Mode::Block, Mode::Ecb, Mode::EcbDecrypt, Mode::Ctr};
+        const auto it = std::find_if(std::begin(all), std::end(all),
+                                     [&](Mode m) { return name == mode_name(m); });
+        if (it == std::end(all)) {
+          return false;
+        }
+        opts.modes.push_back(*it);
+      }
+    } else if (arg == "--threads") {
+      const std::vector<std::string> items = split_list(value);
+      opts.threads.clear();
+      for (const std::string &item : items) {
+        if (!parse_count(item, 1024, n)) {
+          return false;
+        }
+        opts.threads.push_back(n == 0 ? std::max(1u, std::thread::hardware_concurrency())
+                                      : static_cast<std::size_t>(n));
+      }
+      if (opts.threads.size() == 1) {
+        const std::size_t max = opts.threads[0];
+        opts.threads.clear();
+        for (std::size_t t = 1;; t = std::min(t * 2, max)) {
+          opts.threads.push_back(t);
+          if (t == max) {
+            break;
+          }
+        }
+      }
+      if (opts.threads.empty()) {
+        return false;
+      }
+    } else if (arg == "--warmup" && parse_count(value, 1000000, n)) {
+      opts.warmup = static_cast<std::size_t>(n);
+    } else if (arg == "--reps" && parse_count(value, 100000000, n) && n > 0) {
+      opts.reps = static_cast<std::size_t>(n);
+    } else if (arg == "--min-reps" && parse_count(value, 100000000, n) && n > 0) {
+      opts.min_reps = static_cast<std::size_t>(n);
+    } else if (arg == "--min-time" && parse_count(value, 3600000, n)) {
+      opts.min_time_ms = static_cast<double>(n);
+    } else if (arg == "--format") {
+      if (value == "text") {
+        opts.format = Format::Text;
+      } else if (value == "json") {
+        opts.format = Format::Json;
+      } else if (value == "csv") {
+        opts.format = Format::Csv;
+      } else {
+        return false;
+      }
+    } else if (arg == "--output") {
+      opts.output = value;
+    } else if (arg == "--compare") {
+      opts.compare = value;
+    } else if (arg == "--threshold") {
+      char *end = nullptr;
+      opts.threshold = std::strtod(value.c_str(), &end);
+      if (end == value.c_str() || *end != '\0' || opts.threshold < 0.0) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+
+  if (!parse_sizes(sizes, opts.sizes)) {
+    std::cerr << "--sizes expects sizes between 12 bytes and 1G.\n";
+    return false;
+  }
+  if (opts.impls.empty()) {
+    if (CubeCipher::hasFastImpl()) {
+      opts.impls.push_back(CubeCipher::Impl::Fast);
+    }
+    opts.impls.push_back(CubeCipher::Impl::Hardened);
+  }
+  if (opts.layouts.empty()) {
+    // Default layout first.
+    opts.layouts = {cube96::kDefaultLayout, cube96::kDefaultLayout == cube96::Layout::ZSlice
+                                                ? cube96::Layout::RowMajor
+                                                : cube96::Layout::ZSlice};
+  }
+  if (opts.modes.empty()) {
+    opts.modes = {Mode::Block, Mode::Ecb, Mode::EcbDecrypt, Mode::Ctr};
+  }
+  return true;
+}
+
+// CUBE96_BENCH_BYTES, if set, replaces the size sweep with one block-aligned
+// size so CI smoke runs stay short.
+bool apply_env_size(Options &opts) {
+  const char *env = std::getenv("CUBE96_BENCH_BYTES");
+  if (env == nullptr) {
+    return true;
+  }
+  if (*env == '\0') {
+    std::cerr << "CUBE96_BENCH_BYTES must not be empty." << '\n';
+    return false;
+  }
+  char *end = nullptr;
+  errno = 0;
+  const std::uint64_t parsed = std::strtoull(env, &end, 0);
+  if (end == env || *end != '\0' || errno != 0) {
+    std::cerr << "CUBE96_BENCH_BYTES must be a valid integer number of bytes." << '\n';
+    return false;
+  }
+  if (parsed < kBlock || parsed > kMaxMessage) {
+    std::cerr << "CUBE96_BENCH_BYTES must be between " << kBlock << " bytes and 1 GiB."
+              << '\n';
+    return false;
+  }
+  if (parsed % kBlock != 0) {
+    std::cerr << "CUBE96_BENCH_BYTES must be a multiple of " << kBlock << " bytes." << '\n';
+    return false;
+  }
+  opts.sizes = {parsed};
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opts;
+  if (!parse_options(argc, argv, opts)) {
+    return usage();
+  }
+  if (!apply_env_size(opts)) {
+    return EXIT_FAILURE;
+  }
+
+  std::ofstream file;
+  if (!opts.output.empty()) {
+    file.open(opts.output);
+    if (!file) {
+      std::cerr << "Cannot write " << opts.output << ": " << std::strerror(errno) << '\n';
+      return EXIT_FAILURE;
+    }
+  }
+  std::ostream &out = opts.output.empty() ? std::cout : file;
+  // Text output doubles as the progress log; machine formats keep it apart.
+  std::ostream &log = opts.format == Format::Text ? out : std::cerr;
+
+  log << "Research cipher — NOT FOR PRODUCTION. Key size chosen for tractability, "
+         "not security."
+      << '\n';
+
+  if (opts.micro) {
+    run_schedule_bench(log, 20000, 200);
+#if defined(CUBE96_HAVE_FAST_IMPL)
+    run_round_bench(log, 1000000);
+#endif
+  }
+
+  const std::uint64_t max_bytes = *std::max_element(opts.sizes.begin(), opts.sizes.end());
+  std::vector<std::uint8_t> in(static_cast<std::size_t>(max_bytes));
+  std::vector<std::uint8_t> dst(static_cast<std::size_t>(max_bytes));
+  std::mt19937 rng(12345u);
+  for (auto &b : in) {
+    b = static_cast<std::uint8_t>(rng());
+  }
+  std::array<std::uint8_t, CubeCipher::KeyBytes> key{};
+  for (std::size_t i = 0; i < key.size(); ++i) {
+    key[i] = static_cast<std::uint8_t>(i * 11u + 7u);
+  }
+  const std::uint8_t nonce[cube96::kCtrNonceBytes] = {0};
+
+  if (opts.profile) {
+    run_profile(log, opts, key.data());
+  }
+
+  // Counters follow the calling thread only, so pooled runs go without.
+  std::unique_ptr<PerfCounters> perf;
+  if (opts.perf) {
+    perf = std::make_unique<PerfCounters>();
+    if (!perf->available()) {
+      log << "Hardware counters unavailable: " << perf->error() << '\n';
+    }
+  }
+  const bool perf_columns = perf != nullptr && perf->available();
+
+  if (opts.format == Format::Text) {
+    print_text_header(out, perf_columns);
+  }
+  std::vector<Result> results;
+  for (auto impl : opts.impls) {
+    for (auto layout : opts.layouts) {
+      CubeCipher cipher(impl, layout);
+      cipher.setKey(key.data());
+      for (std::size_t threads : opts.threads) {
+        std::unique_ptr<cube96::ThreadPool> pool;
+        if (threads > 1) {
+          pool = std::make_unique<cube96::ThreadPool>(threads);
+        }
+        for (Mode mode : opts.modes) {
+          // The per-block loop has no parallel form.
+          if (mode == Mode::Block && threads > 1) {
+            continue;
+          }
+          const PerfCounters *counters = perf_columns && threads == 1 ? perf.get() : nullptr;
+          for (std::uint64_t size : opts.sizes) {
+            Result r;
+            r.impl = impl_name(impl);
+            r.engine = cipher.engineName();
+            r.layout = cube96::layout_name(layout);
+            r.mode = mode_name(mode);
+            r.threads = threads;
+            // Block modes run whole blocks; CTR takes any length.
+            r.bytes = mode == Mode::Ctr ? size : std::max<std::uint64_t>(kBlock, size / kBlock * kBlock);
+            const std::size_t len = static_cast<std::size_t>(r.bytes);
+            const std::size_t blocks = len / kBlock;
+            switch (mode) {
+            case Mode::Block:
+              measure(opts, [&] {
+                for (std::size_t i = 0; i < blocks; ++i) {
+                  cipher.encryptBlock(in.data() + i * kBlock, dst.data() + i * kBlock);
+                }
+              }, r, counters);
+              break;
+            case Mode::Ecb:
+              measure(opts, [&] {
+                if (pool) {
+                  cube96::encrypt_blocks_parallel(cipher, in.data(), dst.data(), blocks,
+                                                  pool.get());
+                } else {
+                  cipher.encryptBlocks(in.data(), dst.data(), blocks);
+                }
+              }, r, counters);
+              break;
+            case Mode::EcbDecrypt:
+              measure(opts, [&] {
+                if (pool) {
+                  cube96::decrypt_blocks_parallel(cipher, in.data(), dst.data(), blocks,
+                                                  pool.get());
+                } else {
+                  cipher.decryptBlocks(in.data(), dst.data(), blocks);
+                }
+              }, r, counters);
+              break;
+            case Mode::Ctr:
+              measure(opts, [&] {
+                if (pool) {
+                  cube96::ctr_crypt_parallel(cipher, nonce, 0, 0, in.data(), dst.data(), len,
+                                             pool.get());
+                } else {
+                  cube96::CtrMode(cipher, nonce).crypt(in.data(), dst.data(), len);
+                }
+              }, r, counters);
+              break;
+            }
+            if (opts.format == Format::Text) {
+              print_text_row(out, r, perf_columns);
+            }
+            results.push_back(std::move(r));
+          }
+        }
+      }
+    }
+  }
+
+  if (opts.format == Format::Json) {
+    write_json(out, results, perf.get());
+  } else if (opts.format == Format::Csv) {
+    write_csv(out, results);
+  }
+  out.flush();
+
+  if (!opts.compare.empty()) {
+    const int regressions = compare_with_baseline(opts, results, log);
+    if (regressions < 0) {
+      return EXIT_FAILURE;
+    }
+    if (regressions > 0) {
+      return kExitRegression;
+    }
+  }
+  return EXIT_SUCCESS;
+}
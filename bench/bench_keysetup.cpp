@@ -0,0 +1,460 @@
+// SPDX-License-Identifier: MIT
+
+// cube96_bench_keysetup: setKey latency split into its stages (HKDF, the
+// SplitMix64 primitive draws, forward composition, inverse composition and
+// the engine's table compilation), with warm and cold caches, plus keys per
+// second for setKey and setKeys across threads.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_common.hpp"
+#include "cube96/cipher.hpp"
+#include "cube96/endian.hpp"
+#include "cube96/engine.hpp"
+#include "cube96/impl_dispatch.hpp"
+#include "cube96/key_schedule.hpp"
+#include "cube96/perm.hpp"
+
+namespace {
+
+using cube96::CubeCipher;
+using namespace cube96_bench;
+
+struct Options {
+  std::vector<CubeCipher::Impl> impls;
+  std::size_t keys = 2000;
+  std::size_t cold_keys = 100;
+  std::size_t evict_mb = 32;
+  std::vector<std::size_t> threads{1};
+  double duration_ms = 200.0;
+  bool json = false;
+  bool csv = false;
+  std::string output;
+};
+
+struct StageRow {
+  std::string impl;
+  std::string stage;
+  std::string cache;
+  Summary ns;
+};
+
+struct RateRow {
+  std::string impl;
+  std::string api;
+  std::size_t threads = 1;
+  double keys_per_s = 0.0;
+};
+
+using PairDraws = std::array<cube96::PrimitivePairDraws, cube96::kRoundCount>;
+
+// The stages of CubeCipher::setKey after HKDF, built from the perm.hpp steps
+// derive_round_permutation uses so each can be timed on its own.
+void draw_pairs(const cube96::DerivedMaterial &material, PairDraws &draws) {
+  for (std::size_t r = 0; r < cube96::kRoundCount; ++r) {
+    draws[r] = cube96::draw_primitive_pairs(cube96::load_be64(material.perm_seeds[r].data()));
+  }
+}
+
+void compose_forward(const cube96::PrimitivePairTable &table, const PairDraws &draws,
+                     cube96::ExpandedKey &key) {
+  key.perm.resize(cube96::kRoundCount);
+  for (std::size_t r = 0; r < cube96::kRoundCount; ++r) {
+    key.perm[r] = cube96::compose_pairs_forward(table, draws[r]);
+  }
+}
+
+void compose_inverse(const cube96::PrimitivePairTable &table, const PairDraws &draws,
+                     cube96::ExpandedKey &key) {
+  key.inv_perm.resize(cube96::kRoundCount);
+  for (std::size_t r = 0; r < cube96::kRoundCount; ++r) {
+    key.inv_perm[r] = cube96::compose_pairs_inverse(table, draws[r]);
+  }
+}
+
+// Inverting the forward permutations directly, as a LazyDecrypt context does
+// on its first decrypt.
+void invert_forward(cube96::ExpandedKey &key) {
+  key.inv_perm.resize(cube96::kRoundCount);
+  for (std::size_t r = 0; r < cube96::kRoundCount; ++r) {
+    key.inv_perm[r] = cube96::invert(key.perm[r]);
+  }
+}
+
+void load_round_keys(const cube96::DerivedMaterial &material, cube96::ExpandedKey &key) {
+  key.round_keys = material.round_keys;
+  key.rk_post = material.post_whitening;
+  for (std::size_t r = 0; r < cube96::kRoundCount; ++r) {
+    key.rk_packed[r] = cube96::load_state(key.round_keys[r].data());
+  }
+  key.rk_post_packed = cube96::load_state(key.rk_post.data());
+}
+
+// The engine CubeCipher binds for `impl`.
+const cube96::EngineOps &engine_for(CubeCipher::Impl impl) {
+#if !defined(CUBE96_DISABLE_FAST_IMPL)
+  if (impl == CubeCipher::Impl::Fast) {
+    return cube96::fast_engine();
+  }
+#else
+  (void)impl;
+#endif
+  return cube96::detected_simd_level() >= cube96::SimdLevel::Ssse3
+             ? cube96::hardened_simd_engine()
+             : cube96::hardened_engine();
+}
+
+const char *impl_name(CubeCipher::Impl impl) {
+  return impl == CubeCipher::Impl::Fast ? "fast" : "hardened";
+}
+
+std::vector<std::uint8_t> make_keys(std::size_t count) {
+  std::vector<std::uint8_t> keys(count * CubeCipher::KeyBytes);
+  cube96::SplitMix64 prng(0xC0FFEEull);
+  for (std::size_t i = 0; i < keys.size(); i += 4) {
+    const std::uint64_t v = prng.next();
+    for (std::size_t j = 0; j < 4 && i + j < keys.size(); ++j) {
+      keys[i + j] = static_cast<std::uint8_t>(v >> (8 * j));
+    }
+  }
+  return keys;
+}
+
+// Writes one byte per cache line of a buffer larger than the last-level
+// cache, so the next stage starts with the key schedule's data, the pair
+// table and the engine's tables evicted.
+class CacheEvictor {
+public:
+  explicit CacheEvictor(std::size_t mb) : buffer_(mb << 20, 1) {}
+  void operator()() {
+    for (std::size_t i = 0; i < buffer_.size(); i += 64) {
+      buffer_[i] = static_cast<std::uint8_t>(buffer_[i] + 1u);
+    }
+    sink_ = buffer_[buffer_.size() / 2];
+  }
+
+private:
+  std::vector<std::uint8_t> buffer_;
+  volatile std::uint8_t sink_ = 0;  // keeps the writes observable
+};
+
+// Times every stage for `count` keys.  With `evict` set, caches are flushed
+// before each timed stage.
+void run_stages(const Options &opts, const std::vector<std::uint8_t> &keys, std::size_t count,
+                CacheEvictor *evict, std::vector<StageRow> &rows) {
+  const char *cache = evict != nullptr ? "cold" : "warm";
+  const cube96::PrimitivePairTable &table = cube96::primitive_pairs();
+  std::vector<double> hkdf, draws_ns, compose_ns, inverse_ns, invert_ns;
+  std::vector<std::vector<double>> tables(opts.impls.size()), total(opts.impls.size()),
+      fresh(opts.impls.size());
+  std::vector<std::unique_ptr<CubeCipher>> ciphers;
+  std::vector<cube96::ExpandedKey> expanded(opts.impls.size());
+  for (auto impl : opts.impls) {
+    ciphers.push_back(std::make_unique<CubeCipher>(impl));
+  }
+
+  auto timed = [&](std::vector<double> &samples, auto &&fn) {
+    if (evict != nullptr) {
+      (*evict)();
+    }
+    const auto t0 = Clock::now();
+    fn();
+    samples.push_back(elapsed_ns(t0, Clock::now()));
+  };
+
+  cube96::ExpandedKey key;
+  for (std::size_t i = 0; i < count; ++i) {
+    const std::uint8_t *k = keys.data() + (i % (keys.size() / CubeCipher::KeyBytes)) *
+                                               CubeCipher::KeyBytes;
+    cube96::DerivedMaterial material;
+    PairDraws draws{};
+    timed(hkdf, [&] { material = cube96::derive_material(k); });
+    timed(draws_ns, [&] { draw_pairs(material, draws); });
+    timed(compose_ns, [&] { compose_forward(table, draws, key); });
+    timed(inverse_ns, [&] { compose_inverse(table, draws, key); });
+    cube96::ExpandedKey scratch = key;
+    timed(invert_ns, [&] { invert_forward(scratch); });
+
+    for (std::size_t e = 0; e < opts.impls.size(); ++e) {
+      const cube96::EngineOps &engine = engine_for(opts.impls[e]);
+      cube96::ExpandedKey &target = expanded[e];
+      load_round_keys(material, target);
+      target.perm = key.perm;
+      target.inv_perm = key.inv_perm;
+      timed(tables[e], [&] {
+        engine.prepare_encrypt(target);
+        engine.prepare_decrypt(target);
+      });
+      timed(total[e], [&] { ciphers[e]->setKey(k); });
+      timed(fresh[e], [&] {
+        CubeCipher context(opts.impls[e]);
+        context.setKey(k);
+      });
+    }
+  }
+
+  rows.push_back({"any", "derive_material", cache, summarize(hkdf)});
+  rows.push_back({"any", "splitmix draws", cache, summarize(draws_ns)});
+  rows.push_back({"any", "compose", cache, summarize(compose_ns)});
+  rows.push_back({"any", "invert (pairs)", cache, summarize(inverse_ns)});
+  rows.push_back({"any", "invert (lazy)", cache, summarize(invert_ns)});
+  for (std::size_t e = 0; e < opts.impls.size(); ++e) {
+    const std::string name = ciphers[e]->engineName();
+    rows.push_back({name, "tables", cache, summarize(tables[e])});
+    rows.push_back({name, "setKey", cache, summarize(total[e])});
+    rows.push_back({name, "setKey (new ctx)", cache, summarize(fresh[e])});
+  }
+}
+
+// Keys per second with `threads` threads keying their own contexts for the
+// configured duration.  setKeys keys 64 contexts per call.
+RateRow run_rate(const Options &opts, const std::vector<std::uint8_t> &keys,
+                 CubeCipher::Impl impl, std::size_t threads, bool bulk) {
+  constexpr std::size_t kBatch = 64;
+  const std::size_t key_count = keys.size() / CubeCipher::KeyBytes;
+  std::atomic<bool> go{false};
+  std::atomic<bool> stop{false};
+  std::vector<std::uint64_t> counts(threads, 0);
+  std::vector<std::thread> workers;
+  for (std::size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::vector<CubeCipher> contexts(bulk ? kBatch : 1, CubeCipher(impl));
+      std::size_t next = t * (key_count / threads);
+      std::uint64_t done = 0;
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      while (!stop.load(std::memory_order_relaxed)) {
+        if (bulk) {
+          next = next + kBatch > key_count ? 0 : next;
+          CubeCipher::setKeys(keys.data() + next * CubeCipher::KeyBytes, kBatch,
+                              contexts.data());
+          next += kBatch;
+          done += kBatch;
+        } else {
+          contexts[0].setKey(keys.data() + (next++ % key_count) * CubeCipher::KeyBytes);
+          ++done;
+        }
+      }
+      counts[t] = done;
+    });
+  }
+  const auto start = Clock::now();
+  go.store(true, std::memory_order_release);
+  std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(opts.duration_ms));
+  stop.store(true, std::memory_order_relaxed);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  const double seconds = elapsed_ns(start, Clock::now()) * 1e-9;
+  std::uint64_t total = 0;
+  for (std::uint64_t c : counts) {
+    total += c;
+  }
+  return {impl_name(impl), bulk ? "setKeys" : "setKey", threads,
+          static_cast<double>(total) / seconds};
+}
+
+void write_text(std::ostream &out, const Options &opts, const std::vector<StageRow> &stages,
+                const std::vector<RateRow> &rates) {
+  out << "Per-key latency in ns (" << opts.keys << " warm keys, " << opts.cold_keys
+      << " cold keys after evicting " << opts.evict_mb << " MiB)\n"
+      << std::left << std::setw(15) << "engine" << std::setw(18) << "stage" << std::setw(6)
+      << "cache" << std::right << std::setw(11) << "p50" << std::setw(11) << "p99"
+      << std::setw(11) << "p999" << std::setw(11) << "mean" << '\n';
+  out << std::fixed << std::setprecision(0);
+  for (const StageRow &row : stages) {
+    out << std::left << std::setw(15) << row.impl << std::setw(18) << row.stage << std::setw(6)
+        << row.cache << std::right << std::setw(11) << row.ns.p50 << std::setw(11)
+        << row.ns.p99 << std::setw(11) << row.ns.p999 << std::setw(11) << row.ns.mean << '\n';
+  }
+  out << "\nKey-setup throughput\n"
+      << std::left << std::setw(10) << "impl" << std::setw(9) << "api" << std::right
+      << std::setw(8) << "threads" << std::setw(13) << "keys/s" << std::setw(16)
+      << "keys/s/thread" << '\n';
+  for (const RateRow &row : rates) {
+    out << std::left << std::setw(10) << row.impl << std::setw(9) << row.api << std::right
+        << std::setw(8) << row.threads << std::setw(13) << row.keys_per_s << std::setw(16)
+        << row.keys_per_s / static_cast<double>(row.threads) << '\n';
+  }
+  out.unsetf(std::ios::fixed);
+}
+
+void write_json(std::ostream &out, const std::vector<StageRow> &stages,
+                const std::vector<RateRow> &rates) {
+  out << "{\n  \"schema\": \"cube96-bench-keysetup/1\",\n  \"stages\": [";
+  for (std::size_t i = 0; i < stages.size(); ++i) {
+    const StageRow &r = stages[i];
+    out << (i == 0 ? "\n" : ",\n") << "    {\"engine\": \"" << json_escape(r.impl)
+        << "\", \"stage\": \"" << json_escape(r.stage) << "\", \"cache\": \"" << r.cache
+        << "\", \"samples\": " << r.ns.count << ", \"p50_ns\": " << json_number(r.ns.p50)
+        << ", \"p99_ns\": " << json_number(r.ns.p99) << ", \"p999_ns\": "
+        << json_number(r.ns.p999) << ", \"mean_ns\": " << json_number(r.ns.mean) << "}";
+  }
+  out << "\n  ],\n  \"throughput\": [";
+  for (std::size_t i = 0; i < rates.size(); ++i) {
+    const RateRow &r = rates[i];
+    out << (i == 0 ? "\n" : ",\n") << "    {\"impl\": \"" << r.impl << "\", \"api\": \""
+        << r.api << "\", \"threads\": " << r.threads
+        << ", \"keys_per_s\": " << json_number(r.keys_per_s) << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+void write_csv(std::ostream &out, const std::vector<StageRow> &stages,
+               const std::vector<RateRow> &rates) {
+  out << "kind,engine,stage,cache,threads,samples,p50_ns,p99_ns,p999_ns,mean_ns,keys_per_s\n";
+  for (const StageRow &r : stages) {
+    out << "latency," << r.impl << ',' << r.stage << ',' << r.cache << ",1," << r.ns.count
+        << ',' << json_number(r.ns.p50) << ',' << json_number(r.ns.p99) << ','
+        << json_number(r.ns.p999) << ',' << json_number(r.ns.mean) << ",\n";
+  }
+  for (const RateRow &r : rates) {
+    out << "throughput," << r.impl << ',' << r.api << ",," << r.threads << ",,,,,,"
+        << json_number(r.keys_per_s) << '\n';
+  }
+}
+
+int usage() {
+  std::cerr << "Usage: cube96_bench_keysetup [options]\n"
+               "  --impl LIST      fast,hardened (default: all built)\n"
+               "  --keys N         warm-cache keys timed per stage (default 2000)\n"
+               "  --cold-keys N    cold-cache keys timed per stage (default 100, 0 = skip)\n"
+               "  --evict-mb N     cache eviction buffer in MiB (default 32)\n"
+               "  --threads LIST   thread counts for keys/s; a single N sweeps 1, 2, 4, ..., N"
+               " (0 = all cores)\n"
+               "  --duration MS    time per throughput run (default 200)\n"
+               "  --format FMT     text, json or csv (default text)\n"
+               "  --output FILE    write the report to FILE instead of stdout\n";
+  return EXIT_FAILURE;
+}
+
+bool parse_options(int argc, char **argv, Options &opts) {
+  for (int i = 1; i < argc; i += 2) {
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const std::string arg = argv[i];
+    const std::string value = argv[i + 1];
+    std::uint64_t n = 0;
+    if (arg == "--impl") {
+      opts.impls.clear();
+      for (const std::string &name : split_list(value)) {
+        if (name == "fast" && CubeCipher::hasFastImpl()) {
+          opts.impls.push_back(CubeCipher::Impl::Fast);
+        } else if (name == "hardened") {
+          opts.impls.push_back(CubeCipher::Impl::Hardened);
+        } else {
+          return false;
+        }
+      }
+    } else if (arg == "--keys" && parse_count(value, 100000000, n) && n > 0) {
+      opts.keys = static_cast<std::size_t>(n);
+    } else if (arg == "--cold-keys" && parse_count(value, 1000000, n)) {
+      opts.cold_keys = static_cast<std::size_t>(n);
+    } else if (arg == "--evict-mb" && parse_count(value, 4096, n) && n > 0) {
+      opts.evict_mb = static_cast<std::size_t>(n);
+    } else if (arg == "--threads") {
+      opts.threads.clear();
+      for (const std::string &item : split_list(value)) {
+        if (!parse_count(item, 1024, n)) {
+          return false;
+        }
+        opts.threads.push_back(n == 0 ? std::max(1u, std::thread::hardware_concurrency())
+                                      : static_cast<std::size_t>(n));
+      }
+      if (opts.threads.size() == 1) {
+        const std::size_t max = opts.threads[0];
+        opts.threads.clear();
+        for (std::size_t t = 1;; t = std::min(t * 2, max)) {
+          opts.threads.push_back(t);
+          if (t == max) {
+            break;
+          }
+        }
+      }
+      if (opts.threads.empty()) {
+        return false;
+      }
+    } else if (arg == "--duration" && parse_count(value, 3600000, n) && n > 0) {
+      opts.duration_ms = static_cast<double>(n);
+    } else if (arg == "--format" && (value == "text" || value == "json" || value == "csv")) {
+      opts.json = value == "json";
+      opts.csv = value == "csv";
+    } else if (arg == "--output") {
+      opts.output = value;
+    } else {
+      return false;
+    }
+  }
+  if (opts.impls.empty()) {
+    if (CubeCipher::hasFastImpl()) {
+      opts.impls.push_back(CubeCipher::Impl::Fast);
+    }
+    opts.impls.push_back(CubeCipher::Impl::Hardened);
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opts;
+  if (!parse_options(argc, argv, opts)) {
+    return usage();
+  }
+  std::ofstream file;
+  if (!opts.output.empty()) {
+    file.open(opts.output);
+    if (!file) {
+      std::cerr << "Cannot write " << opts.output << ": " << std::strerror(errno) << '\n';
+      return EXIT_FAILURE;
+    }
+  }
+  std::ostream &out = opts.output.empty() ? std::cout : file;
+  std::ostream &log = opts.json || opts.csv ? std::cerr : out;
+  log << "Research cipher — NOT FOR PRODUCTION. Key size chosen for tractability, "
+         "not security."
+      << '\n';
+
+  const std::vector<std::uint8_t> keys = make_keys(std::max<std::size_t>(opts.keys, 4096));
+  cube96::primitive_pairs();  // built once per process, outside every timing
+
+  std::vector<StageRow> stages;
+  run_stages(opts, keys, opts.keys, nullptr, stages);
+  if (opts.cold_keys != 0) {
+    CacheEvictor evict(opts.evict_mb);
+    run_stages(opts, keys, opts.cold_keys, &evict, stages);
+  }
+
+  std::vector<RateRow> rates;
+  for (auto impl : opts.impls) {
+    for (std::size_t threads : opts.threads) {
+      rates.push_back(run_rate(opts, keys, impl, threads, false));
+      rates.push_back(run_rate(opts, keys, impl, threads, true));
+    }
+  }
+
+  if (opts.json) {
+    write_json(out, stages, rates);
+  } else if (opts.csv) {
+    write_csv(out, stages, rates);
+  } else {
+    write_text(out, opts, stages, rates);
+  }
+  return EXIT_SUCCESS;
+}
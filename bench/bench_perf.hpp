@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: MIT
+
+// Hardware performance counters for the benchmark programs, through Linux
+// perf_event_open.  Counters cover the calling thread in user space only and
+// run while enabled, so a benchmark brackets just the region it measures.
+// Where perf is unavailable (other systems, perf_event_paranoid, containers
+// or VMs without a PMU) available() is false and error() says why; counters
+// the CPU lacks are left out individually.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+#define CUBE96_BENCH_HAVE_PERF 1
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cube96_bench {
+
+enum class PerfEvent { Instructions, Cycles, L1dMisses, BranchMisses };
+constexpr std::size_t kPerfEvents = 4;
+
+// Totals since the last reset(), scaled up when the kernel had to multiplex
+// the group; `valid` is false for counters that could not be opened.
+struct PerfTotals {
+  std::array<double, kPerfEvents> value{};
+  std::array<bool, kPerfEvents> valid{};
+
+  bool has(PerfEvent e) const { return valid[static_cast<std::size_t>(e)]; }
+  double operator[](PerfEvent e) const { return value[static_cast<std::size_t>(e)]; }
+};
+
+class PerfCounters {
+public:
+#if defined(CUBE96_BENCH_HAVE_PERF)
+  PerfCounters() {
+    fds_.fill(-1);
+    int first_errno = 0;
+    for (std::size_t i = 0; i < kPerfEvents; ++i) {
+      perf_event_attr attr{};
+      attr.size = sizeof(attr);
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format =
+          PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      describe(static_cast<PerfEvent>(i), attr);
+      const long fd = syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0);
+      if (fd < 0) {
+        if (error_.empty()) {
+          first_errno = errno;
+          error_ = std::string("perf_event_open: ") + std::strerror(errno);
+        }
+        continue;
+      }
+      fds_[i] = static_cast<int>(fd);
+      order_[count_++] = i;
+      if (leader_ < 0) {
+        leader_ = fds_[i];
+      }
+    }
+    if (leader_ >= 0) {
+      error_.clear();
+    } else if (first_errno == EACCES || first_errno == EPERM) {
+      error_ += " (check /proc/sys/kernel/perf_event_paranoid)";
+    } else if (first_errno == ENOENT || first_errno == EOPNOTSUPP) {
+      error_ += " (no hardware counters exposed, e.g. in a VM)";
+    }
+  }
+
+  ~PerfCounters() {
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+
+  bool available() const { return leader_ >= 0; }
+
+  void reset() const { control(PERF_EVENT_IOC_RESET); }
+  void enable() const { control(PERF_EVENT_IOC_ENABLE); }
+  void disable() const { control(PERF_EVENT_IOC_DISABLE); }
+
+  PerfTotals read() const {
+    PerfTotals totals;
+    // nr, time_enabled, time_running, then one value per counter.
+    std::uint64_t buffer[3 + kPerfEvents] = {};
+    if (!available() || ::read(leader_, buffer, sizeof(buffer)) <= 0 || buffer[0] != count_) {
+      return totals;
+    }
+    const double scale = buffer[2] > 0 ? static_cast<double>(buffer[1]) /
+                                             static_cast<double>(buffer[2])
+                                       : 0.0;
+    for (std::size_t k = 0; k < count_; ++k) {
+      totals.value[order_[k]] = static_cast<double>(buffer[3 + k]) * scale;
+      totals.valid[order_[k]] = buffer[2] > 0;
+    }
+    return totals;
+  }
+#else
+  bool available() const { return false; }
+  void reset() const {}
+  void enable() const {}
+  void disable() const {}
+  PerfTotals read() const { return PerfTotals{}; }
+#endif
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  const std::string &error() const { return error_; }
+
+private:
+#if defined(CUBE96_BENCH_HAVE_PERF)
+  static void describe(PerfEvent event, perf_event_attr &attr) {
+    attr.type = PERF_TYPE_HARDWARE;
+    switch (event) {
+    case PerfEvent::Instructions:
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case PerfEvent::Cycles:
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case PerfEvent::L1dMisses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      break;
+    case PerfEvent::BranchMisses:
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+    }
+  }
+
+  void control(unsigned long request) const {
+    if (leader_ >= 0) {
+      ioctl(leader_, request, PERF_IOC_FLAG_GROUP);
+    }
+  }
+
+  std::array<int, kPerfEvents> fds_{};
+  std::array<std::size_t, kPerfEvents> order_{};  // event of each group slot
+  std::size_t count_ = 0;
+  int leader_ = -1;
+  std::string error_;
+#else
+  std::string error_ = "perf_event_open is only available on Linux";
+#endif
+};
+
+} // namespace cube96_bench
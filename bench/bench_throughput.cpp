@@ -1,97 +0,0 @@
-// SPDX-License-Identifier: MIT
-
-#include <array>
-#include <chrono>
-#include <cerrno>
-#include <cstddef>
-#include <cstdint>
-#include <cstdlib>
-#include <iomanip>
-#include <iostream>
-#include <random>
-#include <vector>
-
-#include "cube96/cipher.hpp"
-
-namespace {
-
-void run_bench(cube96::CubeCipher::Impl impl, std::size_t bytes) {
-  cube96::CubeCipher cipher(impl);
-  std::array<std::uint8_t, cube96::CubeCipher::KeyBytes> key{};
-  for (std::size_t i = 0; i < key.size(); ++i) {
-    key[i] = static_cast<std::uint8_t>(i * 11u + 7u);
-  }
-  cipher.setKey(key.data());
-
-  std::vector<std::uint8_t> buffer(bytes);
-  std::mt19937 rng(12345u);
-  std::uniform_int_distribution<int> dist(0, 255);
-  for (auto &b : buffer) {
-    b = static_cast<std::uint8_t>(dist(rng));
-  }
-
-  std::vector<std::uint8_t> out(bytes);
-  const std::size_t blocks = bytes / cube96::CubeCipher::BlockBytes;
-
-  auto start = std::chrono::high_resolution_clock::now();
-  for (std::size_t i = 0; i < blocks; ++i) {
-    cipher.encryptBlock(buffer.data() + i * cube96::CubeCipher::BlockBytes,
-                        out.data() + i * cube96::CubeCipher::BlockBytes);
-  }
-  auto end = std::chrono::high_resolution_clock::now();
-  std::chrono::duration<double> elapsed = end - start;
-
-  double mb = static_cast<double>(bytes) / (1024.0 * 1024.0);
-  double mbps = mb / elapsed.count();
-  std::cout << (impl == cube96::CubeCipher::Impl::Fast ? "Fast" : "Hardened")
-            << " impl: " << std::fixed << std::setprecision(2) << mbps
-            << " MiB/s in " << elapsed.count() << " s\n";
-}
-
-} // namespace
-
-int main() {
-  std::cout <<
-      "Research cipher — NOT FOR PRODUCTION. Key size chosen for tractability, "
-      "not security." << '\n';
-
-  std::size_t bytes = 64ull * 1024ull * 1024ull;
-  if (const char *env = std::getenv("CUBE96_BENCH_BYTES")) {
-    if (*env == '\0') {
-      std::cerr << "CUBE96_BENCH_BYTES must not be empty." << '\n';
-      return EXIT_FAILURE;
-    }
-    char *end = nullptr;
-    errno = 0;
-    std::uint64_t parsed = std::strtoull(env, &end, 0);
-    if (end == env || *end != '\0' || errno != 0) {
-      std::cerr << "CUBE96_BENCH_BYTES must be a valid integer number of bytes." << '\n';
-      return EXIT_FAILURE;
-    }
-    if (parsed < cube96::CubeCipher::BlockBytes) {
-      std::cerr << "CUBE96_BENCH_BYTES must be at least "
-                << cube96::CubeCipher::BlockBytes << " bytes." << '\n';
-      return EXIT_FAILURE;
-    }
-    if (parsed % cube96::CubeCipher::BlockBytes != 0) {
-      std::cerr << "CUBE96_BENCH_BYTES must be a multiple of "
-                << cube96::CubeCipher::BlockBytes << " bytes." << '\n';
-      return EXIT_FAILURE;
-    }
-    bytes = static_cast<std::size_t>(parsed);
-  }
-  bool ran = false;
-  if (cube96::CubeCipher::hasFastImpl()) {
-    run_bench(cube96::CubeCipher::Impl::Fast, bytes);
-    ran = true;
-  }
-  if (cube96::CubeCipher::hasHardenedImpl()) {
-    run_bench(cube96::CubeCipher::Impl::Hardened, bytes);
-    ran = true;
-  }
-  if (!ran) {
-    std::cerr << "No cipher implementations enabled." << '\n';
-    return EXIT_FAILURE;
-  }
-  return EXIT_SUCCESS;
-}
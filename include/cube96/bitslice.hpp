@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "cube96/perm.hpp"
+#include "cube96/types.hpp"
+
+namespace cube96 {
+
+// 64-way bitsliced engine.  Up to 64 blocks are transposed into 96 bit-planes
+// where bit j of plane i holds state bit i of block j.  SubBytes is evaluated
+// as the Boyar–Peralta boolean circuit on all lanes at once, and the round
+// permutation runs the key's Beneš network as masked swaps of whole planes, so
+// no branch or memory access depends on the data or the key.
+constexpr std::size_t kBitsliceLanes = 64;
+
+using BitPlanes = std::array<std::uint64_t, kPermSize>;
+
+// Transposes `blocks` (<= kBitsliceLanes) consecutive 12-byte blocks into
+// bit-planes.  Unused lanes are zero.
+void bitslice_pack(const std::uint8_t *in, std::size_t blocks, BitPlanes &planes);
+void bitslice_unpack(const BitPlanes &planes, std::uint8_t *out, std::size_t blocks);
+
+// Forward/inverse AES S-box on the eight planes of one byte position; u[0]
+// carries the most significant bit.
+void sbox_bitsliced64(std::uint64_t u[8]);
+void inv_sbox_bitsliced64(std::uint64_t u[8]);
+
+// Full-cipher entry points over at most kBitsliceLanes blocks.  `perm_nets`
+// and `inv_perm_nets` point at kRoundCount compiled networks.  `in` and `out` may alias.
+void bitslice_encrypt(const std::array<RoundKey, kRoundCount> &round_keys,
+                      const RoundKey &rk_post,
+                      const BenesNetwork *perm_nets,
+                      const std::uint8_t *in, std::uint8_t *out,
+                      std::size_t blocks);
+void bitslice_decrypt(const std::array<RoundKey, kRoundCount> &round_keys,
+                      const RoundKey &rk_post,
+                      const BenesNetwork *inv_perm_nets,
+                      const std::uint8_t *in, std::uint8_t *out,
+                      std::size_t blocks);
+
+} // namespace cube96
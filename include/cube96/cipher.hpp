@@ -2,14 +2,18 @@
 
 #pragma once
 
-#include <array>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <vector>
 
+#include "cube96/engine.hpp"
 #include "cube96/types.hpp"
 
 namespace cube96 {
 
+struct DerivedMaterial;
+
 class CubeCipher {
 public:
   static constexpr std::size_t BlockBytes = kBlockBytes;
@@ -40,24 +44,161 @@ public:
   // and permutation derivation logic.  Builds configured with
   // CUBE96_FORCE_CONSTANT_TIME force DefaultImpl to Hardened and disable Fast
   // dispatch, exposing the policy through hasFastImpl().
-
-  explicit CubeCipher(Impl impl = DefaultImpl);
+  //
+  // `layout` selects the state layout the round permutations are derived in;
+  // ciphertexts from different layouts are not interchangeable.  It defaults
+  // to the configure-time CUBE96_LAYOUT choice.
+  //
+  // `usage` selects which directions setKey expands.  Both builds everything
+  // up front.  EncryptOnly and DecryptOnly derive and store only one set of
+  // permutations, tables and networks, and throw std::logic_error when asked
+  // for the other direction; CTR and the other encrypt-only modes need no
+  // more than EncryptOnly.  LazyDecrypt builds the encryption side in setKey
+  // and the inverse permutations and their tables on the first decrypt call,
+  // which may come from several threads at once.
+  enum class Usage { Both, EncryptOnly, DecryptOnly, LazyDecrypt };
+
+  explicit CubeCipher(Impl impl = DefaultImpl, Layout layout = kDefaultLayout,
+                      Usage usage = Usage::Both);
+  ~CubeCipher();
+
+  // Copying a LazyDecrypt context copies whatever it has built so far.
+  CubeCipher(const CubeCipher &other);
+  CubeCipher &operator=(const CubeCipher &other);
+  CubeCipher(CubeCipher &&other) noexcept;
+  CubeCipher &operator=(CubeCipher &&other) noexcept;
+
+  Layout layout() const { return layout_; }
+  Usage usage() const { return usage_; }
 
   void setKey(const std::uint8_t key[KeyBytes]);
 
+  // Keys contexts[i] with the i-th of `n` keys stored back to back at `keys`.
+  // The HKDF step for the whole batch goes through derive_materials, so bulk
+  // provisioning hashes up to eight keys per SIMD pass.  Each context keeps
+  // the Impl and Layout it was constructed with.
+  static void setKeys(const std::uint8_t *keys, std::size_t n, CubeCipher *contexts);
+
+  // Serialized expanded key in the versioned, layout-tagged record format of
+  // key_store.hpp, so a restarted process can skip the key schedule.  Export
+  // covers every direction built so far, plus the engine's compiled tables
+  // unless `include_tables` is false (then import recompiles them, which is
+  // most of setKey's cost on the fast engine).  Throws std::logic_error
+  // before the first setKey.
+  std::vector<std::uint8_t> exportExpandedKey(bool include_tables = true) const;
+
+  // Replaces the key with an exported record, rebuilding whatever this
+  // context's Impl and Usage need that the record lacks.  Throws
+  // std::invalid_argument, leaving the context unchanged, if the record is
+  // malformed, has another version or layout, or fails its check block.
+  // The second form borrows the record's arrays instead of copying them;
+  // `backing` must own `data` and is kept alive by this context and its
+  // copies (KeyStore passes its mapping).
+  void importExpandedKey(const std::uint8_t *data, std::size_t len);
+  void importExpandedKey(const std::uint8_t *data, std::size_t len,
+                         std::shared_ptr<const void> backing);
+
   void encryptBlock(const std::uint8_t in[BlockBytes],
                     std::uint8_t out[BlockBytes]) const;
 
   void decryptBlock(const std::uint8_t in[BlockBytes],
                     std::uint8_t out[BlockBytes]) const;
 
+  // Batch variants over `blocks` consecutive 12-byte blocks.  Impl::Fast
+  // interleaves small groups of blocks round by round so the round keys and
+  // permutations are fetched once per group; Impl::Hardened transposes up to
+  // 64 blocks at a time into the bitsliced engine (see bitslice.hpp).  `in` and
+  // `out` may be the same buffer (in-place); partially overlapping ranges are
+  // not supported.
+  void encryptBlocks(const std::uint8_t *in, std::uint8_t *out,
+                     std::size_t blocks) const;
+
+  void decryptBlocks(const std::uint8_t *in, std::uint8_t *out,
+                     std::size_t blocks) const;
+
+  // Bytes held by this key context, including the per-key gather tables that
+  // setKey compiles for Impl::Fast (8 tables of sizeof(GatherTable) per
+  // direction) and the permutations and networks kept for each direction.
+  std::size_t memoryFootprint() const;
+
+  // Name of the round engine bound at construction ("fast", "hardened" or
+  // "hardened-simd").
+  const char *engineName() const;
+
 private:
-  std::array<RoundKey, kRoundCount> round_keys_{};
-  RoundKey                          rk_post_{};
-  std::array<Permutation, kRoundCount> perm_{};
-  std::array<Permutation, kRoundCount> inv_perm_{};
+  struct LazyState;
+  friend class CtrMode;
+
+  // encryptBlocks for CtrMode's counter blocks, which metrics count as CTR
+  // rather than ECB traffic.
+  void encryptKeystream(const std::uint8_t *in, std::uint8_t *out, std::size_t blocks) const;
+
+  void applyMaterial(const DerivedMaterial &material);
+  void requireEncrypt() const {
+    if (usage_ == Usage::DecryptOnly) {
+      wrongDirection();
+    }
+  }
+  void requireDecrypt() const {
+    if (usage_ != Usage::Both && usage_ != Usage::DecryptOnly) {
+      prepareDecrypt();
+    }
+  }
+  void prepareDecrypt() const;
+  [[noreturn]] void wrongDirection() const;
+
+  // Mutable only so a LazyDecrypt context can complete its decryption side on
+  // first use, under lazy_'s mutex.
+  mutable ExpandedKey key_;
+  const EngineOps *engine_ = nullptr;
+  std::unique_ptr<LazyState> lazy_;  // LazyDecrypt only
 
   Impl impl_;
+  Layout layout_;
+  Usage usage_;
+};
+
+// Single-direction contexts: a CubeCipher built with Usage::EncryptOnly or
+// Usage::DecryptOnly that only exposes the matching calls.  cipher() passes
+// an encryptor to CtrMode and the parallel helpers, which only encrypt.
+class CubeEncryptor {
+public:
+  explicit CubeEncryptor(CubeCipher::Impl impl = CubeCipher::DefaultImpl,
+                         Layout layout = kDefaultLayout)
+      : cipher_(impl, layout, CubeCipher::Usage::EncryptOnly) {}
+
+  void setKey(const std::uint8_t key[kKeyBytes]) { cipher_.setKey(key); }
+  void encryptBlock(const std::uint8_t in[kBlockBytes], std::uint8_t out[kBlockBytes]) const {
+    cipher_.encryptBlock(in, out);
+  }
+  void encryptBlocks(const std::uint8_t *in, std::uint8_t *out, std::size_t blocks) const {
+    cipher_.encryptBlocks(in, out, blocks);
+  }
+  std::size_t memoryFootprint() const { return cipher_.memoryFootprint(); }
+  const CubeCipher &cipher() const { return cipher_; }
+
+private:
+  CubeCipher cipher_;
+};
+
+class CubeDecryptor {
+public:
+  explicit CubeDecryptor(CubeCipher::Impl impl = CubeCipher::DefaultImpl,
+                         Layout layout = kDefaultLayout)
+      : cipher_(impl, layout, CubeCipher::Usage::DecryptOnly) {}
+
+  void setKey(const std::uint8_t key[kKeyBytes]) { cipher_.setKey(key); }
+  void decryptBlock(const std::uint8_t in[kBlockBytes], std::uint8_t out[kBlockBytes]) const {
+    cipher_.decryptBlock(in, out);
+  }
+  void decryptBlocks(const std::uint8_t *in, std::uint8_t *out, std::size_t blocks) const {
+    cipher_.decryptBlocks(in, out, blocks);
+  }
+  std::size_t memoryFootprint() const { return cipher_.memoryFootprint(); }
+  const CubeCipher &cipher() const { return cipher_; }
+
+private:
+  CubeCipher cipher_;
 };
 
 } // namespace cube96
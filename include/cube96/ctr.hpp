@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cube96/cipher.hpp"
+
+namespace cube96 {
+
+// Counter mode over a keyed CubeCipher.  Counter block i is the 64-bit nonce
+// in bytes 0..7 followed by the 32-bit big-endian block counter
+// (initial_counter + i) in bytes 8..11, so one nonce covers at most 2^32
+// blocks (48 GiB) of keystream.  Keystream is generated in chunks of
+// kCtrChunkBlocks counter blocks through CubeCipher::encryptBlocks, so the
+// engine's interleaved (Fast) or bitsliced (Hardened) batch loop does the work.
+//
+// The position is a byte offset into the keystream and may be moved freely
+// with seek(), so any byte range of a large message can be encrypted or
+// decrypted without processing its prefix.  The referenced cipher must
+// outlive the CtrMode object.
+constexpr std::size_t kCtrNonceBytes = 8;
+constexpr std::size_t kCtrChunkBlocks = 64;
+
+class CtrMode {
+public:
+  CtrMode(const CubeCipher &cipher, const std::uint8_t nonce[kCtrNonceBytes],
+          std::uint32_t initial_counter = 0);
+
+  // Bytes of keystream available from initial_counter to counter 2^32 - 1.
+  std::uint64_t keystreamBytes() const;
+
+  // Moves to keystream byte `offset`.  Throws std::out_of_range when `offset`
+  // is past keystreamBytes().
+  void seek(std::uint64_t offset);
+  std::uint64_t position() const { return position_; }
+
+  // XORs `len` keystream bytes from the current position into `in`, writing
+  // `out`, and advances the position.  Encryption and decryption are the same
+  // operation; `in` and `out` may alias.  Throws std::out_of_range, without
+  // writing output, when the range would run past the counter space.
+  void crypt(const std::uint8_t *in, std::uint8_t *out, std::size_t len);
+
+  // Writes raw keystream and advances the position.
+  void keystream(std::uint8_t *out, std::size_t len);
+
+private:
+  template <bool Xor>
+  void generate(const std::uint8_t *in, std::uint8_t *out, std::size_t len);
+
+  const CubeCipher *cipher_;
+  std::uint64_t nonce_;
+  std::uint32_t initial_counter_;
+  std::uint64_t position_ = 0;
+};
+
+// Streaming CTR context for input that arrives in arbitrary-sized pieces.
+// Output for each update() is produced immediately.  Whole blocks go through
+// CtrMode in runs of kCtrChunkBlocks, and the keystream left over from a
+// partial block is cached for the next call rather than regenerated.  All
+// buffers are members or on the stack, so update() never allocates.
+class CtrStream {
+public:
+  CtrStream(const CubeCipher &cipher, const std::uint8_t nonce[kCtrNonceBytes],
+            std::uint32_t initial_counter = 0);
+  ~CtrStream();
+
+  // Encrypts or decrypts the next `len` bytes of the stream; `in` and `out`
+  // may alias.  Throws std::logic_error after finalize() and
+  // std::out_of_range, without writing output, past the counter space.
+  void update(const std::uint8_t *in, std::uint8_t *out, std::size_t len);
+
+  // Ends the stream, wiping the cached keystream, and returns the total
+  // number of bytes processed.  CTR needs no padding, so nothing is emitted.
+  std::uint64_t finalize();
+
+  std::uint64_t bytesProcessed() const;
+
+private:
+  void wipe_tail();
+
+  CtrMode mode_;
+  std::uint8_t tail_[kBlockBytes] = {};
+  std::size_t tail_used_ = kBlockBytes;  // bytes of tail_ already consumed
+  bool finalized_ = false;
+};
+
+} // namespace cube96
@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "cube96/bitslice.hpp"
+#include "cube96/perm.hpp"
+#include "cube96/state.hpp"
+#include "cube96/types.hpp"
+
+namespace cube96 {
+
+// Per-key array that either owns its elements or borrows them from memory
+// kept alive elsewhere, such as a mapped key store (see key_store.hpp).
+// Engines read both forms alike.  Elements may only be written after
+// resize(), which always switches back to owned storage.
+template <typename T>
+class KeyArray {
+public:
+  KeyArray() = default;
+  KeyArray(const KeyArray &other)
+      : owned_(other.owned_), data_(other.borrowed() ? other.data_ : owned_.data()),
+        size_(other.size_) {}
+  KeyArray(KeyArray &&other) noexcept
+      : owned_(std::move(other.owned_)), data_(other.data_), size_(other.size_) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+  KeyArray &operator=(KeyArray other) noexcept {
+    owned_.swap(other.owned_);
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+
+  void resize(std::size_t n) {
+    owned_.resize(n);
+    data_ = owned_.data();
+    size_ = n;
+  }
+  void clear() { resize(0); }
+  // Points at `n` elements owned by someone else and releases owned storage.
+  void borrow(const T *data, std::size_t n) {
+    std::vector<T>().swap(owned_);
+    data_ = const_cast<T *>(data);
+    size_ = n;
+  }
+
+  bool borrowed() const { return size_ != 0 && data_ != owned_.data(); }
+  bool empty() const { return size_ == 0; }
+  std::size_t size() const { return size_; }
+  // Elements this context holds itself; borrowed ones are not counted.
+  std::size_t capacity() const { return owned_.capacity(); }
+  const T *data() const { return data_; }
+  const T &operator[](std::size_t i) const { return data_[i]; }
+  T &operator[](std::size_t i) { return data_[i]; }
+
+private:
+  std::vector<T> owned_;
+  T *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+// Expanded key shared by all round engines.  CubeCipher::setKey fills the
+// round keys and permutations; the bound engine's prepare_encrypt() and
+// prepare_decrypt() then compile the tables it runs on and leave the others
+// empty.  The state layout only affects which permutations setKey derives, so
+// engines are layout-agnostic.
+//
+// Direction-specific data lives in arrays holding kRoundCount entries once
+// built.  A context set up for one direction (see CubeCipher::Usage) leaves
+// the other direction's arrays empty, so it neither derives nor stores them.
+// A key imported from a mapped store borrows its arrays, and `backing` keeps
+// that mapping alive for as long as any copy of the key exists.
+struct ExpandedKey {
+  std::array<RoundKey, kRoundCount> round_keys{};
+  RoundKey rk_post{};
+  std::array<State96, kRoundCount> rk_packed{};
+  State96 rk_post_packed{};
+  KeyArray<Permutation> perm;
+  KeyArray<Permutation> inv_perm;
+
+  // Fast engine: fused SubBytes + permutation tables, and decryption keys
+  // where entry r > 0 is round key r pushed through inv_perm[r - 1].
+  KeyArray<GatherTable> perm_tables;
+  KeyArray<GatherTable> inv_perm_tables;
+  std::array<State96, kRoundCount> rk_inv_packed{};
+
+  // Hardened engines: delta-swap networks, also routing the batch bit-planes.
+  KeyArray<BenesNetwork> perm_nets;
+  KeyArray<BenesNetwork> inv_perm_nets;
+
+  std::shared_ptr<const void> backing;
+};
+
+// Function table for one round engine.  CubeCipher binds a table at
+// construction, so each call is one indirect jump into a loop that was
+// specialized for the engine at compile time.
+struct EngineOps {
+  const char *name;
+  void (*prepare_encrypt)(ExpandedKey &key);
+  void (*prepare_decrypt)(ExpandedKey &key);
+  void (*encrypt_block)(const ExpandedKey &key, const std::uint8_t *in,
+                        std::uint8_t *out);
+  void (*decrypt_block)(const ExpandedKey &key, const std::uint8_t *in,
+                        std::uint8_t *out);
+  void (*encrypt_blocks)(const ExpandedKey &key, const std::uint8_t *in,
+                         std::uint8_t *out, std::size_t blocks);
+  void (*decrypt_blocks)(const ExpandedKey &key, const std::uint8_t *in,
+                         std::uint8_t *out, std::size_t blocks);
+};
+
+// Round loops fold over this sequence so round keys and tables are addressed
+// with constant offsets and the state stays in registers.
+using RoundIndices = std::make_index_sequence<kRoundCount>;
+
+// Builds an EngineOps from a round policy `Round` providing
+//   static constexpr const char *kName;
+//   static constexpr std::size_t kLanes;        // blocks per batch group
+//   static constexpr bool kBitsliceBatch;       // batch via bitslice.hpp
+//   static void prepare_encrypt(ExpandedKey &key);  // from key.perm
+//   static void prepare_decrypt(ExpandedKey &key);  // from key.inv_perm
+//   static void encrypt(const ExpandedKey &key, State96 *s, std::size_t lanes);
+//   static void decrypt(const ExpandedKey &key, State96 *s, std::size_t lanes);
+// New engines plug in by defining a policy in their own translation unit and
+// exposing RoundEngine<Policy>::ops().
+template <typename Round>
+struct RoundEngine {
+  static void encrypt_block(const ExpandedKey &key, const std::uint8_t *in,
+                            std::uint8_t *out) {
+    State96 s = load_state(in);
+    Round::encrypt(key, &s, 1);
+    store_state(s, out);
+  }
+
+  static void decrypt_block(const ExpandedKey &key, const std::uint8_t *in,
+                            std::uint8_t *out) {
+    State96 s = load_state(in);
+    Round::decrypt(key, &s, 1);
+    store_state(s, out);
+  }
+
+  // Every group is loaded before any output is written, so in == out is safe.
+  template <bool Encrypt>
+  static void run_blocks(const ExpandedKey &key, const std::uint8_t *in,
+                         std::uint8_t *out, std::size_t blocks) {
+    if constexpr (Round::kBitsliceBatch) {
+      for (std::size_t done = 0; done < blocks; done += kBitsliceLanes) {
+        const std::size_t lanes = std::min(kBitsliceLanes, blocks - done);
+        if constexpr (Encrypt) {
+          bitslice_encrypt(key.round_keys, key.rk_post, key.perm_nets.data(),
+                           in + done * kBlockBytes, out + done * kBlockBytes, lanes);
+        } else {
+          bitslice_decrypt(key.round_keys, key.rk_post, key.inv_perm_nets.data(),
+                           in + done * kBlockBytes, out + done * kBlockBytes, lanes);
+        }
+      }
+    } else {
+      for (std::size_t done = 0; done < blocks; done += Round::kLanes) {
+        const std::size_t lanes = std::min(Round::kLanes, blocks - done);
+        State96 s[Round::kLanes];
+        for (std::size_t l = 0; l < lanes; ++l) {
+          s[l] = load_state(in + (done + l) * kBlockBytes);
+        }
+        if constexpr (Encrypt) {
+          Round::encrypt(key, s, lanes);
+        } else {
+          Round::decrypt(key, s, lanes);
+        }
+        for (std::size_t l = 0; l < lanes; ++l) {
+          store_state(s[l], out + (done + l) * kBlockBytes);
+        }
+      }
+    }
+  }
+
+  static const EngineOps &ops() {
+    static const EngineOps table{Round::kName,           &Round::prepare_encrypt,
+                                 &Round::prepare_decrypt, &encrypt_block,
+                                 &decrypt_block,          &run_blocks<true>,
+                                 &run_blocks<false>};
+    return table;
+  }
+};
+
+// Engines shipped with the library.  The fast engine is only linked when the
+// build keeps the table implementation; the SIMD hardened engine falls back to
+// the scalar S-box on CPUs without SSSE3 but is only bound when it is present.
+#if !defined(CUBE96_DISABLE_FAST_IMPL)
+const EngineOps &fast_engine();
+#endif
+const EngineOps &hardened_engine();
+const EngineOps &hardened_simd_engine();
+
+} // namespace cube96
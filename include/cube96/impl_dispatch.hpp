@@ -2,8 +2,10 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
+#include "cube96/state.hpp"
 #include "cube96/types.hpp"
 
 namespace cube96 {
@@ -14,8 +16,44 @@ namespace cube96 {
 void sub_bytes_fast(std::uint8_t state[kBlockBytes]);
 void inv_sub_bytes_fast(std::uint8_t state[kBlockBytes]);
 
-// Hardened: bitsliced AES S-box for constant-time behaviour.
+// Hardened: constant-time AES S-box.  Uses the vector kernel below when the
+// CPU supports one and the bitsliced scalar expression otherwise.
 void sub_bytes_hardened(std::uint8_t state[kBlockBytes]);
 void inv_sub_bytes_hardened(std::uint8_t state[kBlockBytes]);
 
+// Vector S-box: the AES inverse is computed in the tower field GF((2^4)^2),
+// whose GF(2^4) arithmetic is done with 16-entry byte shuffles (pshufb) kept
+// in registers, so no memory access depends on the data.  The widest kernel
+// the running CPU supports is picked once via cpuid.  Builds configured with
+// CUBE96_ENABLE_SIMD=OFF define CUBE96_DISABLE_SIMD and always report Scalar.
+enum class SimdLevel { Scalar, Ssse3, Avx2 };
+
+SimdLevel detected_simd_level();
+const char *simd_level_name(SimdLevel level);
+
+// SubBytes over `len` contiguous bytes, e.g. several packed blocks.  The
+// explicit-level overloads clamp `level` to detected_simd_level().
+void sub_bytes_vec(std::uint8_t *data, std::size_t len);
+void inv_sub_bytes_vec(std::uint8_t *data, std::size_t len);
+void sub_bytes_vec(std::uint8_t *data, std::size_t len, SimdLevel level);
+void inv_sub_bytes_vec(std::uint8_t *data, std::size_t len, SimdLevel level);
+
+// compose(accum, step) (out[i] = step[accum[i]]) as a byte gather: each
+// 16-byte slice of `step` is a pshufb table, and every output byte picks its
+// slice by saturating its index out of range of the other five.
+Permutation compose_vec(const Permutation &accum, const Permutation &step);
+Permutation compose_vec(const Permutation &accum, const Permutation &step, SimdLevel level);
+
+// Single-block state S-box, dispatched to the detected level.
+State96 sub_state_hardened(const State96 &s);
+State96 inv_sub_state_hardened(const State96 &s);
+
+// Fixed-level state kernels the hardened engines are specialized on.  The
+// SSSE3 pair computes with the scalar S-box when the build has no x86 SIMD
+// support; callers only bind it when detected_simd_level() >= Ssse3.
+State96 sub_state_scalar(const State96 &s);
+State96 inv_sub_state_scalar(const State96 &s);
+State96 sub_state_ssse3(const State96 &s);
+State96 inv_sub_state_ssse3(const State96 &s);
+
 } // namespace cube96
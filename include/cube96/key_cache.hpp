@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "cube96/cipher.hpp"
+
+namespace cube96 {
+
+// Thread-safe LRU cache of expanded CubeCipher contexts keyed by the raw
+// 12-byte key.  Keys are spread over independently locked shards, each with
+// its own LRU list, so lookups for different keys rarely contend.  A hit
+// returns the cached context without rerunning the key schedule.  A miss
+// expands the key outside the shard lock and then inserts the context,
+// evicting that shard's least recently used entry when full.  While a key is
+// being expanded, the shard records it as in flight; other threads asking for
+// the same key wait for that expansion instead of rerunning the schedule, and
+// are counted as `waits`, not misses.
+//
+// Contexts are handed out as shared_ptr, so an entry evicted while a caller
+// still uses it stays alive until that caller releases it.
+class KeyContextCache {
+public:
+  struct Stats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;  // lookups that expanded and inserted a key
+    std::uint64_t waits = 0;   // lookups that waited on another thread's expansion
+    std::uint64_t evictions = 0;
+    std::size_t size = 0;
+  };
+
+  // `capacity` is the total number of contexts kept (at least 1), split
+  // across `shards` (clamped to [1, capacity]); when it does not divide
+  // evenly, the first capacity % shards shards hold one extra context.
+  // Contexts are built with `impl`, `layout` and `usage`; EncryptOnly roughly
+  // halves the memory each cached context holds.
+  explicit KeyContextCache(std::size_t capacity,
+                           CubeCipher::Impl impl = CubeCipher::DefaultImpl,
+                           Layout layout = kDefaultLayout, std::size_t shards = 16,
+                           CubeCipher::Usage usage = CubeCipher::Usage::Both);
+
+  KeyContextCache(const KeyContextCache &) = delete;
+  KeyContextCache &operator=(const KeyContextCache &) = delete;
+
+  std::shared_ptr<const CubeCipher> get(const std::uint8_t key[kKeyBytes]);
+
+  Stats stats() const;
+  void clear();
+  std::size_t capacity() const { return capacity_; }
+
+private:
+  using KeyId = std::array<std::uint8_t, kKeyBytes>;
+
+  struct KeyHash {
+    std::size_t operator()(const KeyId &key) const;
+  };
+
+  using Pending = std::shared_future<std::shared_ptr<const CubeCipher>>;
+
+  struct Entry {
+    KeyId key;
+    std::shared_ptr<const CubeCipher> context;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    std::list<Entry> lru;  // most recently used first
+    std::unordered_map<KeyId, std::list<Entry>::iterator, KeyHash> index;
+    std::unordered_map<KeyId, Pending, KeyHash> pending;  // expansions in flight
+    std::size_t capacity = 0;
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+    std::atomic<std::uint64_t> waits{0};
+    std::atomic<std::uint64_t> evictions{0};
+  };
+
+  Shard &shard_for(const KeyId &key);
+
+  CubeCipher::Impl impl_;
+  Layout layout_;
+  CubeCipher::Usage usage_;
+  std::size_t capacity_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+} // namespace cube96
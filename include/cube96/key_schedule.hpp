@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <cstdint>
 
+#include "cube96/impl_dispatch.hpp"
 #include "cube96/types.hpp"
 
 namespace cube96 {
@@ -16,6 +17,15 @@ struct DerivedMaterial {
 
 DerivedMaterial derive_material(const std::uint8_t key[kKeyBytes]);
 
+// Derives material for `n` keys stored back to back at `keys` (n * kKeyBytes
+// bytes) into out[0..n).  Independent HKDF computations run side by side in
+// SIMD lanes: 8 per AVX2 register, 4 per SSE2 register, one at a time
+// otherwise.  The explicit-level overload clamps `level` to
+// detected_simd_level(); results are identical at every level.
+void derive_materials(const std::uint8_t *keys, std::size_t n, DerivedMaterial *out);
+void derive_materials(const std::uint8_t *keys, std::size_t n, DerivedMaterial *out,
+                      SimdLevel level);
+
 // SHA-256 interface exposed for unit tests.
 struct Sha256Digest {
   std::uint32_t h[8];
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cube96/cipher.hpp"
+#include "cube96/engine.hpp"
+
+namespace cube96 {
+
+// Expanded-key record, the format of CubeCipher::exportExpandedKey and of
+// every entry in a KeyStore file.  Integers in the header are big-endian:
+//
+//   offset  size  field
+//        0     8  magic "CUBE96XK"
+//        8     2  format version (kExpandedKeyVersion)
+//       10     1  layout (0 = ZSlice, 1 = RowMajor)
+//       11     1  contents (kRecord* bits below)
+//       12     4  byte-order tag 0x01020304, stored in native order
+//       16     4  record length in bytes
+//       20    12  check block: the encryption of the all-zero block, or
+//                 its decryption if there are no forward permutations
+//       32    96  round keys 0..7
+//      128    12  post-whitening key
+//      140     4  CRC32C of the whole record, taken with this field zeroed
+//      144        forward permutations (8 x 96 bytes) if present,
+//                 then inverse permutations (8 x 96 bytes) if present
+//
+// Compiled tables follow at the next 64-byte boundary, in native byte order,
+// with the element layouts of GatherTable and BenesNetwork: forward gather
+// tables, inverse gather tables plus the 8 pre-permuted decryption round keys
+// (16 bytes each), forward networks, inverse networks.  A reader whose byte
+// order differs from the tag ignores the tables and recompiles them.
+//
+// The digest is checked before anything is read from the record, so a record
+// damaged on disk or in a mapping is rejected instead of borrowed.  It
+// guards against corruption, not tampering.
+//
+// Any direction the record lacks is rebuilt from the other one on import,
+// and tables the importing engine does not run on are compiled on import.
+// The layout is not converted: importing into a context of another layout
+// throws.  Records are key-equivalent secrets; protect them like the keys.
+constexpr std::uint16_t kExpandedKeyVersion = 2;
+constexpr std::uint8_t kRecordForward = 0x01;      // perm
+constexpr std::uint8_t kRecordInverse = 0x02;      // inv_perm
+constexpr std::uint8_t kRecordGatherTables = 0x04; // fast engine tables
+constexpr std::uint8_t kRecordBenesNetworks = 0x08; // hardened engine networks
+
+// Encodes the directions `key` holds, plus its compiled tables when
+// `include_tables` is set and they cover every encoded direction.  `check` is
+// the check block described above.
+std::vector<std::uint8_t> encode_expanded_key(const ExpandedKey &key, Layout layout,
+                                              const std::uint8_t check[kBlockBytes],
+                                              bool include_tables);
+
+// Parses a record into `key` and `check`, throwing std::invalid_argument on
+// a malformed or corrupted record, another format version or another
+// layout.  With a non-null `backing` that owns `data`, arrays are borrowed
+// from `data` where it is suitably aligned instead of copied.  Returns the
+// record's contents bits, less the tables of a foreign byte order.
+std::uint8_t decode_expanded_key(const std::uint8_t *data, std::size_t len, Layout layout,
+                                 const std::shared_ptr<const void> &backing, ExpandedKey &key,
+                                 std::uint8_t check[kBlockBytes]);
+
+// Read-only file of expanded keys that several processes can map at once, so
+// workers skip the key schedule on startup and share one copy of the tables
+// through the page cache.  A store is written once with KeyStore::write and
+// looked up by caller-chosen 64-bit ids:
+//
+//   offset  size  field
+//        0     8  magic "CUBE96KS"
+//        8     4  store version (1)
+//       12     4  entry count n
+//       16  32*n  index sorted by id: id, record offset, record length, 0
+//                 (big-endian 64-bit each)
+//
+// Each record is an expanded-key record as above, starting on a 64-byte
+// boundary.  Contexts loaded from a store borrow its tables and keep the
+// mapping alive, so they stay valid after the KeyStore object is gone.
+// Platforms without POSIX mmap read the file into memory instead.
+class KeyStore {
+public:
+  struct Entry {
+    std::uint64_t id;
+    const CubeCipher *context;
+  };
+
+  // Writes `entries` to `path` through a temporary file and a rename, so
+  // processes still mapping the previous store keep a consistent view.  Every
+  // record is exported before the file is created, and a failed write removes
+  // its temporary file.  On POSIX systems the temporary name is unique per
+  // writer (mkstemp) and the file has mode 0600.  Throws std::invalid_argument
+  // on duplicate ids, std::runtime_error on I/O failure and passes on what
+  // exportExpandedKey throws.
+  static void write(const std::string &path, const std::vector<Entry> &entries,
+                    bool include_tables = true);
+
+  // Maps `path` read-only.  Throws std::runtime_error when the file cannot
+  // be read and std::invalid_argument when it is not a valid store.
+  explicit KeyStore(const std::string &path);
+
+  std::size_t size() const { return count_; }
+  bool contains(std::uint64_t id) const { return find(id) != nullptr; }
+  std::vector<std::uint64_t> ids() const;
+
+  // Context for `id`, built with the given parameters from the stored record.
+  // Throws std::out_of_range for unknown ids.
+  CubeCipher load(std::uint64_t id, CubeCipher::Impl impl = CubeCipher::DefaultImpl,
+                  Layout layout = kDefaultLayout,
+                  CubeCipher::Usage usage = CubeCipher::Usage::Both) const;
+
+private:
+  class Mapping;
+
+  const std::uint8_t *find(std::uint64_t id) const;  // index entry or nullptr
+
+  std::shared_ptr<const Mapping> mapping_;
+  std::size_t count_ = 0;
+};
+
+} // namespace cube96
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(CUBE96_ENABLE_METRICS)
+#include <chrono>
+#endif
+
+namespace cube96 {
+
+// Process-wide operation counters and latency histograms, compiled in only
+// when the build is configured with CUBE96_ENABLE_METRICS.  Services read
+// them with metrics_snapshot() or metrics_prometheus() instead of wrapping
+// every call.
+//
+// Counters and histograms are relaxed atomics split over cache-line stripes
+// chosen per thread, so threads encrypting in parallel rarely contend on one
+// line.  The
+// round engines' blocks are counted by direction, CTR keystream blocks
+// included.  Bytes are counted by the mode the caller used: single-block
+// calls, encryptBlocks/decryptBlocks (ECB, also what the parallel helpers
+// call per chunk) and CtrMode keystream.  setKey counts one key per context
+// keyed, including each context of setKeys.
+//
+// Latencies go into log-linear histograms in the style of HdrHistogram:
+// values below 16 ns get a bucket each, and every power of two above is split
+// into 16 buckets, so a bucket's width is at most 1/16 of its lower bound.
+// setKeys records its batch time divided evenly over its keys.
+enum class MetricsMode { SingleBlock, Ecb, Ctr };
+enum class MetricsOp { SetKey, EncryptBlocks, DecryptBlocks, Ctr };
+
+constexpr std::size_t kMetricsModes = 3;
+constexpr std::size_t kMetricsOps = 4;
+
+const char *metrics_mode_name(MetricsMode mode);
+const char *metrics_op_name(MetricsOp op);
+
+struct LatencyHistogram {
+  static constexpr unsigned kSubBucketBits = 4;
+  static constexpr std::size_t kSubBuckets = std::size_t{1} << kSubBucketBits;
+  static constexpr unsigned kMaxExponent = 40;  // 2^40 ns, about 18 minutes
+  static constexpr std::size_t kBuckets = (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+  std::array<std::uint64_t, kBuckets> counts{};
+  std::uint64_t count = 0;
+  std::uint64_t sum_ns = 0;
+
+  // Bucket of a latency; values past the range share the last bucket.
+  static std::size_t bucket_for(std::uint64_t ns);
+  // Smallest latency that falls in the bucket after `bucket`.
+  static std::uint64_t bucket_limit(std::size_t bucket);
+
+  // Upper bound of the bucket holding the q-quantile (0 < q <= 1), or 0
+  // when empty.
+  std::uint64_t percentile_ns(double q) const;
+};
+
+struct MetricsSnapshot {
+  std::uint64_t blocks_encrypted = 0;
+  std::uint64_t blocks_decrypted = 0;
+  std::uint64_t set_key_calls = 0;
+  std::array<std::uint64_t, kMetricsModes> bytes{};  // by MetricsMode
+  std::array<LatencyHistogram, kMetricsOps> latency{};  // by MetricsOp
+};
+
+// True when the library was built with CUBE96_ENABLE_METRICS.  Otherwise the
+// functions below still link and report zeros.
+bool metrics_enabled();
+
+MetricsSnapshot metrics_snapshot();
+
+// Zeroes every counter and histogram.  Operations running concurrently with
+// the reset may be partly kept.
+void metrics_reset();
+
+// Prometheus text exposition (format 0.0.4) of `snapshot`.  Histograms are
+// exported at power-of-two bucket bounds from 256 ns to 2^40 ns, in seconds
+// printed as exact decimals of the nanosecond counts.
+std::string metrics_prometheus(const MetricsSnapshot &snapshot);
+
+namespace detail {
+
+#if defined(CUBE96_ENABLE_METRICS)
+void metrics_count_blocks(bool decrypt, std::uint64_t blocks);
+void metrics_count_bytes(MetricsMode mode, std::uint64_t bytes);
+void metrics_count_keys(std::uint64_t keys);
+void metrics_record(MetricsOp op, std::uint64_t ns, std::uint64_t samples);
+
+// Records the lifetime of the enclosing scope, split evenly over `samples`.
+class MetricsTimer {
+public:
+  explicit MetricsTimer(MetricsOp op, std::uint64_t samples = 1)
+      : op_(op), samples_(samples), start_(std::chrono::steady_clock::now()) {}
+  ~MetricsTimer() {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start_)
+                        .count();
+    metrics_record(op_, static_cast<std::uint64_t>(ns), samples_);
+  }
+  MetricsTimer(const MetricsTimer &) = delete;
+  MetricsTimer &operator=(const MetricsTimer &) = delete;
+
+private:
+  MetricsOp op_;
+  std::uint64_t samples_;
+  std::chrono::steady_clock::time_point start_;
+};
+#else
+inline void metrics_count_blocks(bool, std::uint64_t) {}
+inline void metrics_count_bytes(MetricsMode, std::uint64_t) {}
+inline void metrics_count_keys(std::uint64_t) {}
+
+class MetricsTimer {
+public:
+  explicit MetricsTimer(MetricsOp, std::uint64_t = 1) {}
+};
+#endif
+
+} // namespace detail
+
+} // namespace cube96
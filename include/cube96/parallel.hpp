@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cube96/cipher.hpp"
+#include "cube96/ctr.hpp"
+
+namespace cube96 {
+
+// Runs batches of independent tasks.  run() calls task(i) once for every i in
+// [0, count), possibly concurrently, and returns when all calls are done.  An
+// exception thrown by a task is rethrown from run() after the batch drains.
+// Callers may pass their own implementation to the bulk functions below to
+// share an existing thread pool.
+class Executor {
+public:
+  virtual ~Executor() = default;
+  virtual std::size_t concurrency() const = 0;
+  virtual void run(std::size_t count, const std::function<void(std::size_t)> &task) = 0;
+};
+
+// Work-stealing pool.  A batch is split into contiguous index ranges, one per
+// participant; each participant pops tasks from the front of its own deque
+// and, once empty, steals from the back of the others.  The thread calling
+// run() participates, so a pool of concurrency N owns N - 1 worker threads.
+// Concurrent run() calls on one pool are serialized.  A run() made from inside
+// one of the pool's own tasks (e.g. encrypt_blocks_parallel on the shared
+// pool) executes its batch inline on the calling thread rather than waiting
+// on the batch it is part of.
+class ThreadPool : public Executor {
+public:
+  // `threads` == 0 selects std::thread::hardware_concurrency().
+  explicit ThreadPool(std::size_t threads = 0);
+  ~ThreadPool() override;
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  std::size_t concurrency() const override { return queues_.size(); }
+  void run(std::size_t count, const std::function<void(std::size_t)> &task) override;
+
+  // Library-owned pool sized to the machine, started on first use.
+  static ThreadPool &shared();
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::size_t> tasks;
+  };
+
+  void worker_loop(std::size_t self);
+  void drain(std::size_t self, const std::function<void(std::size_t)> &task);
+  bool pop(std::size_t self, std::size_t &index);
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> workers_;
+
+  std::mutex run_mutex_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  const std::function<void(std::size_t)> *job_ = nullptr;
+  std::uint64_t generation_ = 0;
+  std::size_t active_ = 0;
+  std::atomic<std::size_t> remaining_{0};
+  std::exception_ptr error_;
+  bool stop_ = false;
+};
+
+// Splits `blocks` into chunks sized for `executor` (at least 48 KiB and a
+// multiple of the 64-block bitslice width, about four chunks per participant
+// for balance) and runs CubeCipher::encryptBlocks/decryptBlocks on each.
+// Small inputs or single-threaded executors run inline.  `executor` defaults
+// to ThreadPool::shared(); `in` and `out` may alias.
+void encrypt_blocks_parallel(const CubeCipher &cipher, const std::uint8_t *in,
+                             std::uint8_t *out, std::size_t blocks,
+                             Executor *executor = nullptr);
+void decrypt_blocks_parallel(const CubeCipher &cipher, const std::uint8_t *in,
+                             std::uint8_t *out, std::size_t blocks,
+                             Executor *executor = nullptr);
+
+// CTR counterpart of CtrMode::seek(offset) followed by crypt(in, out, len).
+// Each chunk seeks its own CtrMode, so no chunk depends on another.
+void ctr_crypt_parallel(const CubeCipher &cipher, const std::uint8_t nonce[kCtrNonceBytes],
+                        std::uint32_t initial_counter, std::uint64_t offset,
+                        const std::uint8_t *in, std::uint8_t *out, std::size_t len,
+                        Executor *executor = nullptr);
+
+} // namespace cube96
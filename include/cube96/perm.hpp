@@ -4,7 +4,9 @@
 
 #include <array>
 #include <cstdint>
+#include <vector>
 
+#include "cube96/state.hpp"
 #include "cube96/types.hpp"
 
 namespace cube96 {
@@ -24,8 +26,125 @@ void apply_permutation(const Permutation &p, const std::uint8_t in[kBlockBytes],
 void apply_permutation_ct(const Permutation &p, const std::uint8_t in[kBlockBytes],
                           std::uint8_t out[kBlockBytes]);
 
+// Byte-gather form of a permutation for the fast path.  Entry [b][v] is the
+// image of a block that is zero except for byte b holding v, packed big-endian
+// into the high 64 bits (bytes 0..7) and low 32 bits (bytes 8..11).  Applying
+// the permutation is then 12 lookups and ORs instead of 96 bit moves.  Each
+// table occupies sizeof(GatherTable) = 48 KiB.
+using GatherEntry = State96;
+using GatherTable = std::array<std::array<GatherEntry, 256>, kBlockBytes>;
+
+// When `sbox` is non-null it is folded in front of the permutation, so entry
+// [b][v] holds the image of sbox[v] and one lookup pass performs SubBytes and
+// the permutation together.
+void compile_gather_table(const Permutation &p, GatherTable &table,
+                          const std::uint8_t *sbox = nullptr);
+void apply_gather_table(const GatherTable &table, const std::uint8_t in[kBlockBytes],
+                        std::uint8_t out[kBlockBytes]);
+
+inline State96 apply_gather_table(const GatherTable &table, const State96 &s) {
+  State96 out{0, 0};
+  for (std::size_t b = 0; b < kBlockBytes; ++b) {
+    out = out | table[b][state_byte(s, b)];
+  }
+  return out;
+}
+
+// Constant-time form of a permutation.  The 96 state bits (plus 32 idle bits)
+// are held in a 128-bit word and routed through a 13-stage Beneš network of
+// delta swaps with shifts 64, 32, ..., 1, ..., 32, 64.  Every application
+// executes the same shift/mask sequence whatever the key; only the stage
+// masks, computed once in compile_benes_network, differ between permutations.
+// The packing goes through byte_index_of_bit, so both state layouts route the
+// same way.
+constexpr std::size_t kBenesStages = 13;
+constexpr std::size_t kBenesWidth = 128;
+
+// Position of state bit `bit` inside the 128-bit network word: bytes 0..7
+// fill the high word and bytes 8..11 the low 32 bits of the low word, both
+// big-endian, leaving positions 32..63 idle.  Stage masks carry the bit of the
+// lower position of each swapped pair, positions 64..127 in mask_hi.
+constexpr std::uint8_t benes_position(std::uint8_t bit) {
+  const std::uint8_t byte = byte_index_of_bit(bit);
+  const std::uint8_t pos = bit_offset_in_byte(bit);
+  return byte < 8 ? static_cast<std::uint8_t>(64u + 8u * (7u - byte) + pos)
+                  : static_cast<std::uint8_t>(8u * (11u - byte) + pos);
+}
+
+// Shift of network stage `stage`: 64, 32, ..., 1, ..., 32, 64.
+constexpr unsigned benes_shift(std::size_t stage) {
+  return 64u >> (stage < kBenesStages / 2 ? stage : kBenesStages - 1 - stage);
+}
+
+struct BenesNetwork {
+  std::array<std::uint64_t, kBenesStages> mask_hi{};
+  std::array<std::uint64_t, kBenesStages> mask_lo{};
+};
+
+BenesNetwork compile_benes_network(const Permutation &p);
+void apply_benes_network(const BenesNetwork &net, const std::uint8_t in[kBlockBytes],
+                         std::uint8_t out[kBlockBytes]);
+
+inline State96 apply_benes_network(const BenesNetwork &net, const State96 &s) {
+  // Stage shifts are fixed: 64, 32, ..., 1, ..., 32, 64.  The 64-bit stages
+  // exchange bits between the words; all others act within each word.
+  std::uint64_t hi = s.hi;
+  std::uint64_t lo = s.lo;
+  for (std::size_t stage = 0; stage < kBenesStages; ++stage) {
+    const unsigned shift = benes_shift(stage);
+    if (shift == 64u) {
+      const std::uint64_t t = (hi ^ lo) & net.mask_lo[stage];
+      hi ^= t;
+      lo ^= t;
+    } else {
+      const std::uint64_t th = ((hi >> shift) ^ hi) & net.mask_hi[stage];
+      const std::uint64_t tl = ((lo >> shift) ^ lo) & net.mask_lo[stage];
+      hi ^= th ^ (th << shift);
+      lo ^= tl ^ (tl << shift);
+    }
+  }
+  return State96{hi, static_cast<std::uint32_t>(lo)};
+}
+
 // Returns the curated primitive moves (rotations, row/column cycles, slice
-// shifts) that compose into the round permutations.
-const std::array<Permutation, 36> &primitive_set();
+// shifts) that compose into the round permutations, expressed in `layout`.
+constexpr std::size_t kPrimitiveCount = 36;
+constexpr std::size_t kPrimitiveSteps = 12;  // primitives per round permutation
+
+const std::array<Permutation, kPrimitiveCount> &primitive_set(Layout layout = kDefaultLayout);
+
+// Every ordered pair of primitives, pre-composed: forward[a * 36 + b] applies
+// primitive a and then b, and inverse[a * 36 + b] undoes that pair.  Built on
+// first use per layout (2 x 1296 permutations, 243 KiB).
+struct PrimitivePairTable {
+  std::vector<Permutation> forward;
+  std::vector<Permutation> inverse;
+};
+
+const PrimitivePairTable &primitive_pairs(Layout layout = kDefaultLayout);
+
+// The steps of derive_round_permutation, exposed so they can be timed apart.
+// draw_primitive_pairs draws kPrimitiveSteps primitives from SplitMix64(seed),
+// rejecting draws past the largest multiple of 36, and returns them as
+// primitive_pairs indices in draw order.  compose_pairs_forward composes the
+// pairs in that order; compose_pairs_inverse composes their inverses in
+// reverse order.
+constexpr std::size_t kPrimitivePairs = kPrimitiveSteps / 2;
+using PrimitivePairDraws = std::array<std::size_t, kPrimitivePairs>;
+
+PrimitivePairDraws draw_primitive_pairs(std::uint64_t seed);
+Permutation compose_pairs_forward(const PrimitivePairTable &table,
+                                  const PrimitivePairDraws &pairs);
+Permutation compose_pairs_inverse(const PrimitivePairTable &table,
+                                  const PrimitivePairDraws &pairs);
+
+// Round permutation for one 64-bit seed: the primitives drawn by
+// draw_primitive_pairs, composed in draw order.  Adjacent draws are looked up in primitive_pairs,
+// so the permutation costs 6 table compositions and its inverse, built from
+// the pair inverses in reverse order, another 6.  Either output may be null
+// to skip that direction.  The table index is key-dependent, as the primitive
+// index is in the one-step form.
+void derive_round_permutation(std::uint64_t seed, Layout layout, Permutation *perm,
+                              Permutation *inv);
 
 } // namespace cube96
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "cube96/types.hpp"
+
+#if defined(CUBE96_ENABLE_PROFILING)
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CUBE96_PROFILE_TSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#include <chrono>
+#endif
+#endif
+
+namespace cube96 {
+
+// Per-stage cycle accounting for the round engines, compiled in only when the
+// build is configured with CUBE96_ENABLE_PROFILING.  Each instrumented stage
+// reads the time-stamp counter (steady_clock nanoseconds off x86) on entry and
+// exit and adds the difference to a thread-local counter; without the option
+// CUBE96_PROFILE_SCOPE expands to nothing and the engines compile as before.
+//
+// Stages are filed by direction, round and kind.  Slot r < kRoundCount is
+// encryption round r (decryption charges its work to the round it undoes);
+// slot kProfileFinal holds the post-whitening key and the bitslice
+// transposes.  The fast engine's gather tables fuse SubBytes with the
+// permutation and are reported as SubPermute.
+//
+// The timer costs a few dozen cycles per stage, comparable to a stage itself,
+// so absolute numbers from an instrumented build are inflated; the snapshot
+// carries the measured cost of an empty stage for callers to subtract.
+enum class ProfileDirection { Encrypt, Decrypt };
+enum class ProfileStage { AddRoundKey, SubBytes, Permute, SubPermute, Transpose };
+
+constexpr std::size_t kProfileDirections = 2;
+constexpr std::size_t kProfileStages = 5;
+constexpr std::size_t kProfileSlots = kRoundCount + 1;
+constexpr std::size_t kProfileFinal = kRoundCount;
+
+const char *profile_stage_name(ProfileStage stage);
+
+struct ProfileCounter {
+  std::uint64_t ticks = 0;
+  std::uint64_t calls = 0;
+};
+
+using ProfileTable = std::array<std::array<ProfileCounter, kProfileStages>, kProfileSlots>;
+
+struct ProfileSnapshot {
+  ProfileTable encrypt{};
+  ProfileTable decrypt{};
+  double overhead_ticks = 0.0;  // timer cost of one empty stage
+  const char *unit = "";        // "tsc" or "ns"
+};
+
+// True when the library was built with CUBE96_ENABLE_PROFILING.  Otherwise the
+// functions below still link, and snapshots are all zero.
+bool profiling_enabled();
+
+// Sums the counters of every thread that has run an instrumented stage,
+// including threads that have since exited.
+ProfileSnapshot profile_snapshot();
+
+// Zeroes every thread's counters.  Counts from stages running concurrently
+// with the reset may survive it.
+void profile_reset();
+
+#if defined(CUBE96_ENABLE_PROFILING)
+namespace detail {
+
+struct ProfileCells {
+  std::atomic<std::uint64_t> ticks[kProfileDirections][kProfileSlots][kProfileStages]{};
+  std::atomic<std::uint64_t> calls[kProfileDirections][kProfileSlots][kProfileStages]{};
+};
+
+// This thread's counters, registered with the snapshot list on first use.
+ProfileCells &thread_profile_cells();
+
+inline std::uint64_t profile_ticks() {
+#if defined(CUBE96_PROFILE_TSC)
+  // The fences keep the stage's instructions between the two reads.
+  _mm_lfence();
+  const std::uint64_t t = __rdtsc();
+  _mm_lfence();
+  return t;
+#else
+  return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        std::chrono::steady_clock::now().time_since_epoch())
+                                        .count());
+#endif
+}
+
+// Only the owning thread writes its cells, so a load and a store suffice.
+inline void profile_add(std::atomic<std::uint64_t> &cell, std::uint64_t value) {
+  cell.store(cell.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+class StageTimer {
+public:
+  StageTimer(ProfileDirection direction, std::size_t slot, ProfileStage stage)
+      : cells_(thread_profile_cells()),
+        dir_(static_cast<std::size_t>(direction)),
+        slot_(slot),
+        stage_(static_cast<std::size_t>(stage)),
+        start_(profile_ticks()) {}
+
+  ~StageTimer() {
+    const std::uint64_t end = profile_ticks();
+    profile_add(cells_.ticks[dir_][slot_][stage_], end - start_);
+    profile_add(cells_.calls[dir_][slot_][stage_], 1);
+  }
+
+  StageTimer(const StageTimer &) = delete;
+  StageTimer &operator=(const StageTimer &) = delete;
+
+private:
+  ProfileCells &cells_;
+  std::size_t dir_;
+  std::size_t slot_;
+  std::size_t stage_;
+  std::uint64_t start_;
+};
+
+} // namespace detail
+
+// Times the rest of the enclosing block as one stage.
+#define CUBE96_PROFILE_SCOPE(direction, slot, stage)                                 \
+  const ::cube96::detail::StageTimer cube96_profile_scope_(                        \
+      ::cube96::ProfileDirection::direction, (slot), ::cube96::ProfileStage::stage)
+#else
+#define CUBE96_PROFILE_SCOPE(direction, slot, stage) static_cast<void>(0)
+#endif
+
+} // namespace cube96
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cube96/endian.hpp"
+#include "cube96/types.hpp"
+
+namespace cube96 {
+
+// Register-resident form of a 96-bit block: bytes 0..7 packed big-endian into
+// `hi` and bytes 8..11 packed big-endian into `lo`.  The round engines keep the
+// state in this form from load to store, so a block never round-trips through
+// a byte buffer between rounds.
+struct State96 {
+  std::uint64_t hi;
+  std::uint32_t lo;
+};
+
+inline State96 load_state(const std::uint8_t in[kBlockBytes]) {
+  return State96{load_be64(in), load_be32(in + 8)};
+}
+
+inline void store_state(const State96 &s, std::uint8_t out[kBlockBytes]) {
+  store_be64(s.hi, out);
+  store_be32(s.lo, out + 8);
+}
+
+inline State96 operator^(const State96 &a, const State96 &b) {
+  return State96{a.hi ^ b.hi, a.lo ^ b.lo};
+}
+
+inline State96 operator|(const State96 &a, const State96 &b) {
+  return State96{a.hi | b.hi, a.lo | b.lo};
+}
+
+inline bool operator==(const State96 &a, const State96 &b) {
+  return a.hi == b.hi && a.lo == b.lo;
+}
+
+// Byte `b` of the block in external (big-endian) order.
+inline std::uint8_t state_byte(const State96 &s, std::size_t b) {
+  return b < 8 ? static_cast<std::uint8_t>(s.hi >> (8u * (7u - b)))
+               : static_cast<std::uint8_t>(s.lo >> (8u * (11u - b)));
+}
+
+// Applies `fn` to every byte of the state and repacks the result.
+template <typename ByteFn>
+inline State96 map_state_bytes(const State96 &s, ByteFn fn) {
+  std::uint64_t hi = 0;
+  for (std::size_t b = 0; b < 8; ++b) {
+    hi = (hi << 8) | fn(state_byte(s, b));
+  }
+  std::uint32_t lo = 0;
+  for (std::size_t b = 8; b < kBlockBytes; ++b) {
+    lo = static_cast<std::uint32_t>((lo << 8) | fn(state_byte(s, b)));
+  }
+  return State96{hi, lo};
+}
+
+} // namespace cube96
@@ -28,66 +28,65 @@ using Block      = std::array<std::uint8_t, kBlockBytes>;
 using RoundKey   = std::array<std::uint8_t, kBlockBytes>;
 using Permutation = std::array<std::uint8_t, kPermSize>;
 
-#if defined(CUBE96_LAYOUT_ROWMAJOR)
+// State layouts map cube coordinates (x, y in 0..3, z in 0..5) to bit indices.
+// Both are compiled into every build and selectable per CubeCipher; the
+// CUBE96_LAYOUT_* macro only picks kDefaultLayout.
+enum class Layout { ZSlice, RowMajor };
 
-// Row-major layout: bytes are grouped by y-plane. Each row (fixed y) stores 24
-// bits laid out with x as the major coordinate and z as the minor coordinate.
-// Bits remain packed MSB-first inside each byte.
-constexpr std::uint8_t idx_of(std::uint8_t x, std::uint8_t y, std::uint8_t z) {
-  return static_cast<std::uint8_t>(24u * y + 6u * x + z);
-}
+#if defined(CUBE96_LAYOUT_ROWMAJOR)
+constexpr Layout kDefaultLayout = Layout::RowMajor;
+#else
+constexpr Layout kDefaultLayout = Layout::ZSlice;
+#endif
 
-inline void xyz_of(std::uint8_t idx, std::uint8_t &x, std::uint8_t &y,
-                   std::uint8_t &z) {
-  y = static_cast<std::uint8_t>(idx / 24u);
-  std::uint8_t in_row = static_cast<std::uint8_t>(idx % 24u);
-  x = static_cast<std::uint8_t>(in_row / 6u);
-  z = static_cast<std::uint8_t>(in_row % 6u);
+constexpr const char *layout_name(Layout layout) {
+  return layout == Layout::RowMajor ? "rowmajor" : "zslice";
 }
 
-inline std::uint8_t byte_index_of_bit(std::uint8_t bit_index) {
-  std::uint8_t row = static_cast<std::uint8_t>(bit_index / 24u);
-  std::uint8_t offset = static_cast<std::uint8_t>(bit_index % 24u);
-  std::uint8_t byte_in_row = static_cast<std::uint8_t>(offset / 8u);
-  return static_cast<std::uint8_t>(3u * row + byte_in_row);
+// Default z-slice layout: each z-slice stores two bytes (16 bits) ordered by
+// rows (y) and columns (x).
+// Row-major layout: bytes are grouped by y-plane. Each row (fixed y) stores 24
+// bits laid out with x as the major coordinate and z as the minor coordinate.
+constexpr std::uint8_t idx_of(Layout layout, std::uint8_t x, std::uint8_t y,
+                              std::uint8_t z) {
+  return layout == Layout::RowMajor ? static_cast<std::uint8_t>(24u * y + 6u * x + z)
+                                    : static_cast<std::uint8_t>(16u * z + 4u * y + x);
 }
 
-inline std::uint8_t bit_offset_in_byte(std::uint8_t bit_index) {
-  std::uint8_t offset = static_cast<std::uint8_t>(bit_index % 8u);
-  return static_cast<std::uint8_t>(7u - offset);
+inline void xyz_of(Layout layout, std::uint8_t idx, std::uint8_t &x,
+                   std::uint8_t &y, std::uint8_t &z) {
+  if (layout == Layout::RowMajor) {
+    y = static_cast<std::uint8_t>(idx / 24u);
+    std::uint8_t in_row = static_cast<std::uint8_t>(idx % 24u);
+    x = static_cast<std::uint8_t>(in_row / 6u);
+    z = static_cast<std::uint8_t>(in_row % 6u);
+  } else {
+    z = static_cast<std::uint8_t>(idx / 16u);
+    std::uint8_t in_slice = static_cast<std::uint8_t>(idx % 16u);
+    y = static_cast<std::uint8_t>(in_slice / 4u);
+    x = static_cast<std::uint8_t>(in_slice % 4u);
+  }
 }
 
-#else
-
-// Default z-slice layout: each z-slice stores two bytes (16 bits) ordered by
-// rows (y) and columns (x), with bits packed MSB-first inside each byte.
 constexpr std::uint8_t idx_of(std::uint8_t x, std::uint8_t y, std::uint8_t z) {
-  return static_cast<std::uint8_t>(16u * z + 4u * y + x);
+  return idx_of(kDefaultLayout, x, y, z);
 }
 
 inline void xyz_of(std::uint8_t idx, std::uint8_t &x, std::uint8_t &y,
                    std::uint8_t &z) {
-  z = static_cast<std::uint8_t>(idx / 16u);
-  std::uint8_t in_slice = static_cast<std::uint8_t>(idx % 16u);
-  y = static_cast<std::uint8_t>(in_slice / 4u);
-  x = static_cast<std::uint8_t>(in_slice % 4u);
+  xyz_of(kDefaultLayout, idx, x, y, z);
 }
 
-inline std::uint8_t byte_index_of_bit(std::uint8_t bit_index) {
-  std::uint8_t z = static_cast<std::uint8_t>(bit_index / 16u);
-  std::uint8_t offset = static_cast<std::uint8_t>(bit_index % 16u);
-  std::uint8_t byte_in_slice = static_cast<std::uint8_t>(offset / 8u);
-  return static_cast<std::uint8_t>(2u * z + byte_in_slice);
+// Both layouts group bit indices into whole bytes (2 per z-slice, 3 per row)
+// with bits packed MSB-first, so the byte mapping is the same for either.
+constexpr std::uint8_t byte_index_of_bit(std::uint8_t bit_index) {
+  return static_cast<std::uint8_t>(bit_index / 8u);
 }
 
-inline std::uint8_t bit_offset_in_byte(std::uint8_t bit_index) {
-  std::uint8_t offset = static_cast<std::uint8_t>(bit_index % 16u);
-  std::uint8_t bit_in_byte = static_cast<std::uint8_t>(offset % 8u);
-  return static_cast<std::uint8_t>(7u - bit_in_byte);
+constexpr std::uint8_t bit_offset_in_byte(std::uint8_t bit_index) {
+  return static_cast<std::uint8_t>(7u - bit_index % 8u);
 }
 
-#endif
-
 inline std::uint8_t get_bit(const std::uint8_t s[kBlockBytes],
                             std::uint8_t bit_index) {
   std::uint8_t byte = byte_index_of_bit(bit_index);
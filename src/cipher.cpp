@@ -3,145 +3,344 @@
 #include "cube96/cipher.hpp"
 
 #include <algorithm>
-#include <cstring>
-#include <limits>
+#include <atomic>
+#include <mutex>
 #include <stdexcept>
 
+#include "cube96/endian.hpp"
 #include "cube96/impl_dispatch.hpp"
 #include "cube96/key_schedule.hpp"
+#include "cube96/key_store.hpp"
+#include "cube96/metrics.hpp"
 #include "cube96/perm.hpp"
-#include "cube96/endian.hpp"
 
 namespace cube96 {
 
+namespace {
+
+// Binds the round engine once per context; encrypt/decrypt calls then go
+// straight into a loop specialized for that engine (see engine.hpp).
+const EngineOps &select_engine(CubeCipher::Impl impl) {
+#if !defined(CUBE96_DISABLE_FAST_IMPL)
+  if (impl == CubeCipher::Impl::Fast) {
+    return fast_engine();
+  }
+#else
+  (void)impl;
+#endif
+  return detected_simd_level() >= SimdLevel::Ssse3 ? hardened_simd_engine()
+                                                   : hardened_engine();
+}
+
+} // namespace
+
 // Round structure: the cipher performs kRoundCount iterations of key addition,
 // byte-wise SubBytes, and a permutation whose shape is derived from the key.
 // The caller selects between the fast table S-box and the bitsliced
 // constant-time path through the Impl enum, and the same choice governs the
 // permutation helper so that both halves of the round adhere to the selected
-// side-channel trade-off.
+// side-channel trade-off.  The choice is resolved to an engine once, here,
+// rather than per block or per round.
+
+// Decryption data of a LazyDecrypt context is built at most once per key:
+// readers check `ready` and only the first caller builds, under the mutex.
+struct CubeCipher::LazyState {
+  std::mutex mutex;
+  std::atomic<bool> ready{false};
+};
 
-CubeCipher::CubeCipher(Impl impl) : impl_(impl) {
+CubeCipher::CubeCipher(Impl impl, Layout layout, Usage usage)
+    : impl_(impl), layout_(layout), usage_(usage) {
 #if defined(CUBE96_FORCE_CONSTANT_TIME) || defined(CUBE96_DISABLE_FAST_IMPL)
   if (impl == Impl::Fast) {
     throw std::invalid_argument("Fast implementation disabled at build time");
   }
   impl_ = Impl::Hardened;
 #endif
+  engine_ = &select_engine(impl_);
+  if (usage_ == Usage::LazyDecrypt) {
+    lazy_ = std::make_unique<LazyState>();
+  }
 }
 
-void CubeCipher::setKey(const std::uint8_t key[KeyBytes]) {
-  DerivedMaterial material = derive_material(key);
-  round_keys_ = material.round_keys;
-  rk_post_ = material.post_whitening;
+CubeCipher::~CubeCipher() = default;
 
-  const auto &primitives = primitive_set();
-  const std::size_t primitive_count = primitives.size();
-  const std::uint64_t limit =
-      (std::numeric_limits<std::uint64_t>::max() / primitive_count) * primitive_count;
+CubeCipher::CubeCipher(const CubeCipher &other)
+    : engine_(other.engine_), impl_(other.impl_), layout_(other.layout_),
+      usage_(other.usage_) {
+  if (other.lazy_) {
+    // Hold off a concurrent first decrypt on `other` while its key is copied.
+    std::lock_guard<std::mutex> lock(other.lazy_->mutex);
+    key_ = other.key_;
+    lazy_ = std::make_unique<LazyState>();
+    lazy_->ready.store(other.lazy_->ready.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+  } else {
+    key_ = other.key_;
+  }
+}
 
-  for (std::size_t r = 0; r < kRoundCount; ++r) {
-    std::uint64_t seed = load_be64(material.perm_seeds[r].data());
-    SplitMix64 prng(seed);
-    Permutation perm = identity_permutation();
-    for (int step = 0; step < 12; ++step) {
-      std::uint64_t draw = prng.next();
-      while (draw >= limit) {
-        draw = prng.next();
-      }
-      const std::size_t pick = static_cast<std::size_t>(draw % primitive_count);
-      perm = compose(perm, primitives[pick]);
-    }
-    perm_[r] = perm;
-    inv_perm_[r] = invert(perm);
+CubeCipher &CubeCipher::operator=(const CubeCipher &other) {
+  if (this != &other) {
+    CubeCipher copy(other);
+    *this = std::move(copy);
   }
+  return *this;
 }
 
-void CubeCipher::encryptBlock(const std::uint8_t in[BlockBytes],
-                              std::uint8_t out[BlockBytes]) const {
-  std::uint8_t buf_a[BlockBytes];
-  std::uint8_t buf_b[BlockBytes];
-  std::memcpy(buf_a, in, BlockBytes);
-  std::uint8_t *cur = buf_a;
-  std::uint8_t *next = buf_b;
+CubeCipher::CubeCipher(CubeCipher &&other) noexcept = default;
+CubeCipher &CubeCipher::operator=(CubeCipher &&other) noexcept = default;
 
-#if !defined(CUBE96_DISABLE_FAST_IMPL)
-  const bool use_fast = (impl_ == Impl::Fast);
-#else
-  const bool use_fast = false;
-#endif
+void CubeCipher::setKey(const std::uint8_t key[KeyBytes]) {
+  const detail::MetricsTimer timer(MetricsOp::SetKey);
+  applyMaterial(derive_material(key));
+  detail::metrics_count_keys(1);
+}
 
-  for (std::size_t r = 0; r < kRoundCount; ++r) {
-    for (std::size_t i = 0; i < BlockBytes; ++i) {
-      cur[i] ^= round_keys_[r][i];
+void CubeCipher::setKeys(const std::uint8_t *keys, std::size_t n, CubeCipher *contexts) {
+  // Derive in slices so the material buffer stays on the stack.
+  constexpr std::size_t kSlice = 64;
+  const detail::MetricsTimer timer(MetricsOp::SetKey, n);
+  DerivedMaterial material[kSlice];
+  for (std::size_t first = 0; first < n; first += kSlice) {
+    const std::size_t count = std::min(kSlice, n - first);
+    derive_materials(keys + first * KeyBytes, count, material);
+    for (std::size_t i = 0; i < count; ++i) {
+      contexts[first + i].applyMaterial(material[i]);
     }
+    detail::metrics_count_keys(count);
+  }
+}
 
-    if (use_fast) {
-#if !defined(CUBE96_DISABLE_FAST_IMPL)
-      sub_bytes_fast(cur);
-#endif
-    } else {
-      sub_bytes_hardened(cur);
-    }
+void CubeCipher::applyMaterial(const DerivedMaterial &material) {
+  key_.round_keys = material.round_keys;
+  key_.rk_post = material.post_whitening;
+  for (std::size_t r = 0; r < kRoundCount; ++r) {
+    key_.rk_packed[r] = load_state(key_.round_keys[r].data());
+  }
+  key_.rk_post_packed = load_state(key_.rk_post.data());
 
-    if (use_fast) {
-#if !defined(CUBE96_DISABLE_FAST_IMPL)
-      apply_permutation(perm_[r], cur, next);
-#endif
-    } else {
-      apply_permutation_ct(perm_[r], cur, next);
-    }
-    std::swap(cur, next);
+  // Directions this context does not expand now keep empty vectors, which
+  // also drops whatever a previous key left behind.
+  const bool encrypt = usage_ != Usage::DecryptOnly;
+  const bool decrypt = usage_ == Usage::Both || usage_ == Usage::DecryptOnly;
+  key_.perm.resize(encrypt ? kRoundCount : 0);
+  key_.inv_perm.resize(decrypt ? kRoundCount : 0);
+  if (!encrypt) {
+    key_.perm_tables.clear();
+    key_.perm_nets.clear();
+  }
+  if (!decrypt) {
+    key_.inv_perm_tables.clear();
+    key_.inv_perm_nets.clear();
+  }
+  for (std::size_t r = 0; r < kRoundCount; ++r) {
+    derive_round_permutation(load_be64(material.perm_seeds[r].data()), layout_,
+                             encrypt ? &key_.perm[r] : nullptr,
+                             decrypt ? &key_.inv_perm[r] : nullptr);
   }
 
-  for (std::size_t i = 0; i < BlockBytes; ++i) {
-    cur[i] ^= rk_post_[i];
+  // The bound engine compiles its own tables: 384 KiB per direction of fused
+  // SubBytes + permutation tables for the fast engine, delta-swap networks
+  // for the hardened ones.
+  if (encrypt) {
+    engine_->prepare_encrypt(key_);
+  }
+  if (decrypt) {
+    engine_->prepare_decrypt(key_);
+  }
+  if (lazy_) {
+    lazy_->ready.store(false, std::memory_order_release);
   }
-  std::memcpy(out, cur, BlockBytes);
 }
 
-void CubeCipher::decryptBlock(const std::uint8_t in[BlockBytes],
-                              std::uint8_t out[BlockBytes]) const {
-  std::uint8_t buf_a[BlockBytes];
-  std::uint8_t buf_b[BlockBytes];
-  std::memcpy(buf_a, in, BlockBytes);
-  std::uint8_t *cur = buf_a;
-  std::uint8_t *next = buf_b;
-
-#if !defined(CUBE96_DISABLE_FAST_IMPL)
-  const bool use_fast = (impl_ == Impl::Fast);
-#else
-  const bool use_fast = false;
-#endif
+void CubeCipher::prepareDecrypt() const {
+  if (usage_ == Usage::EncryptOnly) {
+    wrongDirection();
+  }
+  if (lazy_->ready.load(std::memory_order_acquire)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(lazy_->mutex);
+  if (lazy_->ready.load(std::memory_order_relaxed)) {
+    return;
+  }
+  // Inverting the forward permutations is cheaper than rederiving them.
+  key_.inv_perm.resize(kRoundCount);
+  for (std::size_t r = 0; r < kRoundCount; ++r) {
+    key_.inv_perm[r] = invert(key_.perm[r]);
+  }
+  engine_->prepare_decrypt(key_);
+  lazy_->ready.store(true, std::memory_order_release);
+}
 
-  for (std::size_t i = 0; i < BlockBytes; ++i) {
-    cur[i] ^= rk_post_[i];
+std::vector<std::uint8_t> CubeCipher::exportExpandedKey(bool include_tables) const {
+  std::unique_lock<std::mutex> lock;
+  if (lazy_) {
+    lock = std::unique_lock<std::mutex>(lazy_->mutex);
+  }
+  if (key_.perm.empty() && key_.inv_perm.empty()) {
+    throw std::logic_error("CubeCipher has no key to export");
+  }
+  const std::uint8_t zero[BlockBytes] = {};
+  std::uint8_t check[BlockBytes];
+  if (!key_.perm.empty()) {
+    engine_->encrypt_block(key_, zero, check);
+  } else {
+    engine_->decrypt_block(key_, zero, check);
   }
+  return encode_expanded_key(key_, layout_, check, include_tables);
+}
 
-  for (int r = static_cast<int>(kRoundCount) - 1; r >= 0; --r) {
-    if (use_fast) {
-#if !defined(CUBE96_DISABLE_FAST_IMPL)
-      apply_permutation(inv_perm_[r], cur, next);
-#endif
-    } else {
-      apply_permutation_ct(inv_perm_[r], cur, next);
-    }
-    std::swap(cur, next);
+void CubeCipher::importExpandedKey(const std::uint8_t *data, std::size_t len) {
+  importExpandedKey(data, len, nullptr);
+}
 
-    if (use_fast) {
-#if !defined(CUBE96_DISABLE_FAST_IMPL)
-      inv_sub_bytes_fast(cur);
-#endif
-    } else {
-      inv_sub_bytes_hardened(cur);
-    }
+void CubeCipher::importExpandedKey(const std::uint8_t *data, std::size_t len,
+                                   std::shared_ptr<const void> backing) {
+  ExpandedKey key;
+  std::uint8_t check[BlockBytes];
+  const std::uint8_t contents = decode_expanded_key(data, len, layout_, backing, key, check);
 
-    for (std::size_t i = 0; i < BlockBytes; ++i) {
-      cur[i] ^= round_keys_[r][i];
+  // A LazyDecrypt context takes the decryption side only when the record
+  // makes it free, i.e. ships this engine's inverse tables.
+  const std::uint8_t tables = impl_ == Impl::Fast ? kRecordGatherTables : kRecordBenesNetworks;
+  const bool encrypt = usage_ != Usage::DecryptOnly;
+  const bool decrypt =
+      usage_ == Usage::Both || usage_ == Usage::DecryptOnly ||
+      (usage_ == Usage::LazyDecrypt && (contents & kRecordInverse) && (contents & tables));
+  if (encrypt && key.perm.empty()) {
+    key.perm.resize(kRoundCount);
+    for (std::size_t r = 0; r < kRoundCount; ++r) {
+      key.perm[r] = invert(key.inv_perm[r]);
+    }
+  }
+  if (decrypt && key.inv_perm.empty()) {
+    key.inv_perm.resize(kRoundCount);
+    for (std::size_t r = 0; r < kRoundCount; ++r) {
+      key.inv_perm[r] = invert(key.perm[r]);
     }
   }
+  if (!encrypt) {
+    key.perm.clear();
+  }
+  if (!decrypt) {
+    key.inv_perm.clear();
+  }
+  // Keep only the tables this engine runs on for the directions it serves,
+  // then compile any the record did not carry.
+  if (impl_ == Impl::Fast) {
+    key.perm_nets.clear();
+    key.inv_perm_nets.clear();
+  } else {
+    key.perm_tables.clear();
+    key.inv_perm_tables.clear();
+  }
+  if (!encrypt) {
+    key.perm_tables.clear();
+    key.perm_nets.clear();
+  }
+  if (!decrypt) {
+    key.inv_perm_tables.clear();
+    key.inv_perm_nets.clear();
+  }
+  const bool fwd_ready = impl_ == Impl::Fast ? !key.perm_tables.empty() : !key.perm_nets.empty();
+  const bool inv_ready =
+      impl_ == Impl::Fast ? !key.inv_perm_tables.empty() : !key.inv_perm_nets.empty();
+  if (encrypt && !fwd_ready) {
+    engine_->prepare_encrypt(key);
+  }
+  if (decrypt && !inv_ready) {
+    engine_->prepare_decrypt(key);
+  }
+
+  // The check block is E(0), or D(0) for a record without forward
+  // permutations; either is verifiable from the direction this context has.
+  // It catches a corrupt record before the context is put to use.
+  const std::uint8_t zero[BlockBytes] = {};
+  std::uint8_t probe[BlockBytes];
+  const bool forward_check = (contents & kRecordForward) != 0;
+  const std::uint8_t *expected = zero;
+  if (forward_check && encrypt) {
+    engine_->encrypt_block(key, zero, probe);
+    expected = check;
+  } else if (forward_check) {
+    engine_->decrypt_block(key, check, probe);
+  } else if (decrypt) {
+    engine_->decrypt_block(key, zero, probe);
+    expected = check;
+  } else {
+    engine_->encrypt_block(key, check, probe);
+  }
+  if (!std::equal(probe, probe + BlockBytes, expected)) {
+    throw std::invalid_argument("Expanded-key record failed its check block");
+  }
+
+  key_ = std::move(key);
+  if (lazy_) {
+    lazy_->ready.store(decrypt, std::memory_order_release);
+  }
+}
+
+void CubeCipher::wrongDirection() const {
+  throw std::logic_error(usage_ == Usage::EncryptOnly
+                             ? "CubeCipher context was set up for encryption only"
+                             : "CubeCipher context was set up for decryption only");
+}
+
+std::size_t CubeCipher::memoryFootprint() const {
+  std::unique_lock<std::mutex> lock;
+  if (lazy_) {
+    lock = std::unique_lock<std::mutex>(lazy_->mutex);
+  }
+  return sizeof(*this) + (lazy_ ? sizeof(LazyState) : 0) +
+         (key_.perm.capacity() + key_.inv_perm.capacity()) * sizeof(Permutation) +
+         (key_.perm_tables.capacity() + key_.inv_perm_tables.capacity()) *
+             sizeof(GatherTable) +
+         (key_.perm_nets.capacity() + key_.inv_perm_nets.capacity()) * sizeof(BenesNetwork);
+}
+
+const char *CubeCipher::engineName() const { return engine_->name; }
+
+void CubeCipher::encryptBlock(const std::uint8_t in[BlockBytes],
+                              std::uint8_t out[BlockBytes]) const {
+  requireEncrypt();
+  engine_->encrypt_block(key_, in, out);
+  detail::metrics_count_blocks(false, 1);
+  detail::metrics_count_bytes(MetricsMode::SingleBlock, BlockBytes);
+}
+
+void CubeCipher::decryptBlock(const std::uint8_t in[BlockBytes],
+                              std::uint8_t out[BlockBytes]) const {
+  requireDecrypt();
+  engine_->decrypt_block(key_, in, out);
+  detail::metrics_count_blocks(true, 1);
+  detail::metrics_count_bytes(MetricsMode::SingleBlock, BlockBytes);
+}
+
+void CubeCipher::encryptBlocks(const std::uint8_t *in, std::uint8_t *out,
+                               std::size_t blocks) const {
+  requireEncrypt();
+  const detail::MetricsTimer timer(MetricsOp::EncryptBlocks);
+  engine_->encrypt_blocks(key_, in, out, blocks);
+  detail::metrics_count_blocks(false, blocks);
+  detail::metrics_count_bytes(MetricsMode::Ecb, blocks * BlockBytes);
+}
+
+void CubeCipher::encryptKeystream(const std::uint8_t *in, std::uint8_t *out,
+                                  std::size_t blocks) const {
+  requireEncrypt();
+  engine_->encrypt_blocks(key_, in, out, blocks);
+  detail::metrics_count_blocks(false, blocks);
+}
 
-  std::memcpy(out, cur, BlockBytes);
+void CubeCipher::decryptBlocks(const std::uint8_t *in, std::uint8_t *out,
+                               std::size_t blocks) const {
+  requireDecrypt();
+  const detail::MetricsTimer timer(MetricsOp::DecryptBlocks);
+  engine_->decrypt_blocks(key_, in, out, blocks);
+  detail::metrics_count_blocks(true, blocks);
+  detail::metrics_count_bytes(MetricsMode::Ecb, blocks * BlockBytes);
 }
 
 } // namespace cube96
@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: MIT
+
+#include "cube96/ctr.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "cube96/endian.hpp"
+#include "cube96/metrics.hpp"
+
+namespace cube96 {
+
+CtrMode::CtrMode(const CubeCipher &cipher, const std::uint8_t nonce[kCtrNonceBytes],
+                 std::uint32_t initial_counter)
+    : cipher_(&cipher), nonce_(load_be64(nonce)), initial_counter_(initial_counter) {}
+
+std::uint64_t CtrMode::keystreamBytes() const {
+  const std::uint64_t blocks = (std::uint64_t{1} << 32) - initial_counter_;
+  return blocks * kBlockBytes;
+}
+
+void CtrMode::seek(std::uint64_t offset) {
+  if (offset > keystreamBytes()) {
+    throw std::out_of_range("CTR offset beyond the 32-bit counter space");
+  }
+  position_ = offset;
+}
+
+void CtrMode::crypt(const std::uint8_t *in, std::uint8_t *out, std::size_t len) {
+  generate<true>(in, out, len);
+}
+
+void CtrMode::keystream(std::uint8_t *out, std::size_t len) {
+  generate<false>(nullptr, out, len);
+}
+
+template <bool Xor>
+void CtrMode::generate(const std::uint8_t *in, std::uint8_t *out, std::size_t len) {
+  if (len > keystreamBytes() - position_) {
+    throw std::out_of_range("CTR range exceeds the 32-bit counter space");
+  }
+  const detail::MetricsTimer timer(MetricsOp::Ctr);
+
+  // Counter blocks share the nonce half, so it is written once per call and
+  // only the counter words change between chunks.
+  std::uint8_t counters[kCtrChunkBlocks * kBlockBytes];
+  std::uint8_t stream[kCtrChunkBlocks * kBlockBytes];
+  for (std::size_t i = 0; i < kCtrChunkBlocks; ++i) {
+    store_be64(nonce_, counters + i * kBlockBytes);
+  }
+
+  std::size_t done = 0;
+  while (done < len) {
+    const std::uint64_t block = position_ / kBlockBytes;
+    const std::size_t skip = static_cast<std::size_t>(position_ % kBlockBytes);
+    const std::size_t want = skip + (len - done);
+    const std::size_t blocks =
+        std::min(kCtrChunkBlocks, (want + kBlockBytes - 1) / kBlockBytes);
+    for (std::size_t i = 0; i < blocks; ++i) {
+      store_be32(static_cast<std::uint32_t>(initial_counter_ + block + i),
+                 counters + i * kBlockBytes + 8);
+    }
+    cipher_->encryptKeystream(counters, stream, blocks);
+
+    const std::size_t take = std::min(len - done, blocks * kBlockBytes - skip);
+    if constexpr (Xor) {
+      for (std::size_t i = 0; i < take; ++i) {
+        out[done + i] = static_cast<std::uint8_t>(in[done + i] ^ stream[skip + i]);
+      }
+    } else {
+      std::copy(stream + skip, stream + skip + take, out + done);
+    }
+    done += take;
+    position_ += take;
+  }
+  detail::metrics_count_bytes(MetricsMode::Ctr, len);
+}
+
+CtrStream::CtrStream(const CubeCipher &cipher, const std::uint8_t nonce[kCtrNonceBytes],
+                     std::uint32_t initial_counter)
+    : mode_(cipher, nonce, initial_counter) {}
+
+CtrStream::~CtrStream() { wipe_tail(); }
+
+std::uint64_t CtrStream::bytesProcessed() const {
+  return mode_.position() - (kBlockBytes - tail_used_);
+}
+
+void CtrStream::update(const std::uint8_t *in, std::uint8_t *out, std::size_t len) {
+  if (finalized_) {
+    throw std::logic_error("CtrStream::update called after finalize");
+  }
+  if (len > mode_.keystreamBytes() - bytesProcessed()) {
+    throw std::out_of_range("CTR range exceeds the 32-bit counter space");
+  }
+
+  // Leftover keystream from the previous call's partial block.
+  std::size_t done = 0;
+  while (done < len && tail_used_ < kBlockBytes) {
+    out[done] = static_cast<std::uint8_t>(in[done] ^ tail_[tail_used_++]);
+    ++done;
+  }
+
+  // Whole blocks, batched by CtrMode from a block-aligned position.
+  const std::size_t whole = (len - done) / kBlockBytes * kBlockBytes;
+  mode_.crypt(in + done, out + done, whole);
+  done += whole;
+
+  // A trailing partial block: cache its keystream for the next call.
+  if (done < len) {
+    mode_.keystream(tail_, kBlockBytes);
+    tail_used_ = 0;
+    while (done < len) {
+      out[done] = static_cast<std::uint8_t>(in[done] ^ tail_[tail_used_++]);
+      ++done;
+    }
+  }
+}
+
+std::uint64_t CtrStream::finalize() {
+  const std::uint64_t total = bytesProcessed();
+  wipe_tail();
+  finalized_ = true;
+  return total;
+}
+
+void CtrStream::wipe_tail() {
+  volatile std::uint8_t *p = tail_;
+  for (std::size_t i = 0; i < kBlockBytes; ++i) {
+    p[i] = 0;
+  }
+}
+
+} // namespace cube96
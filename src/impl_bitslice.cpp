@@ -0,0 +1,420 @@
+// SPDX-License-Identifier: MIT
+
+#include "cube96/bitslice.hpp"
+
+#include "cube96/impl_dispatch.hpp"
+#include "cube96/profile.hpp"
+
+#if !defined(CUBE96_DISABLE_SIMD) && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define CUBE96_BITSLICE_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace cube96 {
+namespace {
+
+// 8x8 bit-matrix transpose; bit 8*r + c of the input becomes bit 8*c + r.
+inline std::uint64_t transpose8x8(std::uint64_t x) {
+  std::uint64_t t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+  x ^= t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+  x ^= t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+  x ^= t ^ (t << 28);
+  return x;
+}
+
+inline std::uint64_t key_mask(const RoundKey &rk, std::uint8_t bit_index) {
+  return 0u - static_cast<std::uint64_t>(get_bit(rk.data(), bit_index));
+}
+
+// The state is held as one plane per Beneš network position (benes_position
+// in perm.hpp), so the key's compiled networks route whole planes.  Every
+// index below is fixed; only the swap masks depend on the key.
+using NetPlanes = std::array<std::uint64_t, kBenesWidth>;
+
+void add_round_key(NetPlanes &planes, const RoundKey &rk) {
+  for (std::uint8_t i = 0; i < kPermSize; ++i) {
+    planes[benes_position(i)] ^= key_mask(rk, i);
+  }
+}
+
+template <void (*Sbox)(std::uint64_t *)>
+void sub_bytes_planes(NetPlanes &planes) {
+  for (std::uint8_t b = 0; b < kBlockBytes; ++b) {
+    // Byte b occupies eight adjacent positions, most significant bit highest.
+    std::uint64_t *byte = &planes[benes_position(static_cast<std::uint8_t>(8 * b + 7))];
+    std::uint64_t u[8];
+    for (std::size_t k = 0; k < 8; ++k) {
+      u[k] = byte[7 - k];
+    }
+    Sbox(u);
+    for (std::size_t k = 0; k < 8; ++k) {
+      byte[7 - k] = u[k];
+    }
+  }
+}
+
+// Stage `stage` swaps planes p and p + shift where its mask has bit p set, as
+// a masked exchange over every pair.  A group of pairs never straddles the two
+// mask words, so each group reads its mask bits from one of them.
+inline void permute_stage(NetPlanes &planes, const BenesNetwork &net, std::size_t stage) {
+  const unsigned shift = benes_shift(stage);
+  for (std::size_t base = 0; base < kBenesWidth; base += 2 * shift) {
+    std::uint64_t mask = (base < 64 ? net.mask_lo[stage] : net.mask_hi[stage]) >> (base & 63);
+    std::uint64_t *lower = &planes[base];
+    std::uint64_t *upper = &planes[base + shift];
+    for (std::size_t p = 0; p < shift; ++p, mask >>= 1) {
+      const std::uint64_t t = (lower[p] ^ upper[p]) & (0u - (mask & 1u));
+      lower[p] ^= t;
+      upper[p] ^= t;
+    }
+  }
+}
+
+void permute_planes_scalar(NetPlanes &planes, const BenesNetwork &net) {
+  for (std::size_t stage = 0; stage < kBenesStages; ++stage) {
+    permute_stage(planes, net, stage);
+  }
+}
+
+#if defined(CUBE96_BITSLICE_AVX2)
+// Four pairs per step: each lane's swap mask is its mask bit compared against
+// that lane's bit.  With shift 1 or 2 both members of a pair sit in the same
+// four planes, so a step swaps them with a lane shuffle instead.
+__attribute__((target("avx2"))) void permute_planes_avx2(NetPlanes &planes,
+                                                         const BenesNetwork &net) {
+  const __m256i lane_bits = _mm256_set_epi64x(8, 4, 2, 1);
+  const __m256i shift1_bits = _mm256_set_epi64x(4, 4, 1, 1);
+  const __m256i shift2_bits = _mm256_set_epi64x(2, 1, 2, 1);
+  for (std::size_t stage = 0; stage < kBenesStages; ++stage) {
+    const unsigned shift = benes_shift(stage);
+    if (shift < 4) {
+      const __m256i bits = shift == 1 ? shift1_bits : shift2_bits;
+      for (std::size_t q = 0; q < kBenesWidth; q += 4) {
+        const std::uint64_t mask = (q < 64 ? net.mask_lo[stage] : net.mask_hi[stage]) >> (q & 63);
+        __m256i m = _mm256_set1_epi64x(static_cast<long long>(mask));
+        m = _mm256_cmpeq_epi64(_mm256_and_si256(m, bits), bits);
+        __m256i *at = reinterpret_cast<__m256i *>(&planes[q]);
+        const __m256i x = _mm256_loadu_si256(at);
+        const __m256i swapped = shift == 1 ? _mm256_permute4x64_epi64(x, 0xB1)
+                                           : _mm256_permute4x64_epi64(x, 0x4E);
+        const __m256i t = _mm256_and_si256(_mm256_xor_si256(x, swapped), m);
+        _mm256_storeu_si256(at, _mm256_xor_si256(x, t));
+      }
+      continue;
+    }
+    for (std::size_t base = 0; base < kBenesWidth; base += 2 * shift) {
+      const std::uint64_t mask =
+          (base < 64 ? net.mask_lo[stage] : net.mask_hi[stage]) >> (base & 63);
+      std::uint64_t *lower = &planes[base];
+      std::uint64_t *upper = &planes[base + shift];
+      for (std::size_t p = 0; p < shift; p += 4) {
+        __m256i m = _mm256_set1_epi64x(static_cast<long long>(mask >> p));
+        m = _mm256_cmpeq_epi64(_mm256_and_si256(m, lane_bits), lane_bits);
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lower + p));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(upper + p));
+        const __m256i t = _mm256_and_si256(_mm256_xor_si256(a, b), m);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lower + p), _mm256_xor_si256(a, t));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(upper + p), _mm256_xor_si256(b, t));
+      }
+    }
+  }
+}
+#endif
+
+using PermuteFn = void (*)(NetPlanes &, const BenesNetwork &);
+
+PermuteFn permute_planes() {
+#if defined(CUBE96_BITSLICE_AVX2)
+  static const PermuteFn fn = detected_simd_level() >= SimdLevel::Avx2
+                                  ? permute_planes_avx2
+                                  : permute_planes_scalar;
+  return fn;
+#else
+  return permute_planes_scalar;
+#endif
+}
+
+void load_planes(const std::uint8_t *in, std::size_t blocks, NetPlanes &planes) {
+  BitPlanes ordered;
+  bitslice_pack(in, blocks, ordered);
+  planes.fill(0);
+  for (std::uint8_t i = 0; i < kPermSize; ++i) {
+    planes[benes_position(i)] = ordered[i];
+  }
+}
+
+void store_planes(const NetPlanes &planes, std::uint8_t *out, std::size_t blocks) {
+  BitPlanes ordered;
+  for (std::uint8_t i = 0; i < kPermSize; ++i) {
+    ordered[i] = planes[benes_position(i)];
+  }
+  bitslice_unpack(ordered, out, blocks);
+}
+
+// Rijndael inverse affine map rotl(x,1) ^ rotl(x,3) ^ rotl(x,6) ^ 0x05 on
+// MSB-first planes; the constant complements planes 5 and 7.
+void inverse_affine_planes(std::uint64_t u[8]) {
+  std::uint64_t x[8];
+  for (int j = 0; j < 8; ++j) {
+    x[j] = u[j];
+  }
+  for (int j = 0; j < 8; ++j) {
+    u[j] = x[(j + 1) & 7] ^ x[(j + 3) & 7] ^ x[(j + 6) & 7];
+  }
+  u[5] = ~u[5];
+  u[7] = ~u[7];
+}
+
+} // namespace
+
+void bitslice_pack(const std::uint8_t *in, std::size_t blocks, BitPlanes &planes) {
+  planes.fill(0);
+  for (std::size_t g = 0; g * 8 < blocks; ++g) {
+    const std::size_t rows = blocks - g * 8 < 8 ? blocks - g * 8 : 8;
+    for (std::size_t b = 0; b < kBlockBytes; ++b) {
+      std::uint64_t x = 0;
+      for (std::size_t m = 0; m < rows; ++m) {
+        x |= static_cast<std::uint64_t>(in[(8 * g + m) * kBlockBytes + b]) << (8 * m);
+      }
+      x = transpose8x8(x);
+      for (std::size_t c = 0; c < 8; ++c) {
+        planes[8 * b + 7 - c] |= ((x >> (8 * c)) & 0xFFu) << (8 * g);
+      }
+    }
+  }
+}
+
+void bitslice_unpack(const BitPlanes &planes, std::uint8_t *out, std::size_t blocks) {
+  for (std::size_t g = 0; g * 8 < blocks; ++g) {
+    const std::size_t rows = blocks - g * 8 < 8 ? blocks - g * 8 : 8;
+    for (std::size_t b = 0; b < kBlockBytes; ++b) {
+      std::uint64_t x = 0;
+      for (std::size_t c = 0; c < 8; ++c) {
+        x |= ((planes[8 * b + 7 - c] >> (8 * g)) & 0xFFu) << (8 * c);
+      }
+      x = transpose8x8(x);
+      for (std::size_t m = 0; m < rows; ++m) {
+        out[(8 * g + m) * kBlockBytes + b] = static_cast<std::uint8_t>(x >> (8 * m));
+      }
+    }
+  }
+}
+
+// Boyar–Peralta depth-16 circuit for the AES S-box (113 gates): a linear top
+// layer, a shared GF(2^4) inversion core, and a linear bottom layer.
+void sbox_bitsliced64(std::uint64_t u[8]) {
+  const std::uint64_t U0 = u[0], U1 = u[1], U2 = u[2], U3 = u[3];
+  const std::uint64_t U4 = u[4], U5 = u[5], U6 = u[6], U7 = u[7];
+
+  const std::uint64_t T1 = U0 ^ U3;
+  const std::uint64_t T2 = U0 ^ U5;
+  const std::uint64_t T3 = U0 ^ U6;
+  const std::uint64_t T4 = U3 ^ U5;
+  const std::uint64_t T5 = U4 ^ U6;
+  const std::uint64_t T6 = T1 ^ T5;
+  const std::uint64_t T7 = U1 ^ U2;
+  const std::uint64_t T8 = U7 ^ T6;
+  const std::uint64_t T9 = U7 ^ T7;
+  const std::uint64_t T10 = T6 ^ T7;
+  const std::uint64_t T11 = U1 ^ U5;
+  const std::uint64_t T12 = U2 ^ U5;
+  const std::uint64_t T13 = T3 ^ T4;
+  const std::uint64_t T14 = T6 ^ T11;
+  const std::uint64_t T15 = T5 ^ T11;
+  const std::uint64_t T16 = T5 ^ T12;
+  const std::uint64_t T17 = T9 ^ T16;
+  const std::uint64_t T18 = U3 ^ U7;
+  const std::uint64_t T19 = T7 ^ T18;
+  const std::uint64_t T20 = T1 ^ T19;
+  const std::uint64_t T21 = U6 ^ U7;
+  const std::uint64_t T22 = T7 ^ T21;
+  const std::uint64_t T23 = T2 ^ T22;
+  const std::uint64_t T24 = T2 ^ T10;
+  const std::uint64_t T25 = T20 ^ T17;
+  const std::uint64_t T26 = T3 ^ T16;
+  const std::uint64_t T27 = T1 ^ T12;
+
+  const std::uint64_t M1 = T13 & T6;
+  const std::uint64_t M2 = T23 & T8;
+  const std::uint64_t M3 = T14 ^ M1;
+  const std::uint64_t M4 = T19 & U7;
+  const std::uint64_t M5 = M4 ^ M1;
+  const std::uint64_t M6 = T3 & T16;
+  const std::uint64_t M7 = T22 & T9;
+  const std::uint64_t M8 = T26 ^ M6;
+  const std::uint64_t M9 = T20 & T17;
+  const std::uint64_t M10 = M9 ^ M6;
+  const std::uint64_t M11 = T1 & T15;
+  const std::uint64_t M12 = T4 & T27;
+  const std::uint64_t M13 = M12 ^ M11;
+  const std::uint64_t M14 = T2 & T10;
+  const std::uint64_t M15 = M14 ^ M11;
+  const std::uint64_t M16 = M3 ^ M2;
+  const std::uint64_t M17 = M5 ^ T24;
+  const std::uint64_t M18 = M8 ^ M7;
+  const std::uint64_t M19 = M10 ^ M15;
+  const std::uint64_t M20 = M16 ^ M13;
+  const std::uint64_t M21 = M17 ^ M15;
+  const std::uint64_t M22 = M18 ^ M13;
+  const std::uint64_t M23 = M19 ^ T25;
+  const std::uint64_t M24 = M22 ^ M23;
+  const std::uint64_t M25 = M22 & M20;
+  const std::uint64_t M26 = M21 ^ M25;
+  const std::uint64_t M27 = M20 ^ M21;
+  const std::uint64_t M28 = M23 ^ M25;
+  const std::uint64_t M29 = M28 & M27;
+  const std::uint64_t M30 = M26 & M24;
+  const std::uint64_t M31 = M20 & M23;
+  const std::uint64_t M32 = M27 & M31;
+  const std::uint64_t M33 = M27 ^ M25;
+  const std::uint64_t M34 = M21 & M22;
+  const std::uint64_t M35 = M24 & M34;
+  const std::uint64_t M36 = M24 ^ M25;
+  const std::uint64_t M37 = M21 ^ M29;
+  const std::uint64_t M38 = M32 ^ M33;
+  const std::uint64_t M39 = M23 ^ M30;
+  const std::uint64_t M40 = M35 ^ M36;
+  const std::uint64_t M41 = M38 ^ M40;
+  const std::uint64_t M42 = M37 ^ M39;
+  const std::uint64_t M43 = M37 ^ M38;
+  const std::uint64_t M44 = M39 ^ M40;
+  const std::uint64_t M45 = M42 ^ M41;
+  const std::uint64_t M46 = M44 & T6;
+  const std::uint64_t M47 = M40 & T8;
+  const std::uint64_t M48 = M39 & U7;
+  const std::uint64_t M49 = M43 & T16;
+  const std::uint64_t M50 = M38 & T9;
+  const std::uint64_t M51 = M37 & T17;
+  const std::uint64_t M52 = M42 & T15;
+  const std::uint64_t M53 = M45 & T27;
+  const std::uint64_t M54 = M41 & T10;
+  const std::uint64_t M55 = M44 & T13;
+  const std::uint64_t M56 = M40 & T23;
+  const std::uint64_t M57 = M39 & T19;
+  const std::uint64_t M58 = M43 & T3;
+  const std::uint64_t M59 = M38 & T22;
+  const std::uint64_t M60 = M37 & T20;
+  const std::uint64_t M61 = M42 & T1;
+  const std::uint64_t M62 = M45 & T4;
+  const std::uint64_t M63 = M41 & T2;
+
+  const std::uint64_t L0 = M61 ^ M62;
+  const std::uint64_t L1 = M50 ^ M56;
+  const std::uint64_t L2 = M46 ^ M48;
+  const std::uint64_t L3 = M47 ^ M55;
+  const std::uint64_t L4 = M54 ^ M58;
+  const std::uint64_t L5 = M49 ^ M61;
+  const std::uint64_t L6 = M62 ^ L5;
+  const std::uint64_t L7 = M46 ^ L3;
+  const std::uint64_t L8 = M51 ^ M59;
+  const std::uint64_t L9 = M52 ^ M53;
+  const std::uint64_t L10 = M53 ^ L4;
+  const std::uint64_t L11 = M60 ^ L2;
+  const std::uint64_t L12 = M48 ^ M51;
+  const std::uint64_t L13 = M50 ^ L0;
+  const std::uint64_t L14 = M52 ^ M61;
+  const std::uint64_t L15 = M55 ^ L1;
+  const std::uint64_t L16 = M56 ^ L0;
+  const std::uint64_t L17 = M57 ^ L1;
+  const std::uint64_t L18 = M58 ^ L8;
+  const std::uint64_t L19 = M63 ^ L4;
+  const std::uint64_t L20 = L0 ^ L1;
+  const std::uint64_t L21 = L1 ^ L7;
+  const std::uint64_t L22 = L3 ^ L12;
+  const std::uint64_t L23 = L18 ^ L2;
+  const std::uint64_t L24 = L15 ^ L9;
+  const std::uint64_t L25 = L6 ^ L10;
+  const std::uint64_t L26 = L7 ^ L9;
+  const std::uint64_t L27 = L8 ^ L10;
+  const std::uint64_t L28 = L11 ^ L14;
+  const std::uint64_t L29 = L11 ^ L17;
+
+  u[0] = L6 ^ L24;
+  u[1] = ~(L16 ^ L26);
+  u[2] = ~(L19 ^ L28);
+  u[3] = L6 ^ L21;
+  u[4] = L20 ^ L22;
+  u[5] = L25 ^ L29;
+  u[6] = ~(L13 ^ L27);
+  u[7] = ~(L6 ^ L23);
+}
+
+// S^-1(y) = A^-1(S(A^-1(y))), where A^-1 is the full inverse affine map:
+// the forward circuit supplies the field inversion.
+void inv_sbox_bitsliced64(std::uint64_t u[8]) {
+  inverse_affine_planes(u);
+  sbox_bitsliced64(u);
+  inverse_affine_planes(u);
+}
+
+void bitslice_encrypt(const std::array<RoundKey, kRoundCount> &round_keys,
+                      const RoundKey &rk_post,
+                      const BenesNetwork *perm_nets,
+                      const std::uint8_t *in, std::uint8_t *out,
+                      std::size_t blocks) {
+  const PermuteFn permute = permute_planes();
+  NetPlanes planes;
+  {
+    CUBE96_PROFILE_SCOPE(Encrypt, kProfileFinal, Transpose);
+    load_planes(in, blocks, planes);
+  }
+
+  for (std::size_t r = 0; r < kRoundCount; ++r) {
+    {
+      CUBE96_PROFILE_SCOPE(Encrypt, r, AddRoundKey);
+      add_round_key(planes, round_keys[r]);
+    }
+    {
+      CUBE96_PROFILE_SCOPE(Encrypt, r, SubBytes);
+      sub_bytes_planes<sbox_bitsliced64>(planes);
+    }
+    CUBE96_PROFILE_SCOPE(Encrypt, r, Permute);
+    permute(planes, perm_nets[r]);
+  }
+  {
+    CUBE96_PROFILE_SCOPE(Encrypt, kProfileFinal, AddRoundKey);
+    add_round_key(planes, rk_post);
+  }
+
+  CUBE96_PROFILE_SCOPE(Encrypt, kProfileFinal, Transpose);
+  store_planes(planes, out, blocks);
+}
+
+void bitslice_decrypt(const std::array<RoundKey, kRoundCount> &round_keys,
+                      const RoundKey &rk_post,
+                      const BenesNetwork *inv_perm_nets,
+                      const std::uint8_t *in, std::uint8_t *out,
+                      std::size_t blocks) {
+  const PermuteFn permute = permute_planes();
+  NetPlanes planes;
+  {
+    CUBE96_PROFILE_SCOPE(Decrypt, kProfileFinal, Transpose);
+    load_planes(in, blocks, planes);
+  }
+
+  {
+    CUBE96_PROFILE_SCOPE(Decrypt, kProfileFinal, AddRoundKey);
+    add_round_key(planes, rk_post);
+  }
+  for (int r = static_cast<int>(kRoundCount) - 1; r >= 0; --r) {
+    const std::size_t round = static_cast<std::size_t>(r);
+    {
+      CUBE96_PROFILE_SCOPE(Decrypt, round, Permute);
+      permute(planes, inv_perm_nets[round]);
+    }
+    {
+      CUBE96_PROFILE_SCOPE(Decrypt, round, SubBytes);
+      sub_bytes_planes<inv_sbox_bitsliced64>(planes);
+    }
+    CUBE96_PROFILE_SCOPE(Decrypt, round, AddRoundKey);
+    add_round_key(planes, round_keys[round]);
+  }
+
+  CUBE96_PROFILE_SCOPE(Decrypt, kProfileFinal, Transpose);
+  store_planes(planes, out, blocks);
+}
+
+} // namespace cube96
@@ -2,6 +2,8 @@
 
 #include "cube96/impl_dispatch.hpp"
 
+#include "cube96/engine.hpp"
+#include "cube96/profile.hpp"
 #include "cube96/sbox.hpp"
 #include "cube96/types.hpp"
 
@@ -22,4 +24,130 @@ void inv_sub_bytes_fast(std::uint8_t state[kBlockBytes]) {
   }
 }
 
+namespace {
+
+// Encryption tables fold AES_SBOX in front of each round permutation, so a
+// round is a key XOR followed by 12 lookups and ORs.
+//
+// Decryption applies SubBytes after the permutation, so the inverse tables are
+// shifted by one round: table r - 1 folds AES_INV_SBOX of round r in front of
+// inv_perm[r - 1], and round key r is pre-permuted by inv_perm[r - 1].
+// inv_perm[kRoundCount - 1] is applied on its own at the start and the final
+// AES_INV_SBOX plus round key 0 at the end.
+struct FastRound {
+  static constexpr const char *kName = "fast";
+  // Four lanes keep the working set (state, round key, table) in L1 while
+  // giving the out-of-order core independent dependency chains to overlap.
+  static constexpr std::size_t kLanes = 4;
+  static constexpr bool kBitsliceBatch = false;
+
+  static void prepare_encrypt(ExpandedKey &key) {
+    key.perm_tables.resize(kRoundCount);
+    for (std::size_t r = 0; r < kRoundCount; ++r) {
+      compile_gather_table(key.perm[r], key.perm_tables[r], AES_SBOX);
+    }
+  }
+
+  static void prepare_decrypt(ExpandedKey &key) {
+    key.inv_perm_tables.resize(kRoundCount);
+    compile_gather_table(key.inv_perm[kRoundCount - 1], key.inv_perm_tables[kRoundCount - 1]);
+    key.rk_inv_packed[0] = key.rk_packed[0];
+    for (std::size_t r = 1; r < kRoundCount; ++r) {
+      compile_gather_table(key.inv_perm[r - 1], key.inv_perm_tables[r - 1], AES_INV_SBOX);
+      RoundKey permuted{};
+      apply_permutation(key.inv_perm[r - 1], key.round_keys[r].data(), permuted.data());
+      key.rk_inv_packed[r] = load_state(permuted.data());
+    }
+  }
+
+  // Profiled builds time the key XOR and the table lookups of all lanes as
+  // separate stages; otherwise each lane's round is one expression.
+  template <std::size_t R>
+  static void round(State96 *s, std::size_t lanes, const State96 &rk,
+                    const GatherTable &table) {
+#if defined(CUBE96_ENABLE_PROFILING)
+    {
+      CUBE96_PROFILE_SCOPE(Encrypt, R, AddRoundKey);
+      for (std::size_t l = 0; l < lanes; ++l) {
+        s[l] = s[l] ^ rk;
+      }
+    }
+    CUBE96_PROFILE_SCOPE(Encrypt, R, SubPermute);
+    for (std::size_t l = 0; l < lanes; ++l) {
+      s[l] = apply_gather_table(table, s[l]);
+    }
+#else
+    for (std::size_t l = 0; l < lanes; ++l) {
+      s[l] = apply_gather_table(table, s[l] ^ rk);
+    }
+#endif
+  }
+
+  // Table R - 1 with round key R: round R's inverse S-box, then round R - 1's
+  // inverse permutation.
+  template <std::size_t R>
+  static void inv_round(State96 *s, std::size_t lanes, const State96 &rk,
+                        const GatherTable &table) {
+#if defined(CUBE96_ENABLE_PROFILING)
+    {
+      CUBE96_PROFILE_SCOPE(Decrypt, R, SubPermute);
+      for (std::size_t l = 0; l < lanes; ++l) {
+        s[l] = apply_gather_table(table, s[l]);
+      }
+    }
+    CUBE96_PROFILE_SCOPE(Decrypt, R, AddRoundKey);
+    for (std::size_t l = 0; l < lanes; ++l) {
+      s[l] = s[l] ^ rk;
+    }
+#else
+    for (std::size_t l = 0; l < lanes; ++l) {
+      s[l] = apply_gather_table(table, s[l]) ^ rk;
+    }
+#endif
+  }
+
+  template <std::size_t... R>
+  static void encrypt_rounds(const ExpandedKey &key, State96 *s, std::size_t lanes,
+                             std::index_sequence<R...>) {
+    (round<R>(s, lanes, key.rk_packed[R], key.perm_tables[R]), ...);
+    CUBE96_PROFILE_SCOPE(Encrypt, kProfileFinal, AddRoundKey);
+    for (std::size_t l = 0; l < lanes; ++l) {
+      s[l] = s[l] ^ key.rk_post_packed;
+    }
+  }
+
+  // Folds over kRoundCount - 1 indices; the first and last steps are unfused
+  // and are profiled whole, key XORs included.
+  template <std::size_t... R>
+  static void decrypt_rounds(const ExpandedKey &key, State96 *s, std::size_t lanes,
+                             std::index_sequence<R...>) {
+    {
+      CUBE96_PROFILE_SCOPE(Decrypt, kRoundCount - 1, Permute);
+      for (std::size_t l = 0; l < lanes; ++l) {
+        s[l] = apply_gather_table(key.inv_perm_tables[kRoundCount - 1], s[l] ^ key.rk_post_packed);
+      }
+    }
+    (inv_round<kRoundCount - 1 - R>(s, lanes, key.rk_inv_packed[kRoundCount - 1 - R],
+                                    key.inv_perm_tables[kRoundCount - 2 - R]),
+     ...);
+    CUBE96_PROFILE_SCOPE(Decrypt, 0, SubBytes);
+    for (std::size_t l = 0; l < lanes; ++l) {
+      s[l] = map_state_bytes(s[l], [](std::uint8_t v) { return AES_INV_SBOX[v]; }) ^
+             key.rk_packed[0];
+    }
+  }
+
+  static void encrypt(const ExpandedKey &key, State96 *s, std::size_t lanes) {
+    encrypt_rounds(key, s, lanes, RoundIndices{});
+  }
+
+  static void decrypt(const ExpandedKey &key, State96 *s, std::size_t lanes) {
+    decrypt_rounds(key, s, lanes, std::make_index_sequence<kRoundCount - 1>{});
+  }
+};
+
+} // namespace
+
+const EngineOps &fast_engine() { return RoundEngine<FastRound>::ops(); }
+
 } // namespace cube96
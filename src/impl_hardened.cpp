@@ -2,24 +2,137 @@
 
 #include "cube96/impl_dispatch.hpp"
 
-#include "cube96/sbox.hpp"
+#include "cube96/engine.hpp"
+#include "cube96/profile.hpp"
 #include "cube96/types.hpp"
 
 namespace cube96 {
 
-// The hardened variant evaluates the AES S-box with a bitsliced expression
-// that avoids secret-dependent memory access.  It trades additional logic for
-// constant-time behaviour across supported platforms.
+// The hardened variant evaluates the AES S-box without secret-dependent
+// memory access: through the shuffle-based vector kernel where available and
+// the bitsliced scalar expression otherwise.
 void sub_bytes_hardened(std::uint8_t state[kBlockBytes]) {
-  for (std::size_t i = 0; i < kBlockBytes; ++i) {
-    state[i] = aes_sbox_bitsliced(state[i]);
-  }
+  sub_bytes_vec(state, kBlockBytes);
 }
 
 void inv_sub_bytes_hardened(std::uint8_t state[kBlockBytes]) {
-  for (std::size_t i = 0; i < kBlockBytes; ++i) {
-    state[i] = aes_inv_sbox_bitsliced(state[i]);
+  inv_sub_bytes_vec(state, kBlockBytes);
+}
+
+namespace {
+
+// Hardened round: constant-time state S-box `Sub`/`InvSub` followed by the
+// round permutation as a Beneš network.  Batches go through the 64-way
+// bitsliced engine, padding a short tail with idle lanes.
+template <State96 (*Sub)(const State96 &), State96 (*InvSub)(const State96 &)>
+struct HardenedRound {
+  static constexpr std::size_t kLanes = 1;
+  static constexpr bool kBitsliceBatch = true;
+
+  static void prepare_encrypt(ExpandedKey &key) {
+    key.perm_nets.resize(kRoundCount);
+    for (std::size_t r = 0; r < kRoundCount; ++r) {
+      key.perm_nets[r] = compile_benes_network(key.perm[r]);
+    }
+  }
+
+  static void prepare_decrypt(ExpandedKey &key) {
+    key.inv_perm_nets.resize(kRoundCount);
+    for (std::size_t r = 0; r < kRoundCount; ++r) {
+      key.inv_perm_nets[r] = compile_benes_network(key.inv_perm[r]);
+    }
   }
+
+#if defined(CUBE96_ENABLE_PROFILING)
+  // Profiled builds split each round into one timed statement per stage.
+  template <std::size_t R>
+  static State96 encrypt_round(const ExpandedKey &key, State96 s) {
+    {
+      CUBE96_PROFILE_SCOPE(Encrypt, R, AddRoundKey);
+      s = s ^ key.rk_packed[R];
+    }
+    {
+      CUBE96_PROFILE_SCOPE(Encrypt, R, SubBytes);
+      s = Sub(s);
+    }
+    CUBE96_PROFILE_SCOPE(Encrypt, R, Permute);
+    return apply_benes_network(key.perm_nets[R], s);
+  }
+
+  template <std::size_t R>
+  static State96 decrypt_round(const ExpandedKey &key, State96 s) {
+    {
+      CUBE96_PROFILE_SCOPE(Decrypt, R, Permute);
+      s = apply_benes_network(key.inv_perm_nets[R], s);
+    }
+    {
+      CUBE96_PROFILE_SCOPE(Decrypt, R, SubBytes);
+      s = InvSub(s);
+    }
+    CUBE96_PROFILE_SCOPE(Decrypt, R, AddRoundKey);
+    return s ^ key.rk_packed[R];
+  }
+
+  template <std::size_t... R>
+  static State96 encrypt_rounds(const ExpandedKey &key, State96 s, std::index_sequence<R...>) {
+    ((s = encrypt_round<R>(key, s)), ...);
+    CUBE96_PROFILE_SCOPE(Encrypt, kProfileFinal, AddRoundKey);
+    return s ^ key.rk_post_packed;
+  }
+
+  template <std::size_t... R>
+  static State96 decrypt_rounds(const ExpandedKey &key, State96 s, std::index_sequence<R...>) {
+    {
+      CUBE96_PROFILE_SCOPE(Decrypt, kProfileFinal, AddRoundKey);
+      s = s ^ key.rk_post_packed;
+    }
+    ((s = decrypt_round<kRoundCount - 1 - R>(key, s)), ...);
+    return s;
+  }
+#else
+  template <std::size_t... R>
+  static State96 encrypt_rounds(const ExpandedKey &key, State96 s, std::index_sequence<R...>) {
+    ((s = apply_benes_network(key.perm_nets[R], Sub(s ^ key.rk_packed[R]))), ...);
+    return s ^ key.rk_post_packed;
+  }
+
+  template <std::size_t... R>
+  static State96 decrypt_rounds(const ExpandedKey &key, State96 s, std::index_sequence<R...>) {
+    s = s ^ key.rk_post_packed;
+    ((s = InvSub(apply_benes_network(key.inv_perm_nets[kRoundCount - 1 - R], s)) ^
+          key.rk_packed[kRoundCount - 1 - R]),
+     ...);
+    return s;
+  }
+#endif
+
+  static void encrypt(const ExpandedKey &key, State96 *s, std::size_t lanes) {
+    for (std::size_t l = 0; l < lanes; ++l) {
+      s[l] = encrypt_rounds(key, s[l], RoundIndices{});
+    }
+  }
+
+  static void decrypt(const ExpandedKey &key, State96 *s, std::size_t lanes) {
+    for (std::size_t l = 0; l < lanes; ++l) {
+      s[l] = decrypt_rounds(key, s[l], RoundIndices{});
+    }
+  }
+};
+
+struct HardenedScalarRound : HardenedRound<sub_state_scalar, inv_sub_state_scalar> {
+  static constexpr const char *kName = "hardened";
+};
+
+struct HardenedSimdRound : HardenedRound<sub_state_ssse3, inv_sub_state_ssse3> {
+  static constexpr const char *kName = "hardened-simd";
+};
+
+} // namespace
+
+const EngineOps &hardened_engine() { return RoundEngine<HardenedScalarRound>::ops(); }
+
+const EngineOps &hardened_simd_engine() {
+  return RoundEngine<HardenedSimdRound>::ops();
 }
 
 } // namespace cube96
@@ -0,0 +1,543 @@
+// SPDX-License-Identifier: MIT
+
+#include "cube96/impl_dispatch.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "cube96/perm.hpp"
+#include "cube96/sbox.hpp"
+
+#if !defined(CUBE96_DISABLE_SIMD) &&                                          \
+    (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||            \
+     defined(_M_IX86))
+#define CUBE96_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define CUBE96_TARGET_SSSE3
+#define CUBE96_TARGET_AVX2
+#else
+#define CUBE96_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define CUBE96_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace cube96 {
+namespace {
+
+// The AES field GF(2^8) = GF(2)[x]/(x^8+x^4+x^3+x+1) is mapped onto the tower
+// GF((2^4)^2) = GF(16)[Y]/(Y^2+Y+lambda) with GF(16) = GF(2)[z]/(z^4+z+1).
+// A tower element a1*Y + a0 is inverted as
+//   d = lambda*a1^2 + a1*a0 + a0^2,  inv = (a1/d)*Y + (a0+a1)/d,
+// which needs only GF(16) operations.  Every GF(16) table has 16 entries and
+// fits a single byte-shuffle register; products go through log/exp tables
+// with a saturating log(0) marker whose high bit makes the final shuffle
+// return zero.  The linear maps into and out of the tower (including the AES
+// affine layer) are split per nibble into two shuffles.  All tables below are
+// derived from the field definitions at compile time.
+
+constexpr std::uint8_t gf16_mul(std::uint8_t a, std::uint8_t b) {
+  std::uint8_t r = 0;
+  for (int i = 0; i < 4; ++i) {
+    if (b & 1u) {
+      r = static_cast<std::uint8_t>(r ^ a);
+    }
+    b = static_cast<std::uint8_t>(b >> 1);
+    a = static_cast<std::uint8_t>(a << 1);
+    if (a & 0x10u) {
+      a = static_cast<std::uint8_t>(a ^ 0x13u);
+    }
+  }
+  return r;
+}
+
+// Y^2 + Y + 8 has no root in GF(16), so the tower is a field.
+constexpr std::uint8_t kLambda = 8;
+
+constexpr std::uint8_t tower_mul(std::uint8_t a, std::uint8_t b) {
+  const std::uint8_t a1 = static_cast<std::uint8_t>(a >> 4);
+  const std::uint8_t a0 = static_cast<std::uint8_t>(a & 0x0Fu);
+  const std::uint8_t b1 = static_cast<std::uint8_t>(b >> 4);
+  const std::uint8_t b0 = static_cast<std::uint8_t>(b & 0x0Fu);
+  const std::uint8_t hh = gf16_mul(a1, b1);
+  const std::uint8_t c1 =
+      static_cast<std::uint8_t>(hh ^ gf16_mul(a1, b0) ^ gf16_mul(a0, b1));
+  const std::uint8_t c0 =
+      static_cast<std::uint8_t>(gf16_mul(kLambda, hh) ^ gf16_mul(a0, b0));
+  return static_cast<std::uint8_t>((c1 << 4) | c0);
+}
+
+constexpr std::uint8_t tower_pow(std::uint8_t a, int n) {
+  std::uint8_t r = 1;
+  for (int i = 0; i < n; ++i) {
+    r = tower_mul(r, a);
+  }
+  return r;
+}
+
+// 0x20 (= z*Y) is a root of the AES polynomial in the tower, so x -> 0x20
+// extends to a field isomorphism.
+constexpr std::uint8_t kBeta = 0x20;
+static_assert((tower_pow(kBeta, 8) ^ tower_pow(kBeta, 4) ^ tower_pow(kBeta, 3) ^
+               kBeta ^ 1u) == 0,
+              "kBeta must be a root of x^8 + x^4 + x^3 + x + 1");
+
+constexpr std::uint8_t to_tower(std::uint8_t x) {
+  std::uint8_t r = 0;
+  for (int k = 0; k < 8; ++k) {
+    if ((x >> k) & 1u) {
+      r = static_cast<std::uint8_t>(r ^ tower_pow(kBeta, k));
+    }
+  }
+  return r;
+}
+
+constexpr std::uint8_t from_tower(std::uint8_t y) {
+  for (unsigned x = 0; x < 256; ++x) {
+    if (to_tower(static_cast<std::uint8_t>(x)) == y) {
+      return static_cast<std::uint8_t>(x);
+    }
+  }
+  return 0;
+}
+
+constexpr std::uint8_t rotl8(std::uint8_t x, int r) {
+  return static_cast<std::uint8_t>((x << r) | (x >> (8 - r)));
+}
+
+// Linear parts of the Rijndael affine map and its inverse.
+constexpr std::uint8_t affine_linear(std::uint8_t x) {
+  return static_cast<std::uint8_t>(x ^ rotl8(x, 1) ^ rotl8(x, 2) ^ rotl8(x, 3) ^
+                                   rotl8(x, 4));
+}
+
+constexpr std::uint8_t inverse_affine_linear(std::uint8_t x) {
+  return static_cast<std::uint8_t>(rotl8(x, 1) ^ rotl8(x, 3) ^ rotl8(x, 6));
+}
+
+constexpr std::uint8_t kLogZero = 0xF0;
+
+struct FieldTables {
+  std::uint8_t log[16];
+  std::uint8_t exp[16];
+  std::uint8_t neg_log[16];   // log(1/a)
+  std::uint8_t square[16];
+  std::uint8_t lambda_square[16];
+};
+
+constexpr FieldTables make_field_tables() {
+  FieldTables t{};
+  std::uint8_t e = 1;
+  for (std::uint8_t k = 0; k < 15; ++k) {
+    t.exp[k] = e;
+    t.log[e] = k;
+    e = gf16_mul(e, 2);
+  }
+  t.log[0] = kLogZero;
+  t.neg_log[0] = kLogZero;
+  for (std::uint8_t a = 1; a < 16; ++a) {
+    t.neg_log[a] = static_cast<std::uint8_t>((15 - t.log[a]) % 15);
+  }
+  for (std::uint8_t a = 0; a < 16; ++a) {
+    t.square[a] = gf16_mul(a, a);
+    t.lambda_square[a] = gf16_mul(kLambda, t.square[a]);
+  }
+  return t;
+}
+
+// Per-direction nibble tables: high/low tower coordinates of the input map,
+// indexed by input low/high nibble, and the output map indexed by the
+// inverted tower coordinates.
+struct DirectionTables {
+  std::uint8_t a1_lo[16];
+  std::uint8_t a1_hi[16];
+  std::uint8_t a0_lo[16];
+  std::uint8_t a0_hi[16];
+  std::uint8_t out_hi[16];
+  std::uint8_t out_lo[16];
+};
+
+// Forward: S(x) = A(inv(x)) ^ 0x63.
+constexpr DirectionTables make_forward_tables() {
+  DirectionTables t{};
+  for (std::uint8_t v = 0; v < 16; ++v) {
+    const std::uint8_t lo = to_tower(v);
+    const std::uint8_t hi = to_tower(static_cast<std::uint8_t>(v << 4));
+    t.a1_lo[v] = static_cast<std::uint8_t>(lo >> 4);
+    t.a0_lo[v] = static_cast<std::uint8_t>(lo & 0x0Fu);
+    t.a1_hi[v] = static_cast<std::uint8_t>(hi >> 4);
+    t.a0_hi[v] = static_cast<std::uint8_t>(hi & 0x0Fu);
+    t.out_hi[v] = static_cast<std::uint8_t>(
+        affine_linear(from_tower(static_cast<std::uint8_t>(v << 4))) ^ 0x63u);
+    t.out_lo[v] = affine_linear(from_tower(v));
+  }
+  return t;
+}
+
+// Inverse: S^-1(y) = inv(A^-1(y)), with A^-1(y) = A_lin^-1(y) ^ 0x05; the
+// constant is folded into the low-nibble input tables.
+constexpr DirectionTables make_inverse_tables() {
+  DirectionTables t{};
+  const std::uint8_t constant = to_tower(0x05);
+  for (std::uint8_t v = 0; v < 16; ++v) {
+    const std::uint8_t lo =
+        static_cast<std::uint8_t>(to_tower(inverse_affine_linear(v)) ^ constant);
+    const std::uint8_t hi =
+        to_tower(inverse_affine_linear(static_cast<std::uint8_t>(v << 4)));
+    t.a1_lo[v] = static_cast<std::uint8_t>(lo >> 4);
+    t.a0_lo[v] = static_cast<std::uint8_t>(lo & 0x0Fu);
+    t.a1_hi[v] = static_cast<std::uint8_t>(hi >> 4);
+    t.a0_hi[v] = static_cast<std::uint8_t>(hi & 0x0Fu);
+    t.out_hi[v] = from_tower(static_cast<std::uint8_t>(v << 4));
+    t.out_lo[v] = from_tower(v);
+  }
+  return t;
+}
+
+constexpr FieldTables kField = make_field_tables();
+constexpr DirectionTables kForward = make_forward_tables();
+constexpr DirectionTables kInverse = make_inverse_tables();
+
+void sub_bytes_scalar(std::uint8_t *data, std::size_t len) {
+  for (std::size_t i = 0; i < len; ++i) {
+    data[i] = aes_sbox_bitsliced(data[i]);
+  }
+}
+
+void inv_sub_bytes_scalar(std::uint8_t *data, std::size_t len) {
+  for (std::size_t i = 0; i < len; ++i) {
+    data[i] = aes_inv_sbox_bitsliced(data[i]);
+  }
+}
+
+#if defined(CUBE96_SIMD_X86)
+
+struct Tables128 {
+  __m128i a1_lo, a1_hi, a0_lo, a0_hi, out_hi, out_lo;
+  __m128i log, exp, neg_log, square, lambda_square;
+};
+
+CUBE96_TARGET_SSSE3 inline __m128i load16(const std::uint8_t t[16]) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(t));
+}
+
+CUBE96_TARGET_SSSE3 inline Tables128 load_tables128(const DirectionTables &d) {
+  return Tables128{load16(d.a1_lo),          load16(d.a1_hi),
+                   load16(d.a0_lo),          load16(d.a0_hi),
+                   load16(d.out_hi),         load16(d.out_lo),
+                   load16(kField.log),       load16(kField.exp),
+                   load16(kField.neg_log),   load16(kField.square),
+                   load16(kField.lambda_square)};
+}
+
+// exp((la + lb) mod 15), or zero when either log carries the zero marker.
+CUBE96_TARGET_SSSE3 inline __m128i exp_log_sum128(const Tables128 &t, __m128i la,
+                                                  __m128i lb) {
+  const __m128i sum = _mm_adds_epu8(la, lb);
+  const __m128i reduced = _mm_min_epu8(sum, _mm_sub_epi8(sum, _mm_set1_epi8(15)));
+  return _mm_shuffle_epi8(t.exp, reduced);
+}
+
+CUBE96_TARGET_SSSE3 inline __m128i tower_sbox128(const Tables128 &t, __m128i x) {
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  const __m128i lo = _mm_and_si128(x, nibble);
+  const __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), nibble);
+  const __m128i a1 = _mm_xor_si128(_mm_shuffle_epi8(t.a1_lo, lo), _mm_shuffle_epi8(t.a1_hi, hi));
+  const __m128i a0 = _mm_xor_si128(_mm_shuffle_epi8(t.a0_lo, lo), _mm_shuffle_epi8(t.a0_hi, hi));
+  const __m128i la1 = _mm_shuffle_epi8(t.log, a1);
+  const __m128i la0 = _mm_shuffle_epi8(t.log, a0);
+  const __m128i delta =
+      _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(t.lambda_square, a1),
+                                  _mm_shuffle_epi8(t.square, a0)),
+                    exp_log_sum128(t, la1, la0));
+  const __m128i inv_delta = _mm_shuffle_epi8(t.neg_log, delta);
+  const __m128i c1 = exp_log_sum128(t, la1, inv_delta);
+  const __m128i c0 =
+      exp_log_sum128(t, _mm_shuffle_epi8(t.log, _mm_xor_si128(a0, a1)), inv_delta);
+  return _mm_xor_si128(_mm_shuffle_epi8(t.out_hi, c1), _mm_shuffle_epi8(t.out_lo, c0));
+}
+
+CUBE96_TARGET_SSSE3 void tower_bytes_ssse3(const DirectionTables &d, std::uint8_t *data,
+                                           std::size_t len) {
+  const Tables128 t = load_tables128(d);
+  std::size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i *p = reinterpret_cast<__m128i *>(data + i);
+    _mm_storeu_si128(p, tower_sbox128(t, _mm_loadu_si128(p)));
+  }
+  if (i < len) {
+    alignas(16) std::uint8_t tail[16] = {0};
+    std::memcpy(tail, data + i, len - i);
+    __m128i *p = reinterpret_cast<__m128i *>(tail);
+    _mm_store_si128(p, tower_sbox128(t, _mm_load_si128(p)));
+    std::memcpy(data + i, tail, len - i);
+  }
+}
+
+CUBE96_TARGET_SSSE3 State96 tower_state_ssse3(const DirectionTables &d, const State96 &s) {
+  const Tables128 t = load_tables128(d);
+  alignas(16) std::uint64_t words[2] = {s.hi, s.lo};
+  __m128i *p = reinterpret_cast<__m128i *>(words);
+  _mm_store_si128(p, tower_sbox128(t, _mm_load_si128(p)));
+  return State96{words[0], static_cast<std::uint32_t>(words[1])};
+}
+
+struct Tables256 {
+  __m256i a1_lo, a1_hi, a0_lo, a0_hi, out_hi, out_lo;
+  __m256i log, exp, neg_log, square, lambda_square;
+};
+
+// vpshufb shuffles within each 128-bit lane, so every table is broadcast.
+CUBE96_TARGET_AVX2 inline __m256i load32(const std::uint8_t t[16]) {
+  return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(t)));
+}
+
+CUBE96_TARGET_AVX2 inline __m256i exp_log_sum256(const Tables256 &t, __m256i la,
+                                                 __m256i lb) {
+  const __m256i sum = _mm256_adds_epu8(la, lb);
+  const __m256i reduced =
+      _mm256_min_epu8(sum, _mm256_sub_epi8(sum, _mm256_set1_epi8(15)));
+  return _mm256_shuffle_epi8(t.exp, reduced);
+}
+
+CUBE96_TARGET_AVX2 inline __m256i tower_sbox256(const Tables256 &t, __m256i x) {
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  const __m256i lo = _mm256_and_si256(x, nibble);
+  const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble);
+  const __m256i a1 =
+      _mm256_xor_si256(_mm256_shuffle_epi8(t.a1_lo, lo), _mm256_shuffle_epi8(t.a1_hi, hi));
+  const __m256i a0 =
+      _mm256_xor_si256(_mm256_shuffle_epi8(t.a0_lo, lo), _mm256_shuffle_epi8(t.a0_hi, hi));
+  const __m256i la1 = _mm256_shuffle_epi8(t.log, a1);
+  const __m256i la0 = _mm256_shuffle_epi8(t.log, a0);
+  const __m256i delta =
+      _mm256_xor_si256(_mm256_xor_si256(_mm256_shuffle_epi8(t.lambda_square, a1),
+                                        _mm256_shuffle_epi8(t.square, a0)),
+                       exp_log_sum256(t, la1, la0));
+  const __m256i inv_delta = _mm256_shuffle_epi8(t.neg_log, delta);
+  const __m256i c1 = exp_log_sum256(t, la1, inv_delta);
+  const __m256i c0 =
+      exp_log_sum256(t, _mm256_shuffle_epi8(t.log, _mm256_xor_si256(a0, a1)), inv_delta);
+  return _mm256_xor_si256(_mm256_shuffle_epi8(t.out_hi, c1),
+                          _mm256_shuffle_epi8(t.out_lo, c0));
+}
+
+CUBE96_TARGET_AVX2 void tower_bytes_avx2(const DirectionTables &d, std::uint8_t *data,
+                                         std::size_t len) {
+  const Tables256 t{load32(d.a1_lo),        load32(d.a1_hi),
+                    load32(d.a0_lo),        load32(d.a0_hi),
+                    load32(d.out_hi),       load32(d.out_lo),
+                    load32(kField.log),     load32(kField.exp),
+                    load32(kField.neg_log), load32(kField.square),
+                    load32(kField.lambda_square)};
+  std::size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i *p = reinterpret_cast<__m256i *>(data + i);
+    _mm256_storeu_si256(p, tower_sbox256(t, _mm256_loadu_si256(p)));
+  }
+  if (i < len) {
+    alignas(32) std::uint8_t tail[32] = {0};
+    std::memcpy(tail, data + i, len - i);
+    __m256i *p = reinterpret_cast<__m256i *>(tail);
+    _mm256_store_si256(p, tower_sbox256(t, _mm256_load_si256(p)));
+    std::memcpy(data + i, tail, len - i);
+  }
+}
+
+static_assert(kPermSize % 32 == 0, "compose kernels work on whole 16/32-byte slices");
+
+// Lanes whose index falls in slice c come out of (idx - 16c) +sat 0x70 as
+// 0x70..0x7F and select from slice c; all others saturate to 0x80..0xFF, for
+// which pshufb yields zero, so OR-ing the six lookups assembles the gather.
+CUBE96_TARGET_SSSE3 Permutation compose_ssse3(const Permutation &accum,
+                                              const Permutation &step) {
+  constexpr std::size_t kSlices = kPermSize / 16;
+  __m128i table[kSlices];
+  for (std::size_t c = 0; c < kSlices; ++c) {
+    table[c] = load16(step.data() + 16 * c);
+  }
+  const __m128i bias = _mm_set1_epi8(0x70);
+  Permutation out;
+  for (std::size_t g = 0; g < kPermSize; g += 16) {
+    const __m128i idx = load16(accum.data() + g);
+    __m128i r = _mm_setzero_si128();
+    for (std::size_t c = 0; c < kSlices; ++c) {
+      const __m128i sel =
+          _mm_adds_epu8(_mm_sub_epi8(idx, _mm_set1_epi8(static_cast<char>(16 * c))), bias);
+      r = _mm_or_si128(r, _mm_shuffle_epi8(table[c], sel));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out.data() + g), r);
+  }
+  return out;
+}
+
+CUBE96_TARGET_AVX2 Permutation compose_avx2(const Permutation &accum,
+                                            const Permutation &step) {
+  constexpr std::size_t kSlices = kPermSize / 16;
+  __m256i table[kSlices];
+  for (std::size_t c = 0; c < kSlices; ++c) {
+    table[c] = load32(step.data() + 16 * c);
+  }
+  const __m256i bias = _mm256_set1_epi8(0x70);
+  Permutation out;
+  for (std::size_t g = 0; g < kPermSize; g += 32) {
+    const __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(accum.data() + g));
+    __m256i r = _mm256_setzero_si256();
+    for (std::size_t c = 0; c < kSlices; ++c) {
+      const __m256i sel = _mm256_adds_epu8(
+          _mm256_sub_epi8(idx, _mm256_set1_epi8(static_cast<char>(16 * c))), bias);
+      r = _mm256_or_si256(r, _mm256_shuffle_epi8(table[c], sel));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.data() + g), r);
+  }
+  return out;
+}
+
+void sub_bytes_ssse3(std::uint8_t *data, std::size_t len) {
+  tower_bytes_ssse3(kForward, data, len);
+}
+void inv_sub_bytes_ssse3(std::uint8_t *data, std::size_t len) {
+  tower_bytes_ssse3(kInverse, data, len);
+}
+void sub_bytes_avx2(std::uint8_t *data, std::size_t len) {
+  tower_bytes_avx2(kForward, data, len);
+}
+void inv_sub_bytes_avx2(std::uint8_t *data, std::size_t len) {
+  tower_bytes_avx2(kInverse, data, len);
+}
+
+SimdLevel probe_cpu() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  const int max_leaf = info[0];
+  __cpuid(info, 1);
+  const bool ssse3 = (info[2] & (1 << 9)) != 0;
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  bool avx2 = false;
+  if (max_leaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+    __cpuidex(info, 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+  }
+#else
+  __builtin_cpu_init();
+  const bool ssse3 = __builtin_cpu_supports("ssse3") != 0;
+  const bool avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+  if (avx2) {
+    return SimdLevel::Avx2;
+  }
+  return ssse3 ? SimdLevel::Ssse3 : SimdLevel::Scalar;
+}
+
+#else
+
+SimdLevel probe_cpu() { return SimdLevel::Scalar; }
+
+#endif
+
+struct Kernels {
+  void (*sub)(std::uint8_t *, std::size_t);
+  void (*inv_sub)(std::uint8_t *, std::size_t);
+  State96 (*sub_state)(const State96 &);
+  State96 (*inv_sub_state)(const State96 &);
+  Permutation (*compose)(const Permutation &, const Permutation &);
+};
+
+const Kernels &kernels_for(SimdLevel level) {
+  static const Kernels scalar{sub_bytes_scalar, inv_sub_bytes_scalar, sub_state_scalar,
+                              inv_sub_state_scalar, compose};
+#if defined(CUBE96_SIMD_X86)
+  // A single block fits one 128-bit register, so the state entry points use
+  // the SSSE3 kernel at both vector levels.
+  static const Kernels ssse3{sub_bytes_ssse3, inv_sub_bytes_ssse3, sub_state_ssse3,
+                             inv_sub_state_ssse3, compose_ssse3};
+  static const Kernels avx2{sub_bytes_avx2, inv_sub_bytes_avx2, sub_state_ssse3,
+                            inv_sub_state_ssse3, compose_avx2};
+  switch (std::min(level, detected_simd_level())) {
+  case SimdLevel::Avx2:
+    return avx2;
+  case SimdLevel::Ssse3:
+    return ssse3;
+  case SimdLevel::Scalar:
+    break;
+  }
+#else
+  (void)level;
+#endif
+  return scalar;
+}
+
+const Kernels &active_kernels() {
+  static const Kernels &kernels = kernels_for(detected_simd_level());
+  return kernels;
+}
+
+} // namespace
+
+SimdLevel detected_simd_level() {
+  static const SimdLevel level = probe_cpu();
+  return level;
+}
+
+const char *simd_level_name(SimdLevel level) {
+  switch (level) {
+  case SimdLevel::Avx2:
+    return "avx2";
+  case SimdLevel::Ssse3:
+    return "ssse3";
+  case SimdLevel::Scalar:
+    break;
+  }
+  return "scalar";
+}
+
+void sub_bytes_vec(std::uint8_t *data, std::size_t len) {
+  active_kernels().sub(data, len);
+}
+
+void inv_sub_bytes_vec(std::uint8_t *data, std::size_t len) {
+  active_kernels().inv_sub(data, len);
+}
+
+void sub_bytes_vec(std::uint8_t *data, std::size_t len, SimdLevel level) {
+  kernels_for(level).sub(data, len);
+}
+
+void inv_sub_bytes_vec(std::uint8_t *data, std::size_t len, SimdLevel level) {
+  kernels_for(level).inv_sub(data, len);
+}
+
+Permutation compose_vec(const Permutation &accum, const Permutation &step) {
+  return active_kernels().compose(accum, step);
+}
+
+Permutation compose_vec(const Permutation &accum, const Permutation &step, SimdLevel level) {
+  return kernels_for(level).compose(accum, step);
+}
+
+State96 sub_state_scalar(const State96 &s) {
+  return map_state_bytes(s, aes_sbox_bitsliced);
+}
+
+State96 inv_sub_state_scalar(const State96 &s) {
+  return map_state_bytes(s, aes_inv_sbox_bitsliced);
+}
+
+#if defined(CUBE96_SIMD_X86)
+State96 sub_state_ssse3(const State96 &s) { return tower_state_ssse3(kForward, s); }
+State96 inv_sub_state_ssse3(const State96 &s) { return tower_state_ssse3(kInverse, s); }
+#else
+State96 sub_state_ssse3(const State96 &s) { return sub_state_scalar(s); }
+State96 inv_sub_state_ssse3(const State96 &s) { return inv_sub_state_scalar(s); }
+#endif
+
+State96 sub_state_hardened(const State96 &s) { return active_kernels().sub_state(s); }
+
+State96 inv_sub_state_hardened(const State96 &s) {
+  return active_kernels().inv_sub_state(s);
+}
+
+} // namespace cube96
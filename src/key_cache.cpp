@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: MIT
+
+#include "cube96/key_cache.hpp"
+
+#include <algorithm>
+#include <exception>
+
+#include "cube96/endian.hpp"
+
+namespace cube96 {
+
+KeyContextCache::KeyContextCache(std::size_t capacity, CubeCipher::Impl impl, Layout layout,
+                                 std::size_t shards, CubeCipher::Usage usage)
+    : impl_(impl), layout_(layout), usage_(usage) {
+  capacity = std::max<std::size_t>(1, capacity);
+  shards = std::min(std::max<std::size_t>(1, shards), capacity);
+  capacity_ = capacity;
+  for (std::size_t i = 0; i < shards; ++i) {
+    shards_.push_back(std::make_unique<Shard>());
+    shards_.back()->capacity = capacity / shards + (i < capacity % shards ? 1 : 0);
+  }
+  // Surface a disabled Fast build here rather than on the first miss.
+  CubeCipher probe(impl_, layout_, usage_);
+  (void)probe;
+}
+
+std::size_t KeyContextCache::KeyHash::operator()(const KeyId &key) const {
+  // SplitMix64 finalizer over both key words; keys are secret, but shard and
+  // bucket placement only needs to be well spread, not unpredictable.
+  std::uint64_t z = load_be64(key.data()) ^ (std::uint64_t{load_be32(key.data() + 8)} << 17);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return static_cast<std::size_t>(z ^ (z >> 31));
+}
+
+KeyContextCache::Shard &KeyContextCache::shard_for(const KeyId &key) {
+  // High bits pick the shard so the map's low-bit buckets stay independent.
+  const std::uint64_t h = KeyHash{}(key);
+  return *shards_[static_cast<std::size_t>((h >> 40) % shards_.size())];
+}
+
+std::shared_ptr<const CubeCipher> KeyContextCache::get(const std::uint8_t key[kKeyBytes]) {
+  KeyId id;
+  std::copy(key, key + kKeyBytes, id.begin());
+  Shard &shard = shard_for(id);
+
+  std::promise<std::shared_ptr<const CubeCipher>> promise;
+  {
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(id);
+    if (it != shard.index.end()) {
+      shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+      shard.hits.fetch_add(1, std::memory_order_relaxed);
+      return it->second->context;
+    }
+    auto in_flight = shard.pending.find(id);
+    if (in_flight != shard.pending.end()) {
+      Pending expansion = in_flight->second;
+      shard.waits.fetch_add(1, std::memory_order_relaxed);
+      lock.unlock();
+      return expansion.get();
+    }
+    shard.pending.emplace(id, promise.get_future().share());
+  }
+
+  // Expand outside the lock so a slow setKey does not stall other keys in the
+  // shard; callers for this key wait on the pending future meanwhile.
+  std::shared_ptr<const CubeCipher> context;
+  try {
+    auto fresh = std::make_shared<CubeCipher>(impl_, layout_, usage_);
+    fresh->setKey(key);
+    context = std::move(fresh);
+  } catch (...) {
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.pending.erase(id);
+    }
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.pending.erase(id);
+    shard.misses.fetch_add(1, std::memory_order_relaxed);
+    if (shard.lru.size() >= shard.capacity) {
+      shard.index.erase(shard.lru.back().key);
+      shard.lru.pop_back();
+      shard.evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+    shard.lru.push_front(Entry{id, context});
+    shard.index.emplace(id, shard.lru.begin());
+  }
+  promise.set_value(context);
+  return context;
+}
+
+KeyContextCache::Stats KeyContextCache::stats() const {
+  Stats total;
+  for (const auto &shard : shards_) {
+    total.hits += shard->hits.load(std::memory_order_relaxed);
+    total.misses += shard->misses.load(std::memory_order_relaxed);
+    total.waits += shard->waits.load(std::memory_order_relaxed);
+    total.evictions += shard->evictions.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    total.size += shard->lru.size();
+  }
+  return total;
+}
+
+void KeyContextCache::clear() {
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    shard->index.clear();
+    shard->lru.clear();
+  }
+}
+
+} // namespace cube96
@@ -6,9 +6,46 @@
 
 #include "cube96/endian.hpp"
 
+#if !defined(CUBE96_DISABLE_SIMD) &&                                          \
+    (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||            \
+     defined(_M_IX86))
+#define CUBE96_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CUBE96_TARGET_SSE2
+#define CUBE96_TARGET_AVX2
+#else
+#define CUBE96_TARGET_SSE2 __attribute__((target("sse2")))
+#define CUBE96_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
 namespace cube96 {
 namespace {
 
+// HKDF salt encodes ASCII "StagedCube's-96-HKDF-V1" padded to 32 bytes with
+// zeros. The fixed salt and info string guarantee deterministic derivation
+// across platforms.
+const std::uint8_t kSalt[32] = {
+    0x53, 0x74, 0x61, 0x67, 0x65, 0x64, 0x43, 0x75,
+    0x62, 0x65, 0x27, 0x73, 0x2D, 0x39, 0x36, 0x2D,
+    0x48, 0x4B, 0x44, 0x46, 0x2D, 0x56, 0x31, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+const std::uint8_t kInfo[] = "Cube96-RK-PS-Post-v1"; // ASCII, no NUL
+constexpr std::size_t kInfoBytes = sizeof(kInfo) - 1;
+
+// okm layout: round keys (kRoundCount × kBlockBytes), permutation seeds
+// (kRoundCount × 8), and post-whitening block (kBlockBytes).
+constexpr std::size_t kOkmBytes = kRoundCount * kBlockBytes + kRoundCount * 8 + kBlockBytes;
+constexpr std::size_t kOkmBlocks = (kOkmBytes + 31) / 32;
+
+// The multi-buffer path hashes every HMAC message in a single block after its
+// midstate: T(n-1) || info || n plus padding must fit in 64 bytes.
+static_assert(kInfoBytes % 4 == 0 && 32 + kInfoBytes + 1 + 1 + 8 <= 64,
+              "HKDF info must keep expand messages within one SHA-256 block");
+static_assert(kKeyBytes % 4 == 0 && kKeyBytes + 1 + 8 <= 64,
+              "Cipher key must fit one SHA-256 block after the salt midstate");
+
 struct Sha256Ctx {
   std::uint32_t h[8];
   std::uint64_t bit_len;
@@ -173,6 +210,108 @@ void hmac_final(HmacSha256Ctx &ctx, std::uint8_t out[32]) {
   sha256_final(ctx.outer, out);
 }
 
+// HMAC-SHA256 keyed with kSalt: the ipad and opad blocks are compressed once,
+// so extracting a PRK only hashes the key block and the inner digest.
+struct SaltMidstates {
+  std::uint32_t inner[8];
+  std::uint32_t outer[8];
+};
+
+const SaltMidstates &salt_midstates() {
+  static const SaltMidstates midstates = [] {
+    HmacSha256Ctx ctx;
+    hmac_init(ctx, kSalt, sizeof(kSalt));
+    SaltMidstates m{};
+    std::copy(ctx.inner.h, ctx.inner.h + 8, m.inner);
+    std::copy(ctx.outer.h, ctx.outer.h + 8, m.outer);
+    return m;
+  }();
+  return midstates;
+}
+
+// One key per call; also the single-key path behind derive_material.
+namespace lanes_scalar {
+#define CUBE96_LANES_TARGET
+using V = std::uint32_t;
+constexpr std::size_t kLanes = 1;
+inline V set1(std::uint32_t x) { return x; }
+inline V load(const std::uint32_t *p) { return *p; }
+inline void store(std::uint32_t *p, V v) { *p = v; }
+inline V add(V a, V b) { return a + b; }
+inline V bxor(V a, V b) { return a ^ b; }
+inline V band(V a, V b) { return a & b; }
+inline V bandnot(V a, V b) { return ~a & b; }
+template <int N> inline V shr(V x) { return x >> N; }
+template <int N> inline V shl(V x) { return x << N; }
+#include "key_schedule_lanes.inc"
+#undef CUBE96_LANES_TARGET
+} // namespace lanes_scalar
+
+#if defined(CUBE96_SIMD_X86)
+
+namespace lanes_sse2 {
+#define CUBE96_LANES_TARGET CUBE96_TARGET_SSE2
+using V = __m128i;
+constexpr std::size_t kLanes = 4;
+CUBE96_LANES_TARGET inline V set1(std::uint32_t x) {
+  return _mm_set1_epi32(static_cast<int>(x));
+}
+CUBE96_LANES_TARGET inline V load(const std::uint32_t *p) {
+  return _mm_load_si128(reinterpret_cast<const __m128i *>(p));
+}
+CUBE96_LANES_TARGET inline void store(std::uint32_t *p, V v) {
+  _mm_store_si128(reinterpret_cast<__m128i *>(p), v);
+}
+CUBE96_LANES_TARGET inline V add(V a, V b) { return _mm_add_epi32(a, b); }
+CUBE96_LANES_TARGET inline V bxor(V a, V b) { return _mm_xor_si128(a, b); }
+CUBE96_LANES_TARGET inline V band(V a, V b) { return _mm_and_si128(a, b); }
+CUBE96_LANES_TARGET inline V bandnot(V a, V b) { return _mm_andnot_si128(a, b); }
+template <int N> CUBE96_LANES_TARGET inline V shr(V x) { return _mm_srli_epi32(x, N); }
+template <int N> CUBE96_LANES_TARGET inline V shl(V x) { return _mm_slli_epi32(x, N); }
+#include "key_schedule_lanes.inc"
+#undef CUBE96_LANES_TARGET
+} // namespace lanes_sse2
+
+namespace lanes_avx2 {
+#define CUBE96_LANES_TARGET CUBE96_TARGET_AVX2
+using V = __m256i;
+constexpr std::size_t kLanes = 8;
+CUBE96_LANES_TARGET inline V set1(std::uint32_t x) {
+  return _mm256_set1_epi32(static_cast<int>(x));
+}
+CUBE96_LANES_TARGET inline V load(const std::uint32_t *p) {
+  return _mm256_load_si256(reinterpret_cast<const __m256i *>(p));
+}
+CUBE96_LANES_TARGET inline void store(std::uint32_t *p, V v) {
+  _mm256_store_si256(reinterpret_cast<__m256i *>(p), v);
+}
+CUBE96_LANES_TARGET inline V add(V a, V b) { return _mm256_add_epi32(a, b); }
+CUBE96_LANES_TARGET inline V bxor(V a, V b) { return _mm256_xor_si256(a, b); }
+CUBE96_LANES_TARGET inline V band(V a, V b) { return _mm256_and_si256(a, b); }
+CUBE96_LANES_TARGET inline V bandnot(V a, V b) { return _mm256_andnot_si256(a, b); }
+template <int N> CUBE96_LANES_TARGET inline V shr(V x) { return _mm256_srli_epi32(x, N); }
+template <int N> CUBE96_LANES_TARGET inline V shl(V x) { return _mm256_slli_epi32(x, N); }
+#include "key_schedule_lanes.inc"
+#undef CUBE96_LANES_TARGET
+} // namespace lanes_avx2
+
+#endif
+
+DerivedMaterial material_from_okm(const std::uint8_t okm[kOkmBytes]) {
+  DerivedMaterial material;
+  std::size_t offset = 0;
+  for (std::size_t r = 0; r < kRoundCount; ++r) {
+    std::copy_n(okm + offset, kBlockBytes, material.round_keys[r].begin());
+    offset += kBlockBytes;
+  }
+  for (std::size_t r = 0; r < kRoundCount; ++r) {
+    std::copy_n(okm + offset, 8, material.perm_seeds[r].begin());
+    offset += 8;
+  }
+  std::copy_n(okm + offset, kBlockBytes, material.post_whitening.begin());
+  return material;
+}
+
 } // namespace
 
 Sha256Digest sha256(const std::uint8_t *data, std::size_t len) {
@@ -227,41 +366,43 @@ void hkdf_expand(const std::uint8_t prk[32], const std::uint8_t *info,
   }
 }
 
-DerivedMaterial derive_material(const std::uint8_t key[kKeyBytes]) {
-  // HKDF salt encodes ASCII "StagedCube's-96-HKDF-V1" padded to 32 bytes with
-  // zeros. The fixed salt and info string guarantee deterministic derivation
-  // across platforms.
-  static const std::uint8_t kSalt[32] = {
-      0x53, 0x74, 0x61, 0x67, 0x65, 0x64, 0x43, 0x75,
-      0x62, 0x65, 0x27, 0x73, 0x2D, 0x39, 0x36, 0x2D,
-      0x48, 0x4B, 0x44, 0x46, 0x2D, 0x56, 0x31, 0x00,
-      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-  static const std::uint8_t kInfo[] = "Cube96-RK-PS-Post-v1"; // ASCII, no NUL
-
-  std::uint8_t prk[32];
-  hmac_sha256(kSalt, sizeof(kSalt), key, kKeyBytes, prk);
-
-  std::uint8_t okm[172];
-  hkdf_expand(prk, kInfo, sizeof(kInfo) - 1, okm, sizeof(okm));
-
-  static_assert(kRoundCount * kBlockBytes + kRoundCount * 8 + kBlockBytes == sizeof(okm),
-                "HKDF layout must match derived material footprint");
+void derive_materials(const std::uint8_t *keys, std::size_t n, DerivedMaterial *out) {
+  derive_materials(keys, n, out, detected_simd_level());
+}
 
-  DerivedMaterial material;
-  std::size_t offset = 0;
-  // okm layout: round keys (kRoundCount × kBlockBytes), permutation seeds
-  // (kRoundCount × 8), and post-whitening block (kBlockBytes).
-  for (std::size_t r = 0; r < kRoundCount; ++r) {
-    std::copy_n(okm + offset, kBlockBytes, material.round_keys[r].begin());
-    offset += kBlockBytes;
-  }
-  for (std::size_t r = 0; r < kRoundCount; ++r) {
-    std::copy_n(okm + offset, 8, material.perm_seeds[r].begin());
-    offset += 8;
+void derive_materials(const std::uint8_t *keys, std::size_t n, DerivedMaterial *out,
+                      SimdLevel level) {
+  level = std::min(level, detected_simd_level());
+  std::uint8_t okm[8][kOkmBlocks * 32];
+  while (n > 0) {
+    std::size_t group = 1;
+#if defined(CUBE96_SIMD_X86)
+    if (level >= SimdLevel::Avx2 && n > 4) {
+      group = std::min<std::size_t>(n, lanes_avx2::kLanes);
+      lanes_avx2::derive_okm(keys, group, okm);
+    } else if (level >= SimdLevel::Ssse3 && n > 1) {
+      group = std::min<std::size_t>(n, lanes_sse2::kLanes);
+      lanes_sse2::derive_okm(keys, group, okm);
+    } else
+#else
+    (void)level;
+#endif
+    {
+      lanes_scalar::derive_okm(keys, 1, okm);
+    }
+    for (std::size_t i = 0; i < group; ++i) {
+      out[i] = material_from_okm(okm[i]);
+    }
+    keys += group * kKeyBytes;
+    out += group;
+    n -= group;
   }
-  std::copy_n(okm + offset, kBlockBytes, material.post_whitening.begin());
+}
 
-  return material;
+DerivedMaterial derive_material(const std::uint8_t key[kKeyBytes]) {
+  std::uint8_t okm[1][kOkmBlocks * 32];
+  lanes_scalar::derive_okm(key, 1, okm);
+  return material_from_okm(okm[0]);
 }
 
 } // namespace cube96
@@ -0,0 +1,731 @@
+// SPDX-License-Identifier: MIT
+
+#include "cube96/key_store.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "cube96/endian.hpp"
+
+#if !defined(CUBE96_DISABLE_SIMD) && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define CUBE96_CRC32C_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CUBE96_KEY_STORE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cube96 {
+
+namespace {
+
+constexpr char kRecordMagic[8] = {'C', 'U', 'B', 'E', '9', '6', 'X', 'K'};
+constexpr char kStoreMagic[8] = {'C', 'U', 'B', 'E', '9', '6', 'K', 'S'};
+constexpr std::uint32_t kStoreVersion = 1;
+constexpr std::uint32_t kByteOrderTag = 0x01020304u;
+constexpr std::size_t kRecordHeaderBytes = 32;
+constexpr std::size_t kFixedBytes = 144;  // header, round keys, post key
+constexpr std::size_t kDigestOffset = 140;
+constexpr std::size_t kPermsBytes = kRoundCount * kPermSize;
+constexpr std::size_t kPackedKeyBytes = 16;
+constexpr std::size_t kStoreHeaderBytes = 16;
+constexpr std::size_t kIndexEntryBytes = 32;
+constexpr std::size_t kSectionAlign = 64;
+
+// Tables are stored as their in-memory image, so that image must not depend
+// on anything but byte order.
+static_assert(sizeof(State96) == kPackedKeyBytes && offsetof(State96, lo) == 8,
+              "expanded-key records assume a 16-byte State96");
+static_assert(sizeof(GatherTable) == kBlockBytes * 256 * kPackedKeyBytes,
+              "GatherTable must be a dense array of State96");
+static_assert(sizeof(BenesNetwork) == 2 * kBenesStages * 8,
+              "BenesNetwork must be two dense mask arrays");
+static_assert(std::is_trivially_copyable<GatherTable>::value &&
+                  std::is_trivially_copyable<BenesNetwork>::value,
+              "compiled tables must be trivially copyable");
+
+std::size_t align_up(std::size_t n) { return (n + kSectionAlign - 1) & ~(kSectionAlign - 1); }
+
+// Section offsets within a record with the given contents bits; 0 marks an
+// absent section.
+struct RecordLayout {
+  std::size_t perm = 0;
+  std::size_t inv_perm = 0;
+  std::size_t perm_tables = 0;
+  std::size_t inv_perm_tables = 0;
+  std::size_t rk_inv = 0;
+  std::size_t perm_nets = 0;
+  std::size_t inv_perm_nets = 0;
+  std::size_t size = 0;
+};
+
+RecordLayout record_layout(std::uint8_t contents) {
+  const bool forward = (contents & kRecordForward) != 0;
+  const bool inverse = (contents & kRecordInverse) != 0;
+  RecordLayout l;
+  std::size_t offset = kFixedBytes;
+  if (forward) {
+    l.perm = offset;
+    offset += kPermsBytes;
+  }
+  if (inverse) {
+    l.inv_perm = offset;
+    offset += kPermsBytes;
+  }
+  if ((contents & (kRecordGatherTables | kRecordBenesNetworks)) != 0) {
+    offset = align_up(offset);
+  }
+  if ((contents & kRecordGatherTables) != 0) {
+    if (forward) {
+      l.perm_tables = offset;
+      offset += kRoundCount * sizeof(GatherTable);
+    }
+    if (inverse) {
+      l.inv_perm_tables = offset;
+      offset += kRoundCount * sizeof(GatherTable);
+      l.rk_inv = offset;
+      offset += kRoundCount * kPackedKeyBytes;
+    }
+  }
+  if ((contents & kRecordBenesNetworks) != 0) {
+    if (forward) {
+      l.perm_nets = offset;
+      offset += kRoundCount * sizeof(BenesNetwork);
+    }
+    if (inverse) {
+      l.inv_perm_nets = offset;
+      offset += kRoundCount * sizeof(BenesNetwork);
+    }
+  }
+  l.size = offset;
+  return l;
+}
+
+// State96 has 4 bytes of padding; writing the fields keeps them zero.
+void put_state(const State96 &s, std::uint8_t *out) {
+  std::memcpy(out, &s.hi, sizeof(s.hi));
+  std::memcpy(out + 8, &s.lo, sizeof(s.lo));
+}
+
+State96 get_state(const std::uint8_t *in) {
+  State96 s{0, 0};
+  std::memcpy(&s.hi, in, sizeof(s.hi));
+  std::memcpy(&s.lo, in + 8, sizeof(s.lo));
+  return s;
+}
+
+bool is_permutation(const Permutation &p) {
+  bool seen[kPermSize] = {};
+  for (std::uint8_t v : p) {
+    if (v >= kPermSize || seen[v]) {
+      return false;
+    }
+    seen[v] = true;
+  }
+  return true;
+}
+
+// Fills `array` with kRoundCount elements at `src`, borrowing them when the
+// record is backed by long-lived memory and the address suits T.
+template <typename T>
+void read_array(const std::uint8_t *src, const std::shared_ptr<const void> &backing,
+                KeyArray<T> &array) {
+  if (backing && reinterpret_cast<std::uintptr_t>(src) % alignof(T) == 0) {
+    array.borrow(reinterpret_cast<const T *>(src), kRoundCount);
+  } else {
+    array.resize(kRoundCount);
+    std::memcpy(static_cast<void *>(&array[0]), src, kRoundCount * sizeof(T));
+  }
+}
+
+// CRC32C (Castagnoli, reflected polynomial 0x82F63B78), with the SSE4.2
+// instruction where the CPU has it and slicing-by-8 tables otherwise.
+struct Crc32cTables {
+  std::uint32_t t[8][256];
+  Crc32cTables() {
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      std::uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c >> 1) ^ (0x82F63B78u & (0u - (c & 1u)));
+      }
+      t[0][i] = c;
+    }
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      for (std::size_t k = 1; k < 8; ++k) {
+        t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFFu];
+      }
+    }
+  }
+};
+
+std::uint32_t crc32c_sw(std::uint32_t crc, const std::uint8_t *p, std::size_t len) {
+  static const Crc32cTables tables;
+  const auto &t = tables.t;
+  for (; len >= 8; p += 8, len -= 8) {
+    const std::uint32_t lo = crc ^ (static_cast<std::uint32_t>(p[0]) |
+                                    static_cast<std::uint32_t>(p[1]) << 8 |
+                                    static_cast<std::uint32_t>(p[2]) << 16 |
+                                    static_cast<std::uint32_t>(p[3]) << 24);
+    crc = t[7][lo & 0xFFu] ^ t[6][(lo >> 8) & 0xFFu] ^ t[5][(lo >> 16) & 0xFFu] ^
+          t[4][lo >> 24] ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+  }
+  for (; len != 0; ++p, --len) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFFu];
+  }
+  return crc;
+}
+
+#if defined(CUBE96_CRC32C_X86)
+#define CUBE96_CRC32C_TARGET __attribute__((target("sse4.2")))
+
+CUBE96_CRC32C_TARGET std::uint32_t crc32c_hw_serial(std::uint32_t crc, const std::uint8_t *p,
+                                                    std::size_t len) {
+#if defined(__x86_64__)
+  std::uint64_t c = crc;
+  for (; len >= 8; p += 8, len -= 8) {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    c = _mm_crc32_u64(c, v);
+  }
+  crc = static_cast<std::uint32_t>(c);
+#endif
+  for (; len != 0; ++p, --len) {
+    crc = _mm_crc32_u8(crc, *p);
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+// The crc32 instruction has a latency of three cycles but issues every
+// cycle, so long inputs run as three interleaved streams of kCrcStride bytes.
+// A stream's register is moved past the bytes after it by the linear
+// shift-over-zeros operator, applied one byte of the register at a time.
+constexpr std::size_t kCrcStride = 8192;
+
+struct Crc32cShift {
+  std::uint32_t t[4][256];
+  CUBE96_CRC32C_TARGET Crc32cShift() {
+    static const std::uint8_t zeros[kCrcStride] = {};
+    std::uint32_t column[32];
+    for (int i = 0; i < 32; ++i) {
+      column[i] = crc32c_hw_serial(1u << i, zeros, kCrcStride);
+    }
+    for (int k = 0; k < 4; ++k) {
+      for (std::uint32_t n = 0; n < 256; ++n) {
+        std::uint32_t v = 0;
+        for (int i = 0; i < 8; ++i) {
+          if ((n >> i) & 1u) {
+            v ^= column[8 * k + i];
+          }
+        }
+        t[k][n] = v;
+      }
+    }
+  }
+  std::uint32_t operator()(std::uint32_t crc) const {
+    return t[0][crc & 0xFFu] ^ t[1][(crc >> 8) & 0xFFu] ^ t[2][(crc >> 16) & 0xFFu] ^
+           t[3][crc >> 24];
+  }
+};
+
+CUBE96_CRC32C_TARGET std::uint32_t crc32c_hw(std::uint32_t crc, const std::uint8_t *p,
+                                             std::size_t len) {
+  if (len >= 3 * kCrcStride) {
+    static const Crc32cShift shift;
+    do {
+      std::uint64_t c0 = crc;
+      std::uint64_t c1 = 0;
+      std::uint64_t c2 = 0;
+      for (std::size_t i = 0; i < kCrcStride; i += 8) {
+        std::uint64_t v0;
+        std::uint64_t v1;
+        std::uint64_t v2;
+        std::memcpy(&v0, p + i, 8);
+        std::memcpy(&v1, p + kCrcStride + i, 8);
+        std::memcpy(&v2, p + 2 * kCrcStride + i, 8);
+        c0 = _mm_crc32_u64(c0, v0);
+        c1 = _mm_crc32_u64(c1, v1);
+        c2 = _mm_crc32_u64(c2, v2);
+      }
+      crc = shift(static_cast<std::uint32_t>(c0)) ^ static_cast<std::uint32_t>(c1);
+      crc = shift(crc) ^ static_cast<std::uint32_t>(c2);
+      p += 3 * kCrcStride;
+      len -= 3 * kCrcStride;
+    } while (len >= 3 * kCrcStride);
+  }
+  return crc32c_hw_serial(crc, p, len);
+}
+#else
+std::uint32_t crc32c_hw(std::uint32_t crc, const std::uint8_t *p, std::size_t len) {
+  return crc32c_hw_serial(crc, p, len);
+}
+#endif
+#endif
+
+// Running CRC32C state (pre- and post-inverted); update() may be called on
+// consecutive pieces of the data.
+class Crc32c {
+public:
+  void update(const std::uint8_t *p, std::size_t len) {
+#if defined(CUBE96_CRC32C_X86)
+    static const bool hw = [] {
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("sse4.2") != 0;
+    }();
+    if (hw) {
+      crc_ = crc32c_hw(crc_, p, len);
+      return;
+    }
+#endif
+    crc_ = crc32c_sw(crc_, p, len);
+  }
+  std::uint32_t value() const { return ~crc_; }
+
+private:
+  std::uint32_t crc_ = ~0u;
+};
+
+// Digest of a whole record, taken with the digest field itself as zeros.
+std::uint32_t record_digest(const std::uint8_t *data, std::size_t size) {
+  static const std::uint8_t zeros[4] = {};
+  Crc32c crc;
+  crc.update(data, kDigestOffset);
+  crc.update(zeros, sizeof(zeros));
+  crc.update(data + kFixedBytes, size - kFixedBytes);
+  return crc.value();
+}
+
+[[noreturn]] void malformed() {
+  throw std::invalid_argument("Malformed Cube96 expanded-key record");
+}
+
+[[noreturn]] void io_error(const std::string &what, const std::string &path) {
+  throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+std::vector<std::uint8_t> encode_expanded_key(const ExpandedKey &key, Layout layout,
+                                              const std::uint8_t check[kBlockBytes],
+                                              bool include_tables) {
+  const bool forward = !key.perm.empty();
+  const bool inverse = !key.inv_perm.empty();
+  std::uint8_t contents = (forward ? kRecordForward : 0) | (inverse ? kRecordInverse : 0);
+  auto complete = [&](const auto &fwd_tables, const auto &inv_tables) {
+    return (!forward || fwd_tables.size() == kRoundCount) &&
+           (!inverse || inv_tables.size() == kRoundCount);
+  };
+  if (include_tables && complete(key.perm_tables, key.inv_perm_tables)) {
+    contents |= kRecordGatherTables;
+  }
+  if (include_tables && complete(key.perm_nets, key.inv_perm_nets)) {
+    contents |= kRecordBenesNetworks;
+  }
+
+  const RecordLayout l = record_layout(contents);
+  std::vector<std::uint8_t> out(l.size, 0);
+  std::memcpy(out.data(), kRecordMagic, sizeof(kRecordMagic));
+  out[8] = static_cast<std::uint8_t>(kExpandedKeyVersion >> 8);
+  out[9] = static_cast<std::uint8_t>(kExpandedKeyVersion & 0xFFu);
+  out[10] = layout == Layout::RowMajor ? 1 : 0;
+  out[11] = contents;
+  std::memcpy(out.data() + 12, &kByteOrderTag, sizeof(kByteOrderTag));
+  store_be32(static_cast<std::uint32_t>(l.size), out.data() + 16);
+  std::memcpy(out.data() + 20, check, kBlockBytes);
+
+  std::uint8_t *p = out.data() + kRecordHeaderBytes;
+  for (const auto &rk : key.round_keys) {
+    p = std::copy(rk.begin(), rk.end(), p);
+  }
+  std::copy(key.rk_post.begin(), key.rk_post.end(), p);
+
+  for (std::size_t r = 0; r < kRoundCount; ++r) {
+    if (l.perm != 0) {
+      std::copy(key.perm[r].begin(), key.perm[r].end(), out.data() + l.perm + r * kPermSize);
+    }
+    if (l.inv_perm != 0) {
+      std::copy(key.inv_perm[r].begin(), key.inv_perm[r].end(),
+                out.data() + l.inv_perm + r * kPermSize);
+    }
+    if (l.perm_tables != 0) {
+      std::uint8_t *t = out.data() + l.perm_tables + r * sizeof(GatherTable);
+      for (const auto &row : key.perm_tables[r]) {
+        for (const auto &entry : row) {
+          put_state(entry, t);
+          t += kPackedKeyBytes;
+        }
+      }
+    }
+    if (l.inv_perm_tables != 0) {
+      std::uint8_t *t = out.data() + l.inv_perm_tables + r * sizeof(GatherTable);
+      for (const auto &row : key.inv_perm_tables[r]) {
+        for (const auto &entry : row) {
+          put_state(entry, t);
+          t += kPackedKeyBytes;
+        }
+      }
+      put_state(key.rk_inv_packed[r], out.data() + l.rk_inv + r * kPackedKeyBytes);
+    }
+    if (l.perm_nets != 0) {
+      std::memcpy(out.data() + l.perm_nets + r * sizeof(BenesNetwork), &key.perm_nets[r],
+                  sizeof(BenesNetwork));
+    }
+    if (l.inv_perm_nets != 0) {
+      std::memcpy(out.data() + l.inv_perm_nets + r * sizeof(BenesNetwork),
+                  &key.inv_perm_nets[r], sizeof(BenesNetwork));
+    }
+  }
+  store_be32(record_digest(out.data(), out.size()), out.data() + kDigestOffset);
+  return out;
+}
+
+std::uint8_t decode_expanded_key(const std::uint8_t *data, std::size_t len, Layout layout,
+                                 const std::shared_ptr<const void> &backing, ExpandedKey &key,
+                                 std::uint8_t check[kBlockBytes]) {
+  if (len < kFixedBytes || std::memcmp(data, kRecordMagic, sizeof(kRecordMagic)) != 0) {
+    throw std::invalid_argument("Not a Cube96 expanded-key record");
+  }
+  const unsigned version = (static_cast<unsigned>(data[8]) << 8) | data[9];
+  if (version != kExpandedKeyVersion) {
+    throw std::invalid_argument("Unsupported expanded-key record version " +
+                                std::to_string(version));
+  }
+  if (data[10] > 1) {
+    malformed();
+  }
+  if ((data[10] == 1 ? Layout::RowMajor : Layout::ZSlice) != layout) {
+    throw std::invalid_argument("Expanded-key record was derived for another state layout");
+  }
+  std::uint8_t contents = data[11];
+  if ((contents & ~0x0Fu) != 0 || (contents & (kRecordForward | kRecordInverse)) == 0) {
+    malformed();
+  }
+  const RecordLayout l = record_layout(contents);
+  if (load_be32(data + 16) != l.size || l.size > len) {
+    malformed();
+  }
+  // Before anything is borrowed: a single check block touches only a few
+  // table entries, so corruption elsewhere would otherwise go unnoticed.
+  if (load_be32(data + kDigestOffset) != record_digest(data, l.size)) {
+    throw std::invalid_argument("Cube96 expanded-key record failed its digest check");
+  }
+  std::uint32_t tag = 0;
+  std::memcpy(&tag, data + 12, sizeof(tag));
+  if (tag != kByteOrderTag) {
+    contents &= static_cast<std::uint8_t>(~(kRecordGatherTables | kRecordBenesNetworks));
+  }
+  std::memcpy(check, data + 20, kBlockBytes);
+
+  const std::uint8_t *p = data + kRecordHeaderBytes;
+  for (auto &rk : key.round_keys) {
+    std::copy(p, p + rk.size(), rk.begin());
+    p += rk.size();
+  }
+  std::copy(p, p + key.rk_post.size(), key.rk_post.begin());
+  for (std::size_t r = 0; r < kRoundCount; ++r) {
+    key.rk_packed[r] = load_state(key.round_keys[r].data());
+  }
+  key.rk_post_packed = load_state(key.rk_post.data());
+
+  if ((contents & kRecordForward) != 0) {
+    read_array(data + l.perm, backing, key.perm);
+  }
+  if ((contents & kRecordInverse) != 0) {
+    read_array(data + l.inv_perm, backing, key.inv_perm);
+  }
+  for (std::size_t r = 0; r < kRoundCount; ++r) {
+    if ((!key.perm.empty() && !is_permutation(key.perm[r])) ||
+        (!key.inv_perm.empty() && !is_permutation(key.inv_perm[r]))) {
+      malformed();
+    }
+  }
+
+  if ((contents & kRecordGatherTables) != 0) {
+    if (l.perm_tables != 0) {
+      read_array(data + l.perm_tables, backing, key.perm_tables);
+    }
+    if (l.inv_perm_tables != 0) {
+      read_array(data + l.inv_perm_tables, backing, key.inv_perm_tables);
+      for (std::size_t r = 0; r < kRoundCount; ++r) {
+        key.rk_inv_packed[r] = get_state(data + l.rk_inv + r * kPackedKeyBytes);
+      }
+    }
+  }
+  if ((contents & kRecordBenesNetworks) != 0) {
+    if (l.perm_nets != 0) {
+      read_array(data + l.perm_nets, backing, key.perm_nets);
+    }
+    if (l.inv_perm_nets != 0) {
+      read_array(data + l.inv_perm_nets, backing, key.inv_perm_nets);
+    }
+  }
+  key.backing = backing;
+  return contents;
+}
+
+// Read-only view of a whole store file: a shared mapping where POSIX mmap is
+// available, otherwise a private copy.
+class KeyStore::Mapping {
+public:
+  explicit Mapping(const std::string &path) {
+#if defined(CUBE96_KEY_STORE_MMAP)
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st {};
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      io_error("Cannot read key store", path);
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ != 0) {
+      void *p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+      if (p == MAP_FAILED) {
+        ::close(fd);
+        io_error("Cannot map key store", path);
+      }
+      map_ = p;
+      data_ = static_cast<const std::uint8_t *>(p);
+    }
+    ::close(fd);
+#else
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+      io_error("Cannot read key store", path);
+    }
+    std::uint8_t chunk[1 << 16];
+    std::size_t got;
+    while ((got = std::fread(chunk, 1, sizeof(chunk), f)) != 0) {
+      buffer_.insert(buffer_.end(), chunk, chunk + got);
+    }
+    const bool failed = std::ferror(f) != 0;
+    std::fclose(f);
+    if (failed) {
+      io_error("Cannot read key store", path);
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+  }
+
+  Mapping(const Mapping &) = delete;
+  Mapping &operator=(const Mapping &) = delete;
+
+  ~Mapping() {
+#if defined(CUBE96_KEY_STORE_MMAP)
+    if (map_ != nullptr) {
+      munmap(map_, size_);
+    }
+#endif
+  }
+
+  const std::uint8_t *data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+private:
+#if defined(CUBE96_KEY_STORE_MMAP)
+  void *map_ = nullptr;
+#else
+  std::vector<std::uint8_t> buffer_;
+#endif
+  const std::uint8_t *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+namespace {
+
+// Temporary file next to a store being written.  It is removed on destruction
+// unless commit() has renamed it into place.
+class StoreTempFile {
+public:
+  explicit StoreTempFile(const std::string &path) : path_(path) {
+#if defined(CUBE96_KEY_STORE_MMAP)
+    // A unique name per writer, so concurrent writers of one store never
+    // share a temporary file.
+    std::string tmp = path + ".XXXXXX";
+    const int fd = mkstemp(&tmp[0]);
+    if (fd >= 0) {
+      tmp_ = tmp;
+      if ((file_ = fdopen(fd, "wb")) == nullptr) {
+        ::close(fd);
+      }
+    }
+#else
+    tmp_ = path + ".tmp";
+    file_ = std::fopen(tmp_.c_str(), "wb");
+#endif
+    if (file_ == nullptr) {
+      const int saved = errno;
+      discard();
+      errno = saved;
+      io_error("Cannot create key store", path);
+    }
+  }
+
+  StoreTempFile(const StoreTempFile &) = delete;
+  StoreTempFile &operator=(const StoreTempFile &) = delete;
+
+  ~StoreTempFile() {
+    if (file_ != nullptr) {
+      std::fclose(file_);
+    }
+    discard();
+  }
+
+  std::FILE *get() const { return file_; }
+
+  // Flushes and closes the file, then renames it over the store.
+  void commit(bool ok) {
+    ok = ok && std::fflush(file_) == 0;
+#if defined(CUBE96_KEY_STORE_MMAP)
+    ok = ok && fsync(fileno(file_)) == 0;
+#endif
+    ok = std::fclose(file_) == 0 && ok;
+    file_ = nullptr;
+    if (!ok || std::rename(tmp_.c_str(), path_.c_str()) != 0) {
+      const int saved = errno;
+      discard();
+      errno = saved;
+      io_error("Cannot write key store", path_);
+    }
+    tmp_.clear();
+  }
+
+private:
+  void discard() {
+    if (!tmp_.empty()) {
+      std::remove(tmp_.c_str());
+      tmp_.clear();
+    }
+  }
+
+  std::string path_;
+  std::string tmp_;
+  std::FILE *file_ = nullptr;
+};
+
+} // namespace
+
+void KeyStore::write(const std::string &path, const std::vector<Entry> &entries,
+                     bool include_tables) {
+  std::vector<Entry> sorted = entries;
+  std::sort(sorted.begin(), sorted.end(),
+            [](const Entry &a, const Entry &b) { return a.id < b.id; });
+  for (std::size_t i = 1; i < sorted.size(); ++i) {
+    if (sorted[i].id == sorted[i - 1].id) {
+      throw std::invalid_argument("Duplicate key store id " + std::to_string(sorted[i].id));
+    }
+  }
+
+  // Every record is exported before anything touches the disk, so a context
+  // that cannot export leaves no file behind.
+  std::vector<std::vector<std::uint8_t>> records;
+  records.reserve(sorted.size());
+  for (const Entry &entry : sorted) {
+    records.push_back(entry.context->exportExpandedKey(include_tables));
+  }
+
+  std::vector<std::uint8_t> head(kStoreHeaderBytes + sorted.size() * kIndexEntryBytes, 0);
+  std::memcpy(head.data(), kStoreMagic, sizeof(kStoreMagic));
+  store_be32(kStoreVersion, head.data() + 8);
+  store_be32(static_cast<std::uint32_t>(sorted.size()), head.data() + 12);
+  std::size_t offset = head.size();
+  std::vector<std::size_t> starts(sorted.size());
+  for (std::size_t i = 0; i < sorted.size(); ++i) {
+    starts[i] = align_up(offset);
+    std::uint8_t *index = head.data() + kStoreHeaderBytes + i * kIndexEntryBytes;
+    store_be64(sorted[i].id, index);
+    store_be64(starts[i], index + 8);
+    store_be64(records[i].size(), index + 16);
+    offset = starts[i] + records[i].size();
+  }
+
+  StoreTempFile tmp(path);
+  std::FILE *f = tmp.get();
+  static const std::uint8_t zeros[kSectionAlign] = {};
+  bool ok = std::fwrite(head.data(), 1, head.size(), f) == head.size();
+  offset = head.size();
+  for (std::size_t i = 0; ok && i < records.size(); ++i) {
+    ok = std::fwrite(zeros, 1, starts[i] - offset, f) == starts[i] - offset &&
+         std::fwrite(records[i].data(), 1, records[i].size(), f) == records[i].size();
+    offset = starts[i] + records[i].size();
+  }
+  tmp.commit(ok);
+}
+
+KeyStore::KeyStore(const std::string &path) : mapping_(std::make_shared<const Mapping>(path)) {
+  const std::uint8_t *data = mapping_->data();
+  const std::size_t size = mapping_->size();
+  if (size < kStoreHeaderBytes || std::memcmp(data, kStoreMagic, sizeof(kStoreMagic)) != 0) {
+    throw std::invalid_argument("Not a Cube96 key store: " + path);
+  }
+  if (load_be32(data + 8) != kStoreVersion) {
+    throw std::invalid_argument("Unsupported key store version " +
+                                std::to_string(load_be32(data + 8)));
+  }
+  count_ = load_be32(data + 12);
+  if ((size - kStoreHeaderBytes) / kIndexEntryBytes < count_) {
+    throw std::invalid_argument("Truncated key store index: " + path);
+  }
+  for (std::size_t i = 0; i < count_; ++i) {
+    const std::uint8_t *entry = data + kStoreHeaderBytes + i * kIndexEntryBytes;
+    const std::uint64_t offset = load_be64(entry + 8);
+    const std::uint64_t length = load_be64(entry + 16);
+    if ((i != 0 && load_be64(entry) <= load_be64(entry - kIndexEntryBytes)) ||
+        offset % kSectionAlign != 0 || offset > size || length > size - offset) {
+      throw std::invalid_argument("Corrupt key store index: " + path);
+    }
+  }
+}
+
+const std::uint8_t *KeyStore::find(std::uint64_t id) const {
+  const std::uint8_t *index = mapping_->data() + kStoreHeaderBytes;
+  std::size_t lo = 0, hi = count_;
+  while (lo < hi) {
+    const std::size_t mid = lo + (hi - lo) / 2;
+    const std::uint64_t mid_id = load_be64(index + mid * kIndexEntryBytes);
+    if (mid_id == id) {
+      return index + mid * kIndexEntryBytes;
+    }
+    if (mid_id < id) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return nullptr;
+}
+
+std::vector<std::uint64_t> KeyStore::ids() const {
+  std::vector<std::uint64_t> out(count_);
+  for (std::size_t i = 0; i < count_; ++i) {
+    out[i] = load_be64(mapping_->data() + kStoreHeaderBytes + i * kIndexEntryBytes);
+  }
+  return out;
+}
+
+CubeCipher KeyStore::load(std::uint64_t id, CubeCipher::Impl impl, Layout layout,
+                          CubeCipher::Usage usage) const {
+  const std::uint8_t *entry = find(id);
+  if (entry == nullptr) {
+    throw std::out_of_range("Key store has no entry " + std::to_string(id));
+  }
+  CubeCipher cipher(impl, layout, usage);
+  cipher.importExpandedKey(mapping_->data() + load_be64(entry + 8),
+                           static_cast<std::size_t>(load_be64(entry + 16)), mapping_);
+  return cipher;
+}
+
+} // namespace cube96
@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: MIT
+
+#include "cube96/metrics.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <sstream>
+
+namespace cube96 {
+
+const char *metrics_mode_name(MetricsMode mode) {
+  switch (mode) {
+  case MetricsMode::SingleBlock:
+    return "block";
+  case MetricsMode::Ecb:
+    return "ecb";
+  case MetricsMode::Ctr:
+    return "ctr";
+  }
+  return "?";
+}
+
+const char *metrics_op_name(MetricsOp op) {
+  switch (op) {
+  case MetricsOp::SetKey:
+    return "set_key";
+  case MetricsOp::EncryptBlocks:
+    return "encrypt_blocks";
+  case MetricsOp::DecryptBlocks:
+    return "decrypt_blocks";
+  case MetricsOp::Ctr:
+    return "ctr";
+  }
+  return "?";
+}
+
+std::size_t LatencyHistogram::bucket_for(std::uint64_t ns) {
+  if (ns < kSubBuckets) {
+    return static_cast<std::size_t>(ns);
+  }
+  unsigned exponent = kSubBucketBits;
+  while (exponent + 1 < 64 && (ns >> (exponent + 1)) != 0) {
+    ++exponent;
+  }
+  if (exponent >= kMaxExponent) {
+    return kBuckets - 1;
+  }
+  const std::size_t sub =
+      static_cast<std::size_t>(ns >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+  return (exponent - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+std::uint64_t LatencyHistogram::bucket_limit(std::size_t bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket + 1;
+  }
+  const unsigned shift = static_cast<unsigned>(bucket / kSubBuckets - 1);
+  return (kSubBuckets + bucket % kSubBuckets + 1) << shift;
+}
+
+std::uint64_t LatencyHistogram::percentile_ns(double q) const {
+  if (count == 0) {
+    return 0;
+  }
+  const double target = std::ceil(q * static_cast<double>(count));
+  std::uint64_t seen = 0;
+  for (std::size_t b = 0; b < kBuckets; ++b) {
+    seen += counts[b];
+    if (static_cast<double>(seen) >= target && counts[b] != 0) {
+      return bucket_limit(b) - 1;
+    }
+  }
+  return bucket_limit(kBuckets - 1) - 1;
+}
+
+namespace {
+
+// `ns` nanoseconds as an exact decimal number of seconds, so large sums keep
+// every digit and neighbouring bucket bounds never print alike.
+std::string format_seconds(std::uint64_t ns) {
+  std::string frac = std::to_string(ns % 1000000000u);
+  frac.insert(0, 9 - frac.size(), '0');
+  frac.erase(frac.find_last_not_of('0') + 1);
+  return std::to_string(ns / 1000000000u) + (frac.empty() ? "" : "." + frac);
+}
+
+} // namespace
+
+std::string metrics_prometheus(const MetricsSnapshot &snapshot) {
+  std::ostringstream out;
+  out << "# HELP cube96_blocks_total Blocks processed by the round engines.\n"
+         "# TYPE cube96_blocks_total counter\n"
+         "cube96_blocks_total{direction=\"encrypt\"} "
+      << snapshot.blocks_encrypted << "\ncube96_blocks_total{direction=\"decrypt\"} "
+      << snapshot.blocks_decrypted
+      << "\n# HELP cube96_set_key_total Contexts keyed by setKey or setKeys.\n"
+         "# TYPE cube96_set_key_total counter\n"
+         "cube96_set_key_total "
+      << snapshot.set_key_calls
+      << "\n# HELP cube96_bytes_total Bytes processed, by mode.\n"
+         "# TYPE cube96_bytes_total counter\n";
+  for (std::size_t m = 0; m < kMetricsModes; ++m) {
+    out << "cube96_bytes_total{mode=\"" << metrics_mode_name(static_cast<MetricsMode>(m))
+        << "\"} " << snapshot.bytes[m] << '\n';
+  }
+  out << "# HELP cube96_latency_seconds Latency of setKey and batch calls.\n"
+         "# TYPE cube96_latency_seconds histogram\n";
+  constexpr unsigned kFirstBound = 8;  // 256 ns
+  for (std::size_t o = 0; o < kMetricsOps; ++o) {
+    const LatencyHistogram &h = snapshot.latency[o];
+    const char *op = metrics_op_name(static_cast<MetricsOp>(o));
+    // Exponent e's buckets start at index (e - kSubBucketBits + 1) * 16, so
+    // a power-of-two bound is always a bucket edge.
+    std::uint64_t cumulative = 0;
+    std::size_t b = 0;
+    for (unsigned e = kFirstBound; e <= LatencyHistogram::kMaxExponent; ++e) {
+      const std::size_t edge =
+          (e - LatencyHistogram::kSubBucketBits + 1) * LatencyHistogram::kSubBuckets;
+      for (; b < edge && b < LatencyHistogram::kBuckets; ++b) {
+        cumulative += h.counts[b];
+      }
+      out << "cube96_latency_seconds_bucket{op=\"" << op << "\",le=\""
+          << format_seconds(std::uint64_t{1} << e) << "\"} " << cumulative << '\n';
+    }
+    out << "cube96_latency_seconds_bucket{op=\"" << op << "\",le=\"+Inf\"} " << h.count
+        << "\ncube96_latency_seconds_sum{op=\"" << op << "\"} "
+        << format_seconds(h.sum_ns) << "\ncube96_latency_seconds_count{op=\"" << op
+        << "\"} " << h.count << '\n';
+  }
+  return out.str();
+}
+
+#if defined(CUBE96_ENABLE_METRICS)
+
+namespace {
+
+constexpr std::size_t kStripes = 16;
+
+// One cache line of counters; each thread adds to the stripe it was given.
+struct alignas(64) Stripe {
+  std::atomic<std::uint64_t> blocks[2]{};
+  std::atomic<std::uint64_t> keys{};
+  std::atomic<std::uint64_t> bytes[kMetricsModes]{};
+};
+
+// Histograms are striped like the counters.  Buckets are only touched as
+// latencies land in them, so unused stripes cost no resident memory.
+struct alignas(64) AtomicHistogram {
+  std::atomic<std::uint64_t> counts[LatencyHistogram::kBuckets]{};
+  std::atomic<std::uint64_t> count{};
+  std::atomic<std::uint64_t> sum_ns{};
+};
+
+struct Metrics {
+  Stripe stripes[kStripes];
+  AtomicHistogram latency[kStripes][kMetricsOps];
+};
+
+Metrics &metrics() {
+  static Metrics m;
+  return m;
+}
+
+std::size_t thread_stripe_index() {
+  static std::atomic<std::size_t> next{0};
+  thread_local const std::size_t index = next.fetch_add(1, std::memory_order_relaxed) % kStripes;
+  return index;
+}
+
+Stripe &thread_stripe() { return metrics().stripes[thread_stripe_index()]; }
+
+} // namespace
+
+void detail::metrics_count_blocks(bool decrypt, std::uint64_t blocks) {
+  thread_stripe().blocks[decrypt ? 1 : 0].fetch_add(blocks, std::memory_order_relaxed);
+}
+
+void detail::metrics_count_bytes(MetricsMode mode, std::uint64_t bytes) {
+  thread_stripe().bytes[static_cast<std::size_t>(mode)].fetch_add(bytes,
+                                                                   std::memory_order_relaxed);
+}
+
+void detail::metrics_count_keys(std::uint64_t keys) {
+  thread_stripe().keys.fetch_add(keys, std::memory_order_relaxed);
+}
+
+void detail::metrics_record(MetricsOp op, std::uint64_t ns, std::uint64_t samples) {
+  if (samples == 0) {
+    return;
+  }
+  AtomicHistogram &h = metrics().latency[thread_stripe_index()][static_cast<std::size_t>(op)];
+  h.counts[LatencyHistogram::bucket_for(ns / samples)].fetch_add(samples,
+                                                                 std::memory_order_relaxed);
+  h.count.fetch_add(samples, std::memory_order_relaxed);
+  h.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+}
+
+bool metrics_enabled() { return true; }
+
+MetricsSnapshot metrics_snapshot() {
+  Metrics &m = metrics();
+  MetricsSnapshot snapshot;
+  for (const Stripe &s : m.stripes) {
+    snapshot.blocks_encrypted += s.blocks[0].load(std::memory_order_relaxed);
+    snapshot.blocks_decrypted += s.blocks[1].load(std::memory_order_relaxed);
+    snapshot.set_key_calls += s.keys.load(std::memory_order_relaxed);
+    for (std::size_t k = 0; k < kMetricsModes; ++k) {
+      snapshot.bytes[k] += s.bytes[k].load(std::memory_order_relaxed);
+    }
+  }
+  for (const auto &stripe : m.latency) {
+    for (std::size_t o = 0; o < kMetricsOps; ++o) {
+      const AtomicHistogram &from = stripe[o];
+      LatencyHistogram &to = snapshot.latency[o];
+      for (std::size_t b = 0; b < LatencyHistogram::kBuckets; ++b) {
+        to.counts[b] += from.counts[b].load(std::memory_order_relaxed);
+      }
+      to.count += from.count.load(std::memory_order_relaxed);
+      to.sum_ns += from.sum_ns.load(std::memory_order_relaxed);
+    }
+  }
+  return snapshot;
+}
+
+void metrics_reset() {
+  Metrics &m = metrics();
+  for (Stripe &s : m.stripes) {
+    s.blocks[0].store(0, std::memory_order_relaxed);
+    s.blocks[1].store(0, std::memory_order_relaxed);
+    s.keys.store(0, std::memory_order_relaxed);
+    for (auto &bytes : s.bytes) {
+      bytes.store(0, std::memory_order_relaxed);
+    }
+  }
+  for (auto &stripe : m.latency) {
+    for (AtomicHistogram &h : stripe) {
+      for (auto &c : h.counts) {
+        c.store(0, std::memory_order_relaxed);
+      }
+      h.count.store(0, std::memory_order_relaxed);
+      h.sum_ns.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+#else
+
+bool metrics_enabled() { return false; }
+
+MetricsSnapshot metrics_snapshot() { return MetricsSnapshot{}; }
+
+void metrics_reset() {}
+
+#endif
+
+} // namespace cube96
@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: MIT
+
+#include "cube96/parallel.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "cube96/bitslice.hpp"
+
+namespace cube96 {
+
+namespace {
+
+// Pool whose task the current thread is executing, if any.  A nested run()
+// on that pool would wait on itself, so it runs inline instead.
+thread_local const ThreadPool *t_serving = nullptr;
+
+} // namespace
+
+ThreadPool::ThreadPool(std::size_t threads) {
+  if (threads == 0) {
+    threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+  }
+  for (std::size_t i = 0; i < threads; ++i) {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+  // Queue 0 belongs to the thread calling run().
+  for (std::size_t i = 1; i < threads; ++i) {
+    workers_.emplace_back([this, i] { worker_loop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+ThreadPool &ThreadPool::shared() {
+  static ThreadPool pool;
+  return pool;
+}
+
+bool ThreadPool::pop(std::size_t self, std::size_t &index) {
+  {
+    Queue &own = *queues_[self];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      index = own.tasks.front();
+      own.tasks.pop_front();
+      return true;
+    }
+  }
+  for (std::size_t step = 1; step < queues_.size(); ++step) {
+    Queue &victim = *queues_[(self + step) % queues_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      index = victim.tasks.back();
+      victim.tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::drain(std::size_t self, const std::function<void(std::size_t)> &task) {
+  const ThreadPool *const outer = t_serving;
+  t_serving = this;
+  std::size_t index = 0;
+  while (pop(self, index)) {
+    try {
+      task(index);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) {
+        error_ = std::current_exception();
+      }
+    }
+    if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_.notify_all();
+    }
+  }
+  t_serving = outer;
+}
+
+void ThreadPool::worker_loop(std::size_t self) {
+  std::uint64_t seen = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+    if (stop_) {
+      return;
+    }
+    seen = generation_;
+    // A worker that wakes after its batch already finished sees no job and
+    // goes back to sleep without touching the queues.
+    const std::function<void(std::size_t)> *job = job_;
+    if (job == nullptr) {
+      continue;
+    }
+    ++active_;
+    lock.unlock();
+    drain(self, *job);
+    lock.lock();
+    if (--active_ == 0) {
+      done_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::run(std::size_t count, const std::function<void(std::size_t)> &task) {
+  if (count == 0) {
+    return;
+  }
+  if (workers_.empty() || count == 1 || t_serving == this) {
+    for (std::size_t i = 0; i < count; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> serialize(run_mutex_);
+  const std::size_t parts = queues_.size();
+  for (std::size_t q = 0; q < parts; ++q) {
+    Queue &queue = *queues_[q];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    for (std::size_t i = q * count / parts; i < (q + 1) * count / parts; ++i) {
+      queue.tasks.push_back(i);
+    }
+  }
+  remaining_.store(count, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = &task;
+    error_ = nullptr;
+    ++generation_;
+  }
+  wake_.notify_all();
+
+  drain(0, task);
+
+  std::exception_ptr error;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] {
+      return remaining_.load(std::memory_order_acquire) == 0 && active_ == 0;
+    });
+    job_ = nullptr;
+    error = error_;
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+namespace {
+
+// Chunks never drop below this many blocks (48 KiB), so the per-task
+// overhead stays small next to the cipher work.
+constexpr std::size_t kMinChunkBlocks = 4096;
+// Chunks per participant; more than one lets stealing even out stragglers.
+constexpr std::size_t kChunksPerThread = 4;
+
+std::size_t chunk_blocks_for(std::size_t blocks, std::size_t concurrency) {
+  const std::size_t wanted = std::max<std::size_t>(1, concurrency * kChunksPerThread);
+  std::size_t chunk = std::max(kMinChunkBlocks, (blocks + wanted - 1) / wanted);
+  chunk = (chunk + kBitsliceLanes - 1) / kBitsliceLanes * kBitsliceLanes;
+  return chunk;
+}
+
+template <typename Fn>
+void run_chunked(std::size_t blocks, Executor *executor, Fn &&fn) {
+  Executor &exec = executor != nullptr ? *executor : ThreadPool::shared();
+  const std::size_t chunk = chunk_blocks_for(blocks, exec.concurrency());
+  if (exec.concurrency() <= 1 || blocks <= chunk) {
+    fn(0, blocks);
+    return;
+  }
+  const std::size_t chunks = (blocks + chunk - 1) / chunk;
+  exec.run(chunks, [&](std::size_t i) {
+    const std::size_t first = i * chunk;
+    fn(first, std::min(chunk, blocks - first));
+  });
+}
+
+} // namespace
+
+void encrypt_blocks_parallel(const CubeCipher &cipher, const std::uint8_t *in,
+                             std::uint8_t *out, std::size_t blocks, Executor *executor) {
+  run_chunked(blocks, executor, [&](std::size_t first, std::size_t count) {
+    cipher.encryptBlocks(in + first * kBlockBytes, out + first * kBlockBytes, count);
+  });
+}
+
+void decrypt_blocks_parallel(const CubeCipher &cipher, const std::uint8_t *in,
+                             std::uint8_t *out, std::size_t blocks, Executor *executor) {
+  run_chunked(blocks, executor, [&](std::size_t first, std::size_t count) {
+    cipher.decryptBlocks(in + first * kBlockBytes, out + first * kBlockBytes, count);
+  });
+}
+
+void ctr_crypt_parallel(const CubeCipher &cipher, const std::uint8_t nonce[kCtrNonceBytes],
+                        std::uint32_t initial_counter, std::uint64_t offset,
+                        const std::uint8_t *in, std::uint8_t *out, std::size_t len,
+                        Executor *executor) {
+  // Validate the whole range up front so no chunk writes output on failure.
+  CtrMode probe(cipher, nonce, initial_counter);
+  probe.seek(offset);
+  if (len > probe.keystreamBytes() - offset) {
+    throw std::out_of_range("CTR range exceeds the 32-bit counter space");
+  }
+  // Chunk over whole blocks of the byte range; the last one takes the tail.
+  const std::size_t blocks = (len + kBlockBytes - 1) / kBlockBytes;
+  run_chunked(blocks, executor, [&](std::size_t first, std::size_t count) {
+    const std::size_t begin = first * kBlockBytes;
+    const std::size_t bytes = std::min(count * kBlockBytes, len - begin);
+    CtrMode ctr(cipher, nonce, initial_counter);
+    ctr.seek(offset + begin);
+    ctr.crypt(in + begin, out + begin, bytes);
+  });
+}
+
+} // namespace cube96
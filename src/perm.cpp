@@ -5,7 +5,10 @@
 #include <algorithm>
 #include <cstring>
 
+#include <limits>
+
 #include "cube96/ct_utils.hpp"
+#include "cube96/impl_dispatch.hpp"
 #include "cube96/types.hpp"
 
 namespace cube96 {
@@ -81,9 +84,144 @@ void apply_permutation_ct(const Permutation &p, const std::uint8_t in[kBlockByte
   std::memcpy(out, tmp, kBlockBytes);
 }
 
+void compile_gather_table(const Permutation &p, GatherTable &table,
+                          const std::uint8_t *sbox) {
+  // Seed the single-bit images, then build every byte value from its lowest
+  // set bit and the entry for the remaining bits.
+  for (std::size_t b = 0; b < kBlockBytes; ++b) {
+    table[b][0] = GatherEntry{0, 0};
+  }
+  for (std::uint8_t src = 0; src < kPermSize; ++src) {
+    const std::uint8_t dst = p[src];
+    const std::uint8_t dst_byte = byte_index_of_bit(dst);
+    const std::uint8_t dst_pos = bit_offset_in_byte(dst);
+    GatherEntry bit{0, 0};
+    if (dst_byte < 8) {
+      bit.hi = std::uint64_t{1} << (8u * (7u - dst_byte) + dst_pos);
+    } else {
+      bit.lo = std::uint32_t{1} << (8u * (11u - dst_byte) + dst_pos);
+    }
+    const std::uint8_t src_mask = static_cast<std::uint8_t>(1u << bit_offset_in_byte(src));
+    table[byte_index_of_bit(src)][src_mask] = bit;
+  }
+  for (std::size_t b = 0; b < kBlockBytes; ++b) {
+    for (unsigned v = 3; v < 256; ++v) {
+      const unsigned low = v & (0u - v);
+      if (low == v) {
+        continue;
+      }
+      const GatherEntry &a = table[b][low];
+      const GatherEntry &rest = table[b][v ^ low];
+      table[b][v] = a | rest;
+    }
+  }
+
+  if (sbox != nullptr) {
+    for (std::size_t b = 0; b < kBlockBytes; ++b) {
+      const std::array<GatherEntry, 256> plain = table[b];
+      for (unsigned v = 0; v < 256; ++v) {
+        table[b][v] = plain[sbox[v]];
+      }
+    }
+  }
+}
+
+void apply_gather_table(const GatherTable &table, const std::uint8_t in[kBlockBytes],
+                        std::uint8_t out[kBlockBytes]) {
+  store_state(apply_gather_table(table, load_state(in)), out);
+}
+
 namespace {
 
-Permutation face_rotation(std::uint8_t z, int variant) {
+void set_benes_mask(BenesNetwork &net, std::size_t stage, std::size_t position) {
+  if (position >= 64) {
+    net.mask_hi[stage] |= std::uint64_t{1} << (position - 64);
+  } else {
+    net.mask_lo[stage] |= std::uint64_t{1} << position;
+  }
+}
+
+// Looping algorithm: split the n inputs between the lower and upper
+// subnetworks so that the two members of every input pair and every output
+// pair land in different halves, emit the outer swap masks for this level,
+// then recurse into both halves.  dst[i] is the output position of input i.
+void route_benes(const std::uint8_t *dst, std::size_t n, std::size_t base,
+                 std::size_t level, BenesNetwork &net) {
+  const std::size_t first = level;
+  const std::size_t last = kBenesStages - 1 - level;
+  if (n == 2) {
+    if (dst[0] != 0) {
+      set_benes_mask(net, first, base);
+    }
+    return;
+  }
+
+  const std::size_t half = n / 2;
+  std::uint8_t src[kBenesWidth];
+  std::int8_t side[kBenesWidth];
+  for (std::size_t i = 0; i < n; ++i) {
+    src[dst[i]] = static_cast<std::uint8_t>(i);
+    side[i] = -1;
+  }
+
+  for (std::size_t start = 0; start < n; ++start) {
+    if (side[start] >= 0) {
+      continue;
+    }
+    std::size_t cur = start;
+    side[cur] = 0;
+    for (;;) {
+      const std::size_t partner = cur ^ half;
+      side[partner] = static_cast<std::int8_t>(1 - side[cur]);
+      const std::size_t next = src[dst[partner] ^ half];
+      if (side[next] >= 0) {
+        break;
+      }
+      side[next] = side[cur];
+      cur = next;
+    }
+  }
+
+  std::uint8_t sub_dst[2][kBenesWidth / 2];
+  for (std::size_t i = 0; i < n; ++i) {
+    sub_dst[side[i]][i & (half - 1)] = static_cast<std::uint8_t>(dst[i] & (half - 1));
+  }
+  for (std::size_t i = 0; i < half; ++i) {
+    if (side[i] == 1) {
+      set_benes_mask(net, first, base + i);
+    }
+    if (side[src[i]] == 1) {
+      set_benes_mask(net, last, base + i);
+    }
+  }
+
+  route_benes(sub_dst[0], half, base, level + 1, net);
+  route_benes(sub_dst[1], half, base + half, level + 1, net);
+}
+
+} // namespace
+
+BenesNetwork compile_benes_network(const Permutation &p) {
+  std::uint8_t dst[kBenesWidth];
+  for (std::size_t i = 0; i < kBenesWidth; ++i) {
+    dst[i] = static_cast<std::uint8_t>(i);
+  }
+  for (std::uint8_t bit = 0; bit < kPermSize; ++bit) {
+    dst[benes_position(bit)] = benes_position(p[bit]);
+  }
+  BenesNetwork net;
+  route_benes(dst, kBenesWidth, 0, 0, net);
+  return net;
+}
+
+void apply_benes_network(const BenesNetwork &net, const std::uint8_t in[kBlockBytes],
+                         std::uint8_t out[kBlockBytes]) {
+  store_state(apply_benes_network(net, load_state(in)), out);
+}
+
+namespace {
+
+Permutation face_rotation(Layout layout, std::uint8_t z, int variant) {
   // variant: 0 = 90° CW, 1 = 90° CCW, 2 = 180°
   Permutation p = identity_permutation();
   for (std::uint8_t y = 0; y < 4; ++y) {
@@ -100,60 +238,60 @@ Permutation face_rotation(std::uint8_t z, int variant) {
         nx = static_cast<std::uint8_t>(3 - x);
         ny = static_cast<std::uint8_t>(3 - y);
       }
-      std::uint8_t src = idx_of(x, y, z);
-      std::uint8_t dst = idx_of(nx, ny, z);
+      std::uint8_t src = idx_of(layout, x, y, z);
+      std::uint8_t dst = idx_of(layout, nx, ny, z);
       p[src] = dst;
     }
   }
   return p;
 }
 
-Permutation row_cycle(std::uint8_t z, bool up) {
+Permutation row_cycle(Layout layout, std::uint8_t z, bool up) {
   Permutation p = identity_permutation();
   for (std::uint8_t y = 0; y < 4; ++y) {
     std::uint8_t ny = static_cast<std::uint8_t>((y + (up ? 1 : 3)) & 3u);
     for (std::uint8_t x = 0; x < 4; ++x) {
-      std::uint8_t src = idx_of(x, y, z);
-      std::uint8_t dst = idx_of(x, ny, z);
+      std::uint8_t src = idx_of(layout, x, y, z);
+      std::uint8_t dst = idx_of(layout, x, ny, z);
       p[src] = dst;
     }
   }
   return p;
 }
 
-Permutation column_cycle(std::uint8_t z, bool right) {
+Permutation column_cycle(Layout layout, std::uint8_t z, bool right) {
   Permutation p = identity_permutation();
   for (std::uint8_t x = 0; x < 4; ++x) {
     std::uint8_t nx = static_cast<std::uint8_t>((x + (right ? 1 : 3)) & 3u);
     for (std::uint8_t y = 0; y < 4; ++y) {
-      std::uint8_t src = idx_of(x, y, z);
-      std::uint8_t dst = idx_of(nx, y, z);
+      std::uint8_t src = idx_of(layout, x, y, z);
+      std::uint8_t dst = idx_of(layout, nx, y, z);
       p[src] = dst;
     }
   }
   return p;
 }
 
-Permutation x_slice_shift(std::uint8_t x) {
+Permutation x_slice_shift(Layout layout, std::uint8_t x) {
   Permutation p = identity_permutation();
   for (std::uint8_t y = 0; y < 4; ++y) {
     for (std::uint8_t z = 0; z < 6; ++z) {
       std::uint8_t nz = static_cast<std::uint8_t>((z + 1) % 6);
-      std::uint8_t src = idx_of(x, y, z);
-      std::uint8_t dst = idx_of(x, y, nz);
+      std::uint8_t src = idx_of(layout, x, y, z);
+      std::uint8_t dst = idx_of(layout, x, y, nz);
       p[src] = dst;
     }
   }
   return p;
 }
 
-Permutation y_slice_shift(std::uint8_t y) {
+Permutation y_slice_shift(Layout layout, std::uint8_t y) {
   Permutation p = identity_permutation();
   for (std::uint8_t x = 0; x < 4; ++x) {
     for (std::uint8_t z = 0; z < 6; ++z) {
       std::uint8_t nz = static_cast<std::uint8_t>((z + 1) % 6);
-      std::uint8_t src = idx_of(x, y, z);
-      std::uint8_t dst = idx_of(x, y, nz);
+      std::uint8_t src = idx_of(layout, x, y, z);
+      std::uint8_t dst = idx_of(layout, x, y, nz);
       p[src] = dst;
     }
   }
@@ -167,33 +305,114 @@ Permutation y_slice_shift(std::uint8_t y) {
 //           three times produces the same transformation, keeping the curated
 //           set compact and bijective.
 // 30..35  : aggregate z-shifts for x ∈ {0,1,2} followed by y ∈ {0,1,2}.
-const std::array<Permutation, 36> kPrimitives = [] {
-  std::array<Permutation, 36> prim{};
+std::array<Permutation, kPrimitiveCount> build_primitives(Layout layout) {
+  std::array<Permutation, kPrimitiveCount> prim{};
   std::size_t idx = 0;
   // 18 face rotations: z=0..5 with CW, CCW, 180°
   for (std::uint8_t z = 0; z < 6; ++z) {
-    prim[idx++] = face_rotation(z, 0);
-    prim[idx++] = face_rotation(z, 1);
-    prim[idx++] = face_rotation(z, 2);
+    prim[idx++] = face_rotation(layout, z, 0);
+    prim[idx++] = face_rotation(layout, z, 1);
+    prim[idx++] = face_rotation(layout, z, 2);
   }
   // 12 row/column cycles for z in {0,1,2,3}
   for (std::uint8_t z = 0; z < 4; ++z) {
-    prim[idx++] = row_cycle(z, true);   // rows cycle upwards
-    prim[idx++] = row_cycle(z, false);  // rows cycle downwards
-    prim[idx++] = column_cycle(z, true); // columns cycle rightwards
+    prim[idx++] = row_cycle(layout, z, true);   // rows cycle upwards
+    prim[idx++] = row_cycle(layout, z, false);  // rows cycle downwards
+    prim[idx++] = column_cycle(layout, z, true); // columns cycle rightwards
   }
   // 6 aggregate slice shifts (documented order)
-  prim[idx++] = x_slice_shift(0);
-  prim[idx++] = x_slice_shift(1);
-  prim[idx++] = x_slice_shift(2);
-  prim[idx++] = y_slice_shift(0);
-  prim[idx++] = y_slice_shift(1);
-  prim[idx++] = y_slice_shift(2);
+  prim[idx++] = x_slice_shift(layout, 0);
+  prim[idx++] = x_slice_shift(layout, 1);
+  prim[idx++] = x_slice_shift(layout, 2);
+  prim[idx++] = y_slice_shift(layout, 0);
+  prim[idx++] = y_slice_shift(layout, 1);
+  prim[idx++] = y_slice_shift(layout, 2);
   return prim;
-}();
+}
+
+const std::array<Permutation, kPrimitiveCount> kZSlicePrimitives =
+    build_primitives(Layout::ZSlice);
+const std::array<Permutation, kPrimitiveCount> kRowMajorPrimitives =
+    build_primitives(Layout::RowMajor);
+
+PrimitivePairTable build_pairs(Layout layout) {
+  const auto &prim = primitive_set(layout);
+  PrimitivePairTable table;
+  table.forward.resize(kPrimitiveCount * kPrimitiveCount);
+  table.inverse.resize(kPrimitiveCount * kPrimitiveCount);
+  for (std::size_t a = 0; a < kPrimitiveCount; ++a) {
+    for (std::size_t b = 0; b < kPrimitiveCount; ++b) {
+      const Permutation pair = compose(prim[a], prim[b]);
+      table.forward[a * kPrimitiveCount + b] = pair;
+      table.inverse[a * kPrimitiveCount + b] = invert(pair);
+    }
+  }
+  return table;
+}
 
 } // namespace
 
-const std::array<Permutation, 36> &primitive_set() { return kPrimitives; }
+const std::array<Permutation, kPrimitiveCount> &primitive_set(Layout layout) {
+  return layout == Layout::RowMajor ? kRowMajorPrimitives : kZSlicePrimitives;
+}
+
+const PrimitivePairTable &primitive_pairs(Layout layout) {
+  if (layout == Layout::RowMajor) {
+    static const PrimitivePairTable row_major = build_pairs(Layout::RowMajor);
+    return row_major;
+  }
+  static const PrimitivePairTable z_slice = build_pairs(Layout::ZSlice);
+  return z_slice;
+}
+
+PrimitivePairDraws draw_primitive_pairs(std::uint64_t seed) {
+  static_assert(kPrimitiveSteps % 2 == 0, "primitive steps are consumed in pairs");
+  constexpr std::uint64_t kLimit =
+      (std::numeric_limits<std::uint64_t>::max() / kPrimitiveCount) * kPrimitiveCount;
+
+  SplitMix64 prng(seed);
+  PrimitivePairDraws pairs{};
+  for (std::size_t step = 0; step < kPrimitiveSteps; ++step) {
+    std::uint64_t draw = prng.next();
+    while (draw >= kLimit) {
+      draw = prng.next();
+    }
+    const std::size_t pick = static_cast<std::size_t>(draw % kPrimitiveCount);
+    pairs[step / 2] = step % 2 == 0 ? pick * kPrimitiveCount : pairs[step / 2] + pick;
+  }
+  return pairs;
+}
+
+// compose() is associative, so pairing adjacent steps keeps the draw order:
+// perm = P0 P1 ... P5 and inv = P5^-1 ... P0^-1 over the pairs Pk.
+Permutation compose_pairs_forward(const PrimitivePairTable &table,
+                                  const PrimitivePairDraws &pairs) {
+  Permutation perm = table.forward[pairs[0]];
+  for (std::size_t k = 1; k < kPrimitivePairs; ++k) {
+    perm = compose_vec(perm, table.forward[pairs[k]]);
+  }
+  return perm;
+}
+
+Permutation compose_pairs_inverse(const PrimitivePairTable &table,
+                                  const PrimitivePairDraws &pairs) {
+  Permutation inv = table.inverse[pairs[kPrimitivePairs - 1]];
+  for (std::size_t k = 1; k < kPrimitivePairs; ++k) {
+    inv = compose_vec(inv, table.inverse[pairs[kPrimitivePairs - 1 - k]]);
+  }
+  return inv;
+}
+
+void derive_round_permutation(std::uint64_t seed, Layout layout, Permutation *perm,
+                              Permutation *inv) {
+  const PrimitivePairDraws pairs = draw_primitive_pairs(seed);
+  const PrimitivePairTable &table = primitive_pairs(layout);
+  if (perm != nullptr) {
+    *perm = compose_pairs_forward(table, pairs);
+  }
+  if (inv != nullptr) {
+    *inv = compose_pairs_inverse(table, pairs);
+  }
+}
 
 } // namespace cube96
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: MIT
+
+#include "cube96/profile.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace cube96 {
+
+const char *profile_stage_name(ProfileStage stage) {
+  switch (stage) {
+  case ProfileStage::AddRoundKey:
+    return "add-key";
+  case ProfileStage::SubBytes:
+    return "sub-bytes";
+  case ProfileStage::Permute:
+    return "permute";
+  case ProfileStage::SubPermute:
+    return "sub+perm";
+  case ProfileStage::Transpose:
+    return "transpose";
+  }
+  return "?";
+}
+
+#if defined(CUBE96_ENABLE_PROFILING)
+
+namespace {
+
+// Live threads' cells plus the totals of threads that have exited.
+struct Registry {
+  std::mutex mutex;
+  std::vector<detail::ProfileCells *> live;
+  ProfileSnapshot retired;
+};
+
+// Never destroyed: threads of a static ThreadPool retire their cells during
+// static destruction, possibly after a function-local static would be gone.
+Registry &registry() {
+  static Registry *r = new Registry;
+  return *r;
+}
+
+ProfileTable &table_for(ProfileSnapshot &snapshot, std::size_t dir) {
+  return dir == 0 ? snapshot.encrypt : snapshot.decrypt;
+}
+
+void accumulate(ProfileSnapshot &into, const detail::ProfileCells &cells) {
+  for (std::size_t d = 0; d < kProfileDirections; ++d) {
+    ProfileTable &table = table_for(into, d);
+    for (std::size_t s = 0; s < kProfileSlots; ++s) {
+      for (std::size_t k = 0; k < kProfileStages; ++k) {
+        table[s][k].ticks += cells.ticks[d][s][k].load(std::memory_order_relaxed);
+        table[s][k].calls += cells.calls[d][s][k].load(std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+struct ThreadCells {
+  ThreadCells() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.live.push_back(&cells);
+  }
+  ~ThreadCells() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    accumulate(r.retired, cells);
+    r.live.erase(std::find(r.live.begin(), r.live.end(), &cells));
+  }
+  detail::ProfileCells cells;
+};
+
+// Smallest difference between back-to-back timer reads.
+double timer_overhead() {
+  std::uint64_t best = std::numeric_limits<std::uint64_t>::max();
+  for (int i = 0; i < 1000; ++i) {
+    const std::uint64_t t0 = detail::profile_ticks();
+    const std::uint64_t t1 = detail::profile_ticks();
+    best = std::min(best, t1 - t0);
+  }
+  return static_cast<double>(best);
+}
+
+} // namespace
+
+detail::ProfileCells &detail::thread_profile_cells() {
+  thread_local ThreadCells slot;
+  return slot.cells;
+}
+
+bool profiling_enabled() { return true; }
+
+ProfileSnapshot profile_snapshot() {
+  Registry &r = registry();
+  ProfileSnapshot snapshot;
+  {
+    std::lock_guard<std::mutex> lock(r.mutex);
+    snapshot = r.retired;
+    for (const detail::ProfileCells *cells : r.live) {
+      accumulate(snapshot, *cells);
+    }
+  }
+  snapshot.overhead_ticks = timer_overhead();
+#if defined(CUBE96_PROFILE_TSC)
+  snapshot.unit = "tsc";
+#else
+  snapshot.unit = "ns";
+#endif
+  return snapshot;
+}
+
+void profile_reset() {
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.retired = ProfileSnapshot{};
+  for (detail::ProfileCells *cells : r.live) {
+    for (std::size_t d = 0; d < kProfileDirections; ++d) {
+      for (std::size_t s = 0; s < kProfileSlots; ++s) {
+        for (std::size_t k = 0; k < kProfileStages; ++k) {
+          cells->ticks[d][s][k].store(0, std::memory_order_relaxed);
+          cells->calls[d][s][k].store(0, std::memory_order_relaxed);
+        }
+      }
+    }
+  }
+}
+
+#else
+
+bool profiling_enabled() { return false; }
+
+ProfileSnapshot profile_snapshot() { return ProfileSnapshot{}; }
+
+void profile_reset() {}
+
+#endif
+
+} // namespace cube96
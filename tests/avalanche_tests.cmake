@@ -0,0 +1,56 @@
+# SPDX-License-Identifier: MIT
+# Smoke tests for cube96_avalanche option parsing and report output.
+
+include(CMakeParseArguments)
+
+if(NOT DEFINED AVALANCHE_EXECUTABLE)
+  message(FATAL_ERROR "AVALANCHE_EXECUTABLE not provided")
+endif()
+
+function(run_avalanche_case name expected_exit)
+  cmake_parse_arguments(_CASE "" "" "ARGS;EXPECT_STDOUT;EXPECT_STDERR" ${ARGN})
+  execute_process(
+    COMMAND "${AVALANCHE_EXECUTABLE}" ${_CASE_ARGS}
+    RESULT_VARIABLE _result
+    OUTPUT_VARIABLE _stdout
+    ERROR_VARIABLE _stderr
+  )
+  if(NOT _result EQUAL ${expected_exit})
+    message(FATAL_ERROR "${name}: exit ${_result} != ${expected_exit}\nstdout=${_stdout}\nstderr=${_stderr}")
+  endif()
+  foreach(_needle IN LISTS _CASE_EXPECT_STDOUT)
+    string(FIND "${_stdout}" "${_needle}" _pos)
+    if(_pos EQUAL -1)
+      message(FATAL_ERROR "${name}: stdout missing '${_needle}'\nstdout=${_stdout}")
+    endif()
+  endforeach()
+  foreach(_needle IN LISTS _CASE_EXPECT_STDERR)
+    string(FIND "${_stderr}" "${_needle}" _pos)
+    if(_pos EQUAL -1)
+      message(FATAL_ERROR "${name}: stderr missing '${_needle}'\nstderr=${_stderr}")
+    endif()
+  endforeach()
+endfunction()
+
+run_avalanche_case("usage" 1 ARGS "--samples" "0" EXPECT_STDERR "Usage:" "N / 64 keys")
+run_avalanche_case("bad-flip" 1 ARGS "--flip" "cipher" EXPECT_STDERR "Usage:")
+
+# One batch: 64 samples under a single key, both flip types, one thread.
+set(_matrix_dir "${CMAKE_CURRENT_BINARY_DIR}/avalanche_matrices")
+file(REMOVE_RECURSE "${_matrix_dir}")
+file(MAKE_DIRECTORY "${_matrix_dir}")
+run_avalanche_case("smoke" 0 ARGS "--samples" "64" "--threads" "1" "--matrix-dir" "${_matrix_dir}"
+                   EXPECT_STDOUT "plaintext flips, 64 samples per input bit over 1 keys"
+                                 "key flips, 64 samples per input bit over 1 keys"
+                                 "bit independence"
+                   EXPECT_STDERR "Research cipher")
+foreach(_file sac_plaintext_round1.csv sac_key_round8.csv bic_plaintext.csv bic_key.csv)
+  if(NOT EXISTS "${_matrix_dir}/${_file}")
+    message(FATAL_ERROR "smoke: ${_file} not written")
+  endif()
+endforeach()
+file(STRINGS "${_matrix_dir}/sac_plaintext_round8.csv" _rows)
+list(LENGTH _rows _row_count)
+if(NOT _row_count EQUAL 96)
+  message(FATAL_ERROR "smoke: sac_plaintext_round8.csv has ${_row_count} rows, expected 96")
+endif()
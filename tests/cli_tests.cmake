@@ -13,9 +13,14 @@ endif()
 set(_cases)
 
 function(run_cli_case name expected_exit)
-  cmake_parse_arguments(_CASE "" "" "ARGS;EXPECT_STDOUT;EXPECT_STDERR" ${ARGN})
+  cmake_parse_arguments(_CASE "" "INPUT" "ARGS;EXPECT_STDOUT;EXPECT_STDERR" ${ARGN})
+  set(_input)
+  if(_CASE_INPUT)
+    set(_input INPUT_FILE "${_CASE_INPUT}")
+  endif()
   execute_process(
     COMMAND "${CLI_EXECUTABLE}" ${_CASE_ARGS}
+    ${_input}
     RESULT_VARIABLE _result
     OUTPUT_VARIABLE _stdout
     ERROR_VARIABLE _stderr
@@ -48,3 +53,56 @@ run_cli_case("bad-data-length" 65 ARGS "enc" "${KAT_KEY}" "${KAT_PLAIN}00" EXPEC
 run_cli_case("bad-hex" 65 ARGS "enc" "${KAT_KEY}" "${KAT_PLAIN}GG" EXPECT_STDERR "Invalid plaintext")
 run_cli_case("encrypt" 0 ARGS "enc" "${KAT_KEY}" "${KAT_PLAIN}" EXPECT_STDOUT "${KAT_CIPHER}" EXPECT_STDERR "Research cipher")
 run_cli_case("decrypt" 0 ARGS "dec" "${KAT_KEY}" "${KAT_CIPHER}" EXPECT_STDOUT "${KAT_PLAIN}" EXPECT_STDERR "Research cipher")
+
+# File mode: round-trip a payload that is not a multiple of the block size.
+set(_plain_file "${CMAKE_CURRENT_BINARY_DIR}/cli_file_plain.bin")
+set(_sealed_file "${CMAKE_CURRENT_BINARY_DIR}/cli_file_sealed.bin")
+set(_opened_file "${CMAKE_CURRENT_BINARY_DIR}/cli_file_opened.bin")
+set(_payload "")
+foreach(_i RANGE 1 300)
+  string(APPEND _payload "cube96 line ${_i}\n")
+endforeach()
+file(WRITE "${_plain_file}" "${_payload}")
+
+run_cli_case("enc-file" 0 ARGS "enc-file" "${KAT_KEY}" "${_plain_file}" "${_sealed_file}"
+             EXPECT_STDOUT "Encrypted" "MiB/s")
+run_cli_case("dec-file" 0 ARGS "dec-file" "${KAT_KEY}" "${_sealed_file}" "${_opened_file}"
+             EXPECT_STDOUT "Decrypted")
+file(SIZE "${_plain_file}" _plain_size)
+file(SIZE "${_sealed_file}" _sealed_size)
+math(EXPR _expected_sealed "${_plain_size} + 8")
+if(NOT _sealed_size EQUAL _expected_sealed)
+  message(FATAL_ERROR "enc-file: output size ${_sealed_size} != ${_expected_sealed}")
+endif()
+file(SHA256 "${_plain_file}" _plain_hash)
+file(SHA256 "${_opened_file}" _opened_hash)
+if(NOT _plain_hash STREQUAL _opened_hash)
+  message(FATAL_ERROR "dec-file: round-trip mismatch")
+endif()
+# The same path as input and output round-trips in place.
+set(_inplace_file "${CMAKE_CURRENT_BINARY_DIR}/cli_file_inplace.bin")
+file(WRITE "${_inplace_file}" "${_payload}")
+run_cli_case("enc-file-in-place" 0 ARGS "enc-file" "${KAT_KEY}" "${_inplace_file}"
+             "${_inplace_file}" EXPECT_STDOUT "Encrypted")
+run_cli_case("dec-file-in-place" 0 ARGS "dec-file" "${KAT_KEY}" "${_inplace_file}"
+             "${_inplace_file}" EXPECT_STDOUT "Decrypted")
+file(SHA256 "${_inplace_file}" _inplace_hash)
+if(NOT _plain_hash STREQUAL _inplace_hash)
+  message(FATAL_ERROR "in-place file mode: round-trip mismatch")
+endif()
+run_cli_case("file-missing-input" 74 ARGS "enc-file" "${KAT_KEY}" "${_plain_file}.missing"
+             "${_opened_file}" EXPECT_STDERR "Cannot read")
+run_cli_case("file-bad-mode" 66 ARGS "foo-file" "${KAT_KEY}" "${_plain_file}" "${_opened_file}"
+             EXPECT_STDERR "Unknown mode")
+
+# Batch mode: mode/key lines, bare data lines reusing them, and per-line errors.
+set(_batch_good "${CMAKE_CURRENT_BINARY_DIR}/cli_batch_good.txt")
+file(WRITE "${_batch_good}"
+  "enc ${KAT_KEY} ${KAT_PLAIN}\n${KAT_PLAIN}\n\ndec ${KAT_KEY} ${KAT_CIPHER}\n")
+run_cli_case("batch" 0 ARGS "--batch" INPUT "${_batch_good}"
+             EXPECT_STDOUT "${KAT_CIPHER}\n${KAT_CIPHER}\n${KAT_PLAIN}\n")
+set(_batch_bad "${CMAKE_CURRENT_BINARY_DIR}/cli_batch_bad.txt")
+file(WRITE "${_batch_bad}"
+  "${KAT_PLAIN}\nenc ${KAT_KEY} ${KAT_PLAIN}GG\nenc ${KAT_KEY} ${KAT_PLAIN}\n")
+run_cli_case("batch-errors" 65 ARGS "--batch" INPUT "${_batch_bad}"
+             EXPECT_STDOUT "error: data line before" "error: invalid data\n${KAT_CIPHER}")
@@ -0,0 +1,201 @@
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "cube96/cipher.hpp"
+#include "cube96/ctr.hpp"
+
+namespace {
+
+constexpr std::size_t kBlock = cube96::CubeCipher::BlockBytes;
+
+// Reference keystream: one encryptBlock call per counter block.
+std::vector<std::uint8_t> reference_keystream(const cube96::CubeCipher &cipher,
+                                              const std::uint8_t nonce[8],
+                                              std::uint32_t counter, std::size_t blocks) {
+  std::vector<std::uint8_t> stream(blocks * kBlock);
+  for (std::size_t i = 0; i < blocks; ++i) {
+    std::array<std::uint8_t, kBlock> block{};
+    std::copy(nonce, nonce + 8, block.begin());
+    const std::uint32_t c = counter + static_cast<std::uint32_t>(i);
+    block[8] = static_cast<std::uint8_t>(c >> 24);
+    block[9] = static_cast<std::uint8_t>(c >> 16);
+    block[10] = static_cast<std::uint8_t>(c >> 8);
+    block[11] = static_cast<std::uint8_t>(c);
+    cipher.encryptBlock(block.data(), stream.data() + i * kBlock);
+  }
+  return stream;
+}
+
+// Streaming: arbitrary piece sizes must reproduce the one-shot CtrMode output.
+bool check_stream(const cube96::CubeCipher &cipher, const std::uint8_t nonce[8],
+                  std::mt19937_64 &rng) {
+  std::uniform_int_distribution<int> dist(0, 255);
+  std::uniform_int_distribution<std::size_t> piece(0, 40);
+  std::vector<std::uint8_t> plain(5000);
+  for (auto &v : plain) {
+    v = static_cast<std::uint8_t>(dist(rng));
+  }
+  std::vector<std::uint8_t> expected(plain.size());
+  cube96::CtrMode ctr(cipher, nonce, 3);
+  ctr.crypt(plain.data(), expected.data(), plain.size());
+
+  cube96::CtrStream stream(cipher, nonce, 3);
+  std::vector<std::uint8_t> out(plain.size());
+  std::size_t done = 0;
+  while (done < plain.size()) {
+    // Mix tiny pieces with occasional runs spanning several chunks.
+    std::size_t take = piece(rng);
+    if (take == 40) {
+      take = 1000;
+    }
+    take = std::min(take, plain.size() - done);
+    stream.update(plain.data() + done, out.data() + done, take);
+    done += take;
+    if (stream.bytesProcessed() != done) {
+      std::cerr << "CtrStream position mismatch\n";
+      return false;
+    }
+  }
+  if (out != expected || stream.finalize() != plain.size()) {
+    std::cerr << "CtrStream output mismatch\n";
+    return false;
+  }
+  bool threw = false;
+  try {
+    stream.update(plain.data(), out.data(), 1);
+  } catch (const std::logic_error &) {
+    threw = true;
+  }
+  if (!threw) {
+    std::cerr << "CtrStream update after finalize not rejected\n";
+    return false;
+  }
+  return true;
+}
+
+bool check_impl(cube96::CubeCipher::Impl impl, std::mt19937_64 &rng) {
+  std::uniform_int_distribution<int> dist(0, 255);
+  std::array<std::uint8_t, cube96::CubeCipher::KeyBytes> key{};
+  std::array<std::uint8_t, cube96::kCtrNonceBytes> nonce{};
+  for (auto &b : key) {
+    b = static_cast<std::uint8_t>(dist(rng));
+  }
+  for (auto &b : nonce) {
+    b = static_cast<std::uint8_t>(dist(rng));
+  }
+  cube96::CubeCipher cipher(impl);
+  cipher.setKey(key.data());
+
+  const std::uint32_t initial = 0xFFFFFF00u;
+  const std::size_t blocks = 200;  // several chunks, ending just below 2^32
+  const auto expected = reference_keystream(cipher, nonce.data(), initial, blocks);
+
+  cube96::CtrMode ctr(cipher, nonce.data(), initial);
+  std::vector<std::uint8_t> stream(expected.size());
+  ctr.keystream(stream.data(), stream.size());
+  if (stream != expected || ctr.position() != expected.size()) {
+    std::cerr << "CTR keystream mismatch for impl " << static_cast<int>(impl) << "\n";
+    return false;
+  }
+
+  // Random-access: every (offset, length) window must match the prefix-free
+  // reference and round-trip through crypt().
+  std::uniform_int_distribution<std::size_t> pos(0, expected.size());
+  for (int trial = 0; trial < 64; ++trial) {
+    std::size_t a = pos(rng);
+    std::size_t b = pos(rng);
+    if (a > b) {
+      std::swap(a, b);
+    }
+    std::vector<std::uint8_t> plain(b - a);
+    for (auto &v : plain) {
+      v = static_cast<std::uint8_t>(dist(rng));
+    }
+    std::vector<std::uint8_t> sealed(plain.size());
+    ctr.seek(a);
+    ctr.crypt(plain.data(), sealed.data(), plain.size());
+    for (std::size_t i = 0; i < plain.size(); ++i) {
+      if (sealed[i] != static_cast<std::uint8_t>(plain[i] ^ expected[a + i])) {
+        std::cerr << "CTR seek mismatch at offset " << a + i << "\n";
+        return false;
+      }
+    }
+    ctr.seek(a);
+    ctr.crypt(sealed.data(), sealed.data(), sealed.size());
+    if (sealed != plain) {
+      std::cerr << "CTR in-place decrypt mismatch\n";
+      return false;
+    }
+  }
+
+  // Split calls continue exactly where the previous one stopped.
+  ctr.seek(5);
+  std::vector<std::uint8_t> pieces(expected.size() - 5);
+  std::size_t done = 0;
+  for (std::size_t step = 1; done < pieces.size(); step = step * 3 + 1) {
+    const std::size_t take = std::min(step, pieces.size() - done);
+    ctr.keystream(pieces.data() + done, take);
+    done += take;
+  }
+  if (!std::equal(pieces.begin(), pieces.end(), expected.begin() + 5)) {
+    std::cerr << "CTR split keystream mismatch\n";
+    return false;
+  }
+
+  // The counter space ends at 2^32 - 1.
+  if (ctr.keystreamBytes() != (0x100000000ull - initial) * kBlock) {
+    std::cerr << "CTR keystream length mismatch\n";
+    return false;
+  }
+  ctr.seek(ctr.keystreamBytes() - 1);
+  std::uint8_t last[2] = {0, 0};
+  bool threw = false;
+  try {
+    ctr.keystream(last, 2);
+  } catch (const std::out_of_range &) {
+    threw = true;
+  }
+  if (!threw) {
+    std::cerr << "CTR overflow not rejected\n";
+    return false;
+  }
+  ctr.keystream(last, 1);
+  threw = false;
+  try {
+    ctr.seek(ctr.keystreamBytes() + 1);
+  } catch (const std::out_of_range &) {
+    threw = true;
+  }
+  if (!threw) {
+    std::cerr << "CTR seek past end not rejected\n";
+    return false;
+  }
+  return check_stream(cipher, nonce.data(), rng);
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(0xC7Bu);
+
+  std::vector<cube96::CubeCipher::Impl> implementations;
+  if (cube96::CubeCipher::hasFastImpl()) {
+    implementations.push_back(cube96::CubeCipher::Impl::Fast);
+  }
+  if (cube96::CubeCipher::hasHardenedImpl()) {
+    implementations.push_back(cube96::CubeCipher::Impl::Hardened);
+  }
+
+  for (auto impl : implementations) {
+    if (!check_impl(impl, rng)) {
+      return 1;
+    }
+  }
+
+  std::cout << "test_ctr: OK\n";
+  return 0;
+}
@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: MIT
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "cube96/cipher.hpp"
+#include "cube96/key_cache.hpp"
+
+namespace {
+
+constexpr std::size_t kBlock = cube96::CubeCipher::BlockBytes;
+using Key = std::array<std::uint8_t, cube96::CubeCipher::KeyBytes>;
+
+Key make_key(std::uint32_t id) {
+  Key key{};
+  for (std::size_t i = 0; i < key.size(); ++i) {
+    key[i] = static_cast<std::uint8_t>((id >> (8 * (i % 4))) ^ (i * 0x3D));
+  }
+  return key;
+}
+
+bool matches_fresh(const cube96::CubeCipher &cached, const Key &key,
+                   cube96::CubeCipher::Impl impl) {
+  cube96::CubeCipher fresh(impl);
+  fresh.setKey(key.data());
+  std::array<std::uint8_t, kBlock> plain{}, a{}, b{};
+  for (std::size_t i = 0; i < kBlock; ++i) {
+    plain[i] = static_cast<std::uint8_t>(i * 17 + 3);
+  }
+  cached.encryptBlock(plain.data(), a.data());
+  fresh.encryptBlock(plain.data(), b.data());
+  return a == b;
+}
+
+bool check_lru(cube96::CubeCipher::Impl impl) {
+  // A single shard makes eviction order exact.
+  cube96::KeyContextCache cache(2, impl, cube96::kDefaultLayout, 1);
+  const Key k1 = make_key(1), k2 = make_key(2), k3 = make_key(3);
+
+  auto c1 = cache.get(k1.data());
+  auto c2 = cache.get(k2.data());
+  if (cache.get(k1.data()) != c1) {
+    std::cerr << "Cache hit returned a different context\n";
+    return false;
+  }
+  if (!matches_fresh(*c1, k1, impl) || !matches_fresh(*c2, k2, impl)) {
+    std::cerr << "Cached context disagrees with a fresh setKey\n";
+    return false;
+  }
+
+  // k2 is now least recently used, so k3 evicts it and k1 survives.
+  auto c3 = cache.get(k3.data());
+  if (cache.get(k1.data()) != c1) {
+    std::cerr << "Most recently used key was evicted\n";
+    return false;
+  }
+  auto c2_again = cache.get(k2.data());
+  if (c2_again == c2) {
+    std::cerr << "Least recently used key was not evicted\n";
+    return false;
+  }
+  // The evicted context stays usable by its holder.
+  if (!matches_fresh(*c2, k2, impl) || !matches_fresh(*c3, k3, impl)) {
+    std::cerr << "Evicted context no longer usable\n";
+    return false;
+  }
+
+  const auto stats = cache.stats();
+  if (stats.hits != 2 || stats.misses != 4 || stats.evictions != 2 || stats.size != 2) {
+    std::cerr << "Unexpected stats: hits=" << stats.hits << " misses=" << stats.misses
+              << " evictions=" << stats.evictions << " size=" << stats.size << "\n";
+    return false;
+  }
+
+  cache.clear();
+  if (cache.stats().size != 0 || cache.get(k1.data()) == c1) {
+    std::cerr << "clear() did not drop cached contexts\n";
+    return false;
+  }
+  return true;
+}
+
+bool check_sharding(cube96::CubeCipher::Impl impl) {
+  cube96::KeyContextCache cache(64, impl, cube96::kDefaultLayout, 8);
+  if (cache.capacity() != 64) {
+    std::cerr << "Unexpected capacity " << cache.capacity() << "\n";
+    return false;
+  }
+  for (std::uint32_t id = 0; id < 256; ++id) {
+    cache.get(make_key(id).data());
+  }
+  const auto stats = cache.stats();
+  if (stats.size > cache.capacity() || stats.misses != 256 ||
+      stats.evictions != 256 - stats.size) {
+    std::cerr << "Sharded cache exceeded its capacity\n";
+    return false;
+  }
+
+  cube96::KeyContextCache tiny(3, impl, cube96::kDefaultLayout, 16);
+  if (tiny.capacity() != 3) {
+    std::cerr << "Shard count not clamped to capacity\n";
+    return false;
+  }
+
+  // An uneven split must not round every shard up past the total.
+  cube96::KeyContextCache uneven(17, impl, cube96::kDefaultLayout, 16);
+  for (std::uint32_t id = 0; id < 256; ++id) {
+    uneven.get(make_key(id).data());
+  }
+  if (uneven.capacity() != 17 || uneven.stats().size > 17) {
+    std::cerr << "Uneven shard split exceeded capacity: " << uneven.stats().size << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool check_concurrent(cube96::CubeCipher::Impl impl) {
+  // Eight hot keys shared by four threads; every lookup must yield a context
+  // that encrypts like a fresh one, and only the first use of a key may miss;
+  // lookups that arrive during that expansion wait for it.
+  constexpr std::uint32_t kHotKeys = 8;
+  constexpr std::size_t kThreads = 4;
+  constexpr std::size_t kLookups = 400;
+  cube96::KeyContextCache cache(64, impl, cube96::kDefaultLayout, 4);
+
+  std::vector<std::array<std::uint8_t, kBlock>> expected(kHotKeys);
+  std::array<std::uint8_t, kBlock> plain{};
+  for (std::uint32_t id = 0; id < kHotKeys; ++id) {
+    cube96::CubeCipher fresh(impl);
+    fresh.setKey(make_key(id).data());
+    fresh.encryptBlock(plain.data(), expected[id].data());
+  }
+
+  std::atomic<bool> ok{true};
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937 rng(static_cast<std::uint32_t>(t + 1));
+      std::array<std::uint8_t, kBlock> out{};
+      for (std::size_t i = 0; i < kLookups; ++i) {
+        const std::uint32_t id = rng() % kHotKeys;
+        auto cipher = cache.get(make_key(id).data());
+        cipher->encryptBlock(plain.data(), out.data());
+        if (out != expected[id]) {
+          ok = false;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  if (!ok) {
+    std::cerr << "Concurrent lookup returned a wrong context\n";
+    return false;
+  }
+
+  const auto stats = cache.stats();
+  if (stats.hits + stats.misses + stats.waits != kThreads * kLookups ||
+      stats.misses != kHotKeys || stats.waits > kHotKeys * (kThreads - 1) ||
+      stats.size != kHotKeys) {
+    std::cerr << "Unexpected concurrent stats: hits=" << stats.hits
+              << " misses=" << stats.misses << " waits=" << stats.waits
+              << " size=" << stats.size << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool check_stampede(cube96::CubeCipher::Impl impl) {
+  // Threads released together on one cold key must share a single expansion:
+  // exactly one miss, everyone else hits or waits for it.
+  constexpr std::size_t kThreads = 8;
+  cube96::KeyContextCache cache(16, impl);
+  const Key key = make_key(42);
+
+  std::atomic<std::size_t> ready{0};
+  std::vector<std::shared_ptr<const cube96::CubeCipher>> results(kThreads);
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      ready.fetch_add(1);
+      while (ready.load() < kThreads) {
+        std::this_thread::yield();
+      }
+      results[t] = cache.get(key.data());
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  const auto stats = cache.stats();
+  if (stats.misses != 1 || stats.hits + stats.waits != kThreads - 1 || stats.size != 1) {
+    std::cerr << "Unexpected stampede stats: hits=" << stats.hits << " misses=" << stats.misses
+              << " waits=" << stats.waits << " size=" << stats.size << "\n";
+    return false;
+  }
+  for (const auto &result : results) {
+    if (result != results[0]) {
+      std::cerr << "Stampede handed out more than one context\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  std::vector<cube96::CubeCipher::Impl> implementations;
+  if (cube96::CubeCipher::hasFastImpl()) {
+    implementations.push_back(cube96::CubeCipher::Impl::Fast);
+  }
+  if (cube96::CubeCipher::hasHardenedImpl()) {
+    implementations.push_back(cube96::CubeCipher::Impl::Hardened);
+  }
+  for (auto impl : implementations) {
+    if (!check_lru(impl) || !check_sharding(impl) || !check_concurrent(impl) ||
+        !check_stampede(impl)) {
+      return 1;
+    }
+  }
+
+  std::cout << "test_key_cache: OK\n";
+  return 0;
+}
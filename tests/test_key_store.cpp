@@ -0,0 +1,269 @@
+// SPDX-License-Identifier: MIT
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cube96/cipher.hpp"
+#include "cube96/key_store.hpp"
+
+namespace {
+
+constexpr std::size_t kBlock = cube96::CubeCipher::BlockBytes;
+constexpr std::size_t kBlocks = 70;  // more than one bitslice group
+using Impl = cube96::CubeCipher::Impl;
+using Usage = cube96::CubeCipher::Usage;
+
+struct Sample {
+  std::vector<std::uint8_t> plain;
+  std::vector<std::uint8_t> cipher_text;
+};
+
+// Encrypts and/or decrypts the sample as far as `usage` allows.
+bool agrees(const cube96::CubeCipher &cipher, const Sample &sample) {
+  std::vector<std::uint8_t> out(sample.plain.size());
+  if (cipher.usage() != Usage::DecryptOnly) {
+    cipher.encryptBlocks(sample.plain.data(), out.data(), kBlocks);
+    if (out != sample.cipher_text) {
+      return false;
+    }
+  }
+  if (cipher.usage() != Usage::EncryptOnly) {
+    cipher.decryptBlocks(sample.cipher_text.data(), out.data(), kBlocks);
+    if (out != sample.plain) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Fn>
+bool throws_invalid_argument(Fn &&fn) {
+  try {
+    fn();
+  } catch (const std::invalid_argument &) {
+    return true;
+  }
+  return false;
+}
+
+bool check_records(const std::vector<Impl> &impls, std::mt19937_64 &rng) {
+  std::array<std::uint8_t, cube96::CubeCipher::KeyBytes> key{};
+  for (auto &b : key) {
+    b = static_cast<std::uint8_t>(rng());
+  }
+  Sample sample;
+  sample.plain.resize(kBlocks * kBlock);
+  for (auto &b : sample.plain) {
+    b = static_cast<std::uint8_t>(rng());
+  }
+  cube96::CubeCipher reference(impls.front());
+  reference.setKey(key.data());
+  sample.cipher_text.resize(sample.plain.size());
+  reference.encryptBlocks(sample.plain.data(), sample.cipher_text.data(), kBlocks);
+
+  const Usage usages[] = {Usage::Both, Usage::EncryptOnly, Usage::DecryptOnly,
+                          Usage::LazyDecrypt};
+  // Every exporter/importer pairing, with and without tables: importers
+  // rebuild missing directions and foreign tables from the permutations.
+  for (Impl from_impl : impls) {
+    for (Usage from_usage : usages) {
+      cube96::CubeCipher source(from_impl, cube96::kDefaultLayout, from_usage);
+      source.setKey(key.data());
+      for (bool tables : {true, false}) {
+        const std::vector<std::uint8_t> record = source.exportExpandedKey(tables);
+        for (Impl to_impl : impls) {
+          for (Usage to_usage : usages) {
+            cube96::CubeCipher copy(to_impl, cube96::kDefaultLayout, to_usage);
+            copy.importExpandedKey(record.data(), record.size());
+            if (!agrees(copy, sample)) {
+              std::cerr << "Imported record disagrees (from " << source.engineName() << "/"
+                        << static_cast<int>(from_usage) << " to " << copy.engineName() << "/"
+                        << static_cast<int>(to_usage) << ", tables=" << tables << ")\n";
+              return false;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  cube96::CubeCipher source(impls.front());
+  source.setKey(key.data());
+  const std::vector<std::uint8_t> record = source.exportExpandedKey();
+  cube96::CubeCipher target(impls.front());
+  target.setKey(key.data());
+
+  const cube96::Layout other = cube96::kDefaultLayout == cube96::Layout::ZSlice
+                                   ? cube96::Layout::RowMajor
+                                   : cube96::Layout::ZSlice;
+  cube96::CubeCipher wrong_layout(impls.front(), other);
+  std::vector<std::uint8_t> bad = record;
+  bad[9] = 1;  // previous version, without a digest
+  std::vector<std::uint8_t> corrupt = record;
+  corrupt[40] ^= 0x01u;  // round key 0
+  std::vector<std::uint8_t> bad_perm = record;
+  bad_perm[144] = bad_perm[145];  // no longer a permutation
+  std::vector<std::uint8_t> bad_table = record;
+  bad_table[bad_table.size() - 100] ^= 0x01u;  // compiled tables, missed by one block
+  if (!throws_invalid_argument(
+          [&] { wrong_layout.importExpandedKey(record.data(), record.size()); }) ||
+      !throws_invalid_argument([&] { target.importExpandedKey(bad.data(), bad.size()); }) ||
+      !throws_invalid_argument(
+          [&] { target.importExpandedKey(corrupt.data(), corrupt.size()); }) ||
+      !throws_invalid_argument(
+          [&] { target.importExpandedKey(bad_perm.data(), bad_perm.size()); }) ||
+      !throws_invalid_argument(
+          [&] { target.importExpandedKey(bad_table.data(), bad_table.size()); }) ||
+      !throws_invalid_argument([&] { target.importExpandedKey(record.data(), 100); })) {
+    std::cerr << "Bad record accepted\n";
+    return false;
+  }
+  if (!agrees(target, sample)) {
+    std::cerr << "Failed import changed the context\n";
+    return false;
+  }
+
+  bool threw = false;
+  try {
+    cube96::CubeCipher unkeyed;
+    (void)unkeyed.exportExpandedKey();
+  } catch (const std::logic_error &) {
+    threw = true;
+  }
+  if (!threw) {
+    std::cerr << "Exporting an unkeyed context did not throw\n";
+    return false;
+  }
+  return true;
+}
+
+bool check_store(const std::vector<Impl> &impls, std::mt19937_64 &rng) {
+  const std::string path = "test_key_store.bin";
+  constexpr std::size_t kKeys = 5;
+  std::vector<cube96::CubeCipher> contexts;
+  std::vector<Sample> samples(kKeys);
+  std::vector<cube96::KeyStore::Entry> entries;
+  contexts.reserve(kKeys);
+  for (std::size_t i = 0; i < kKeys; ++i) {
+    std::array<std::uint8_t, cube96::CubeCipher::KeyBytes> key{};
+    for (auto &b : key) {
+      b = static_cast<std::uint8_t>(rng());
+    }
+    contexts.emplace_back(impls[i % impls.size()]);
+    contexts.back().setKey(key.data());
+    samples[i].plain.resize(kBlocks * kBlock);
+    for (auto &b : samples[i].plain) {
+      b = static_cast<std::uint8_t>(rng());
+    }
+    samples[i].cipher_text.resize(samples[i].plain.size());
+    contexts.back().encryptBlocks(samples[i].plain.data(), samples[i].cipher_text.data(),
+                                  kBlocks);
+  }
+  for (std::size_t i = 0; i < kKeys; ++i) {
+    entries.push_back({1000 - 7 * i, &contexts[i]});  // written out of id order
+  }
+
+  cube96::KeyStore::write(path, entries);
+  std::vector<cube96::CubeCipher> loaded;
+  {
+    cube96::KeyStore store(path);
+    if (store.size() != kKeys || store.contains(1) || !store.contains(1000)) {
+      std::cerr << "Unexpected key store index\n";
+      return false;
+    }
+    for (std::size_t i = 0; i < kKeys; ++i) {
+      for (Impl impl : impls) {
+        loaded.push_back(store.load(entries[i].id, impl));
+        if (!agrees(loaded.back(), samples[i])) {
+          std::cerr << "Key store context " << i << " disagrees\n";
+          return false;
+        }
+      }
+    }
+    // A context whose engine matches the stored tables borrows them.
+    if (loaded.front().memoryFootprint() >= contexts.front().memoryFootprint()) {
+      std::cerr << "Loaded context copied its tables\n";
+      return false;
+    }
+    bool threw = false;
+    try {
+      (void)store.load(1);
+    } catch (const std::out_of_range &) {
+      threw = true;
+    }
+    if (!threw) {
+      std::cerr << "Unknown id did not throw\n";
+      return false;
+    }
+  }
+  // The contexts keep the mapping alive after the store is gone.
+  for (std::size_t i = 0; i < loaded.size(); ++i) {
+    if (!agrees(loaded[i], samples[i / impls.size()])) {
+      std::cerr << "Loaded context failed after the store closed\n";
+      return false;
+    }
+  }
+
+  // A context that cannot export fails the write before any file is touched:
+  // the previous store survives and no temporary file is left behind.
+  cube96::CubeCipher unkeyed;
+  bool export_threw = false;
+  try {
+    cube96::KeyStore::write(path, {entries[0], {1, &unkeyed}});
+  } catch (const std::logic_error &) {
+    export_threw = true;
+  }
+  std::size_t stray = 0;
+  for (const auto &file : std::filesystem::directory_iterator(".")) {
+    const std::string name = file.path().filename().string();
+    stray += name != path && name.compare(0, path.size(), path) == 0 ? 1 : 0;
+  }
+  if (!export_threw || stray != 0 || cube96::KeyStore(path).size() != kKeys) {
+    std::cerr << "Failed export left the store or a temporary file behind\n";
+    return false;
+  }
+
+  bool threw = false;
+  try {
+    cube96::KeyStore::write(path, {entries[0], entries[0]});
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  std::remove(path.c_str());
+  if (!threw) {
+    std::cerr << "Duplicate ids accepted\n";
+    return false;
+  }
+  try {
+    cube96::KeyStore missing(path);
+    std::cerr << "Opening a missing store did not throw\n";
+    return false;
+  } catch (const std::runtime_error &) {
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(0x5707Eu);
+  std::vector<Impl> implementations;
+  if (cube96::CubeCipher::hasFastImpl()) {
+    implementations.push_back(Impl::Fast);
+  }
+  implementations.push_back(Impl::Hardened);
+  if (!check_records(implementations, rng) || !check_store(implementations, rng)) {
+    return 1;
+  }
+
+  std::cout << "test_key_store: OK\n";
+  return 0;
+}
@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "cube96/cipher.hpp"
+#include "cube96/ctr.hpp"
+
+namespace {
+
+constexpr std::size_t kBlock = cube96::CubeCipher::BlockBytes;
+constexpr std::size_t kBlocks = 100;  // more than one bitslice group
+using Usage = cube96::CubeCipher::Usage;
+
+template <typename Fn>
+bool throws_logic_error(Fn &&fn) {
+  try {
+    fn();
+  } catch (const std::logic_error &) {
+    return true;
+  }
+  return false;
+}
+
+bool check_impl(cube96::CubeCipher::Impl impl, std::mt19937_64 &rng) {
+  std::array<std::uint8_t, cube96::CubeCipher::KeyBytes> key{};
+  for (auto &b : key) {
+    b = static_cast<std::uint8_t>(rng());
+  }
+  std::vector<std::uint8_t> plain(kBlocks * kBlock);
+  for (auto &b : plain) {
+    b = static_cast<std::uint8_t>(rng());
+  }
+
+  cube96::CubeCipher both(impl);
+  both.setKey(key.data());
+  std::vector<std::uint8_t> cipher_text(plain.size());
+  both.encryptBlocks(plain.data(), cipher_text.data(), kBlocks);
+
+  // Single-direction contexts agree with the full one and refuse the other
+  // direction.
+  cube96::CubeCipher enc_only(impl, cube96::kDefaultLayout, Usage::EncryptOnly);
+  cube96::CubeCipher dec_only(impl, cube96::kDefaultLayout, Usage::DecryptOnly);
+  enc_only.setKey(key.data());
+  dec_only.setKey(key.data());
+  std::vector<std::uint8_t> out(plain.size());
+  enc_only.encryptBlocks(plain.data(), out.data(), kBlocks);
+  if (out != cipher_text) {
+    std::cerr << "EncryptOnly ciphertext mismatch\n";
+    return false;
+  }
+  dec_only.decryptBlocks(cipher_text.data(), out.data(), kBlocks);
+  if (out != plain) {
+    std::cerr << "DecryptOnly plaintext mismatch\n";
+    return false;
+  }
+  std::array<std::uint8_t, kBlock> block{};
+  dec_only.decryptBlock(cipher_text.data(), block.data());
+  if (!std::equal(block.begin(), block.end(), plain.begin())) {
+    std::cerr << "DecryptOnly single-block mismatch\n";
+    return false;
+  }
+  if (!throws_logic_error([&] { enc_only.decryptBlock(cipher_text.data(), block.data()); }) ||
+      !throws_logic_error([&] { enc_only.decryptBlocks(cipher_text.data(), out.data(), 1); }) ||
+      !throws_logic_error([&] { dec_only.encryptBlock(plain.data(), block.data()); }) ||
+      !throws_logic_error([&] { dec_only.encryptBlocks(plain.data(), out.data(), 1); })) {
+    std::cerr << "Wrong-direction call not rejected\n";
+    return false;
+  }
+  if (enc_only.memoryFootprint() >= both.memoryFootprint() ||
+      dec_only.memoryFootprint() >= both.memoryFootprint()) {
+    std::cerr << "Single-direction context is not smaller: " << enc_only.memoryFootprint()
+              << " / " << dec_only.memoryFootprint() << " vs " << both.memoryFootprint()
+              << " bytes\n";
+    return false;
+  }
+
+  // CTR runs on an encryptor's context.
+  cube96::CubeEncryptor encryptor(impl);
+  encryptor.setKey(key.data());
+  const std::uint8_t nonce[cube96::kCtrNonceBytes] = {1, 2, 3, 4, 5, 6, 7, 8};
+  std::vector<std::uint8_t> ctr_a(plain.size());
+  std::vector<std::uint8_t> ctr_b(plain.size());
+  cube96::CtrMode(encryptor.cipher(), nonce).crypt(plain.data(), ctr_a.data(), plain.size());
+  cube96::CtrMode(both, nonce).crypt(plain.data(), ctr_b.data(), plain.size());
+  if (ctr_a != ctr_b) {
+    std::cerr << "CTR over CubeEncryptor mismatch\n";
+    return false;
+  }
+  cube96::CubeDecryptor decryptor(impl);
+  decryptor.setKey(key.data());
+  decryptor.decryptBlocks(cipher_text.data(), out.data(), kBlocks);
+  if (out != plain) {
+    std::cerr << "CubeDecryptor mismatch\n";
+    return false;
+  }
+
+  // LazyDecrypt: the first decrypt calls race from several threads.
+  cube96::CubeCipher lazy(impl, cube96::kDefaultLayout, Usage::LazyDecrypt);
+  lazy.setKey(key.data());
+  const std::size_t lazy_before = lazy.memoryFootprint();
+  const cube96::CubeCipher early_copy = lazy;
+  std::atomic<bool> ok{true};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      std::vector<std::uint8_t> local(plain.size());
+      if (t % 2 == 0) {
+        lazy.decryptBlocks(cipher_text.data(), local.data(), kBlocks);
+      } else {
+        for (std::size_t i = 0; i < kBlocks; ++i) {
+          lazy.decryptBlock(cipher_text.data() + i * kBlock, local.data() + i * kBlock);
+        }
+      }
+      if (local != plain) {
+        ok = false;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  if (!ok) {
+    std::cerr << "LazyDecrypt concurrent first decrypt mismatch\n";
+    return false;
+  }
+  if (lazy.memoryFootprint() <= lazy_before) {
+    std::cerr << "LazyDecrypt did not build its decryption side\n";
+    return false;
+  }
+
+  // Copies taken before and after the lazy build both decrypt correctly.
+  const cube96::CubeCipher late_copy = lazy;
+  early_copy.decryptBlocks(cipher_text.data(), out.data(), kBlocks);
+  if (out != plain) {
+    std::cerr << "Copy of unbuilt LazyDecrypt context mismatch\n";
+    return false;
+  }
+  late_copy.decryptBlocks(cipher_text.data(), out.data(), kBlocks);
+  if (out != plain) {
+    std::cerr << "Copy of built LazyDecrypt context mismatch\n";
+    return false;
+  }
+
+  // Rekeying discards the decryption side built for the previous key.
+  key[0] ^= 0x01u;
+  lazy.setKey(key.data());
+  both.setKey(key.data());
+  both.encryptBlocks(plain.data(), cipher_text.data(), kBlocks);
+  lazy.decryptBlocks(cipher_text.data(), out.data(), kBlocks);
+  if (out != plain) {
+    std::cerr << "LazyDecrypt rekey mismatch\n";
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(0x05A9Eu);
+  std::vector<cube96::CubeCipher::Impl> implementations;
+  if (cube96::CubeCipher::hasFastImpl()) {
+    implementations.push_back(cube96::CubeCipher::Impl::Fast);
+  }
+  if (cube96::CubeCipher::hasHardenedImpl()) {
+    implementations.push_back(cube96::CubeCipher::Impl::Hardened);
+  }
+  for (auto impl : implementations) {
+    if (!check_impl(impl, rng)) {
+      return 1;
+    }
+  }
+
+  std::cout << "test_key_usage: OK\n";
+  return 0;
+}
@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: MIT
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cube96/cipher.hpp"
+#include "cube96/ctr.hpp"
+#include "cube96/metrics.hpp"
+
+namespace {
+
+using cube96::LatencyHistogram;
+using cube96::MetricsMode;
+using cube96::MetricsOp;
+
+constexpr std::size_t kBlock = cube96::CubeCipher::BlockBytes;
+
+// Every value lands in a bucket whose range contains it, and buckets stay
+// within 1/16 of their lower bound.
+bool check_buckets() {
+  std::vector<std::uint64_t> values;
+  for (std::uint64_t v = 0; v < 5000; ++v) {
+    values.push_back(v);
+  }
+  for (unsigned e = 12; e < 64; ++e) {
+    values.push_back((std::uint64_t{1} << e) - 1);
+    values.push_back(std::uint64_t{1} << e);
+    values.push_back((std::uint64_t{1} << e) + (std::uint64_t{1} << (e - 3)) + 5);
+  }
+  for (std::uint64_t v : values) {
+    const std::size_t b = LatencyHistogram::bucket_for(v);
+    if (b >= LatencyHistogram::kBuckets) {
+      std::cerr << "Bucket out of range for " << v << '\n';
+      return false;
+    }
+    if (b == LatencyHistogram::kBuckets - 1) {
+      continue;  // overflow bucket
+    }
+    const std::uint64_t lower = b == 0 ? 0 : LatencyHistogram::bucket_limit(b - 1);
+    const std::uint64_t limit = LatencyHistogram::bucket_limit(b);
+    if (v < lower || v >= limit || (lower >= 16 && (limit - lower) * 16 > lower)) {
+      std::cerr << "Value " << v << " misplaced in bucket " << b << '\n';
+      return false;
+    }
+  }
+  return true;
+}
+
+bool check_prometheus() {
+  cube96::MetricsSnapshot snapshot;
+  snapshot.blocks_encrypted = 7;
+  snapshot.bytes[static_cast<std::size_t>(MetricsMode::Ctr)] = 100;
+  LatencyHistogram &h = snapshot.latency[static_cast<std::size_t>(MetricsOp::SetKey)];
+  h.counts[LatencyHistogram::bucket_for(300)] = 2;  // between 256 and 512 ns
+  h.counts[LatencyHistogram::bucket_for(100000)] = 1;
+  h.count = 3;
+  h.sum_ns = 100600;
+  // An hour plus one nanosecond keeps its last digit.
+  snapshot.latency[static_cast<std::size_t>(MetricsOp::Ctr)].sum_ns = 3600000000001;
+  const std::string text = cube96::metrics_prometheus(snapshot);
+  const char *expected[] = {
+      "cube96_blocks_total{direction=\"encrypt\"} 7\n",
+      "cube96_bytes_total{mode=\"ctr\"} 100\n",
+      "cube96_latency_seconds_bucket{op=\"set_key\",le=\"0.000000256\"} 0\n",
+      "cube96_latency_seconds_bucket{op=\"set_key\",le=\"0.000000512\"} 2\n",
+      "cube96_latency_seconds_bucket{op=\"set_key\",le=\"1099.511627776\"} 3\n",
+      "cube96_latency_seconds_bucket{op=\"set_key\",le=\"+Inf\"} 3\n",
+      "cube96_latency_seconds_count{op=\"set_key\"} 3\n",
+      "cube96_latency_seconds_sum{op=\"set_key\"} 0.0001006\n",
+      "cube96_latency_seconds_sum{op=\"ctr\"} 3600.000000001\n",
+  };
+  for (const char *line : expected) {
+    if (text.find(line) == std::string::npos) {
+      std::cerr << "Prometheus output lacks: " << line << text;
+      return false;
+    }
+  }
+  if (h.percentile_ns(0.5) < 300 || h.percentile_ns(0.5) >= 320 ||
+      h.percentile_ns(1.0) < 100000 || h.percentile_ns(1.0) >= 100000 + 100000 / 16) {
+    std::cerr << "Unexpected percentiles\n";
+    return false;
+  }
+  return true;
+}
+
+bool check_counters() {
+  std::array<std::uint8_t, cube96::CubeCipher::KeyBytes> key{};
+  std::vector<std::uint8_t> keys(3 * cube96::CubeCipher::KeyBytes, 0x11);
+  std::vector<cube96::CubeCipher> batch(3);
+  std::vector<std::uint8_t> data(10 * kBlock, 0x42);
+  const std::uint8_t nonce[cube96::kCtrNonceBytes] = {1};
+
+  cube96::metrics_reset();
+  cube96::CubeCipher cipher;
+  cipher.setKey(key.data());
+  cube96::CubeCipher::setKeys(keys.data(), batch.size(), batch.data());
+  cipher.encryptBlock(data.data(), data.data());
+  cipher.encryptBlocks(data.data(), data.data(), 10);
+  cipher.decryptBlocks(data.data(), data.data(), 10);
+  cube96::CtrMode(cipher, nonce).crypt(data.data(), data.data(), 100);
+  const cube96::MetricsSnapshot s = cube96::metrics_snapshot();
+
+  if (!cube96::metrics_enabled()) {
+    if (s.blocks_encrypted != 0 || s.set_key_calls != 0 ||
+        s.latency[static_cast<std::size_t>(MetricsOp::SetKey)].count != 0) {
+      std::cerr << "Counters moved in a build without metrics\n";
+      return false;
+    }
+    return true;
+  }
+  auto bytes = [&](MetricsMode m) { return s.bytes[static_cast<std::size_t>(m)]; };
+  auto calls = [&](MetricsOp op) { return s.latency[static_cast<std::size_t>(op)].count; };
+  // CTR's 9 keystream blocks are engine work but CTR bytes, not ECB bytes.
+  if (s.blocks_encrypted != 1 + 10 + 9 || s.blocks_decrypted != 10 || s.set_key_calls != 4 ||
+      bytes(MetricsMode::SingleBlock) != kBlock || bytes(MetricsMode::Ecb) != 20 * kBlock ||
+      bytes(MetricsMode::Ctr) != 100 || calls(MetricsOp::SetKey) != 4 ||
+      calls(MetricsOp::EncryptBlocks) != 1 || calls(MetricsOp::DecryptBlocks) != 1 ||
+      calls(MetricsOp::Ctr) != 1) {
+    std::cerr << "Unexpected counters: " << cube96::metrics_prometheus(s);
+    return false;
+  }
+  cube96::metrics_reset();
+  if (cube96::metrics_snapshot().blocks_encrypted != 0) {
+    std::cerr << "metrics_reset left counts behind\n";
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  if (!check_buckets() || !check_prometheus() || !check_counters()) {
+    return 1;
+  }
+  std::cout << "test_metrics: OK\n";
+  return 0;
+}
@@ -0,0 +1,183 @@
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "cube96/cipher.hpp"
+#include "cube96/ctr.hpp"
+#include "cube96/parallel.hpp"
+
+namespace {
+
+constexpr std::size_t kBlock = cube96::CubeCipher::BlockBytes;
+
+// Runs tasks in reverse order on the calling thread and counts batches, to
+// check that a caller-supplied executor is honoured.
+class CountingExecutor : public cube96::Executor {
+public:
+  std::size_t concurrency() const override { return 3; }
+  void run(std::size_t count, const std::function<void(std::size_t)> &task) override {
+    ++batches;
+    for (std::size_t i = count; i-- > 0;) {
+      task(i);
+    }
+  }
+  std::size_t batches = 0;
+};
+
+bool check_pool() {
+  cube96::ThreadPool pool(4);
+  if (pool.concurrency() != 4) {
+    std::cerr << "Unexpected pool concurrency\n";
+    return false;
+  }
+  for (std::size_t count : {1u, 3u, 4u, 97u, 1000u}) {
+    std::vector<std::atomic<int>> hits(count);
+    pool.run(count, [&](std::size_t i) { hits[i].fetch_add(1); });
+    for (std::size_t i = 0; i < count; ++i) {
+      if (hits[i].load() != 1) {
+        std::cerr << "Task " << i << " of " << count << " ran " << hits[i].load()
+                  << " times\n";
+        return false;
+      }
+    }
+  }
+
+  // A batch submitted from inside one of the pool's tasks runs inline.
+  std::vector<std::atomic<int>> nested(8 * 5);
+  pool.run(8, [&](std::size_t outer) {
+    pool.run(5, [&](std::size_t inner) { nested[outer * 5 + inner].fetch_add(1); });
+  });
+  for (std::size_t i = 0; i < nested.size(); ++i) {
+    if (nested[i].load() != 1) {
+      std::cerr << "Nested task " << i << " ran " << nested[i].load() << " times\n";
+      return false;
+    }
+  }
+
+  bool threw = false;
+  try {
+    pool.run(16, [](std::size_t i) {
+      if (i == 7) {
+        throw std::runtime_error("task failure");
+      }
+    });
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  if (!threw) {
+    std::cerr << "Task exception not propagated\n";
+    return false;
+  }
+  return true;
+}
+
+bool check_impl(cube96::CubeCipher::Impl impl, std::mt19937_64 &rng) {
+  std::uniform_int_distribution<int> dist(0, 255);
+  std::array<std::uint8_t, cube96::CubeCipher::KeyBytes> key{};
+  for (auto &b : key) {
+    b = static_cast<std::uint8_t>(dist(rng));
+  }
+  cube96::CubeCipher cipher(impl);
+  cipher.setKey(key.data());
+
+  // Large enough to be split into several chunks.
+  const std::size_t blocks = 20011;
+  std::vector<std::uint8_t> plain(blocks * kBlock);
+  for (auto &b : plain) {
+    b = static_cast<std::uint8_t>(dist(rng));
+  }
+  std::vector<std::uint8_t> expected(plain.size());
+  cipher.encryptBlocks(plain.data(), expected.data(), blocks);
+
+  cube96::ThreadPool pool(3);
+  CountingExecutor counting;
+  std::vector<cube96::Executor *> executors = {&pool, &counting, nullptr};
+  for (auto *executor : executors) {
+    std::vector<std::uint8_t> buf = plain;
+    cube96::encrypt_blocks_parallel(cipher, buf.data(), buf.data(), blocks, executor);
+    if (buf != expected) {
+      std::cerr << "Parallel ECB encrypt mismatch for impl " << static_cast<int>(impl) << "\n";
+      return false;
+    }
+    cube96::decrypt_blocks_parallel(cipher, buf.data(), buf.data(), blocks, executor);
+    if (buf != plain) {
+      std::cerr << "Parallel ECB decrypt mismatch for impl " << static_cast<int>(impl) << "\n";
+      return false;
+    }
+  }
+  // Parallel calls made from the pool's own tasks must not deadlock.
+  std::vector<std::vector<std::uint8_t>> nested(3, plain);
+  pool.run(nested.size(), [&](std::size_t i) {
+    cube96::encrypt_blocks_parallel(cipher, nested[i].data(), nested[i].data(), blocks, &pool);
+  });
+  for (const auto &buf : nested) {
+    if (buf != expected) {
+      std::cerr << "Nested parallel encrypt mismatch for impl " << static_cast<int>(impl)
+                << "\n";
+      return false;
+    }
+  }
+  if (counting.batches != 2) {
+    std::cerr << "Caller executor not used\n";
+    return false;
+  }
+
+  // CTR from an unaligned offset must match the sequential CtrMode.
+  const std::uint8_t nonce[cube96::kCtrNonceBytes] = {1, 2, 3, 4, 5, 6, 7, 8};
+  const std::uint64_t offset = 12345;
+  const std::size_t len = plain.size() - 5;
+  std::vector<std::uint8_t> sequential(len);
+  cube96::CtrMode ctr(cipher, nonce, 77);
+  ctr.seek(offset);
+  ctr.crypt(plain.data(), sequential.data(), len);
+  std::vector<std::uint8_t> parallel(len);
+  cube96::ctr_crypt_parallel(cipher, nonce, 77, offset, plain.data(), parallel.data(), len,
+                             &pool);
+  if (parallel != sequential) {
+    std::cerr << "Parallel CTR mismatch for impl " << static_cast<int>(impl) << "\n";
+    return false;
+  }
+
+  bool threw = false;
+  try {
+    cube96::ctr_crypt_parallel(cipher, nonce, 0xFFFFFFFFu, 0, plain.data(), parallel.data(),
+                               kBlock + 1, &pool);
+  } catch (const std::out_of_range &) {
+    threw = true;
+  }
+  if (!threw) {
+    std::cerr << "Parallel CTR overflow not rejected\n";
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  if (!check_pool()) {
+    return 1;
+  }
+
+  std::mt19937_64 rng(0x9A7u);
+  std::vector<cube96::CubeCipher::Impl> implementations;
+  if (cube96::CubeCipher::hasFastImpl()) {
+    implementations.push_back(cube96::CubeCipher::Impl::Fast);
+  }
+  if (cube96::CubeCipher::hasHardenedImpl()) {
+    implementations.push_back(cube96::CubeCipher::Impl::Hardened);
+  }
+  for (auto impl : implementations) {
+    if (!check_impl(impl, rng)) {
+      return 1;
+    }
+  }
+
+  std::cout << "test_parallel: OK\n";
+  return 0;
+}
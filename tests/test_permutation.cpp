@@ -1,9 +1,12 @@
 #include <array>
+#include <utility>
 #include <iostream>
 
 #include "cube96/endian.hpp"
+#include "cube96/impl_dispatch.hpp"
 #include "cube96/key_schedule.hpp"
 #include "cube96/perm.hpp"
+#include "cube96/sbox.hpp"
 #include "cube96/types.hpp"
 
 int main() {
@@ -55,6 +58,57 @@ int main() {
       return 1;
     }
 
+    // Gather tables must agree with the bit-serial reference, with and
+    // without SubBytes folded in.
+    static cube96::GatherTable table;
+    static cube96::GatherTable folded;
+    cube96::compile_gather_table(perm, table);
+    cube96::compile_gather_table(perm, folded, cube96::AES_SBOX);
+    std::array<std::uint8_t, cube96::kBlockBytes> gathered{};
+    for (std::size_t sample = 0; sample < 64; ++sample) {
+      std::array<std::uint8_t, cube96::kBlockBytes> probe{};
+      for (auto &b : probe) {
+        b = static_cast<std::uint8_t>(rng.next() >> 56);
+      }
+      cube96::apply_permutation(perm, probe.data(), tmp.data());
+      cube96::apply_gather_table(table, probe.data(), gathered.data());
+      if (gathered != tmp) {
+        std::cerr << "Gather table mismatch at round " << r << "\n";
+        return 1;
+      }
+
+      auto substituted = probe;
+      for (auto &b : substituted) {
+        b = cube96::AES_SBOX[b];
+      }
+      cube96::apply_permutation(perm, substituted.data(), tmp.data());
+      cube96::apply_gather_table(folded, probe.data(), gathered.data());
+      if (gathered != tmp) {
+        std::cerr << "Folded gather table mismatch at round " << r << "\n";
+        return 1;
+      }
+    }
+
+    const cube96::BenesNetwork net = cube96::compile_benes_network(perm);
+    const cube96::BenesNetwork inv_net = cube96::compile_benes_network(inv);
+    for (std::size_t sample = 0; sample < 64; ++sample) {
+      std::array<std::uint8_t, cube96::kBlockBytes> probe{};
+      for (auto &b : probe) {
+        b = static_cast<std::uint8_t>(rng.next() >> 56);
+      }
+      cube96::apply_permutation(perm, probe.data(), tmp.data());
+      cube96::apply_benes_network(net, probe.data(), gathered.data());
+      if (gathered != tmp) {
+        std::cerr << "Benes network mismatch at round " << r << "\n";
+        return 1;
+      }
+      cube96::apply_benes_network(inv_net, gathered.data(), roundtrip.data());
+      if (roundtrip != probe) {
+        std::cerr << "Inverse Benes network mismatch at round " << r << "\n";
+        return 1;
+      }
+    }
+
     cube96::apply_permutation_ct(perm, state.data(), tmp.data());
     cube96::apply_permutation_ct(inv, tmp.data(), roundtrip.data());
     if (roundtrip != state) {
@@ -64,6 +118,74 @@ int main() {
     }
   }
 
+  // The pairwise table derivation must match composing the twelve primitives
+  // one at a time, in both layouts.
+  for (auto layout : {cube96::Layout::ZSlice, cube96::Layout::RowMajor}) {
+    const auto &layout_prims = cube96::primitive_set(layout);
+    for (std::size_t r = 0; r < cube96::kRoundCount; ++r) {
+      const std::uint64_t seed = cube96::load_be64(material.perm_seeds[r].data());
+      cube96::SplitMix64 rng(seed);
+      cube96::Permutation expected = cube96::identity_permutation();
+      for (std::size_t step = 0; step < cube96::kPrimitiveSteps; ++step) {
+        expected = cube96::compose(expected, layout_prims[rng.next() % layout_prims.size()]);
+      }
+      cube96::Permutation perm{};
+      cube96::Permutation inv{};
+      cube96::derive_round_permutation(seed, layout, &perm, &inv);
+      if (perm != expected || inv != cube96::invert(expected)) {
+        std::cerr << "Pairwise derivation mismatch in layout "
+                  << cube96::layout_name(layout) << " at round " << r << "\n";
+        return 1;
+      }
+    }
+  }
+
+  // Vector compose kernels against the scalar reference at every level.
+  cube96::SplitMix64 compose_rng(0xC0395Eu);
+  cube96::Permutation accum = cube96::identity_permutation();
+  for (int trial = 0; trial < 64; ++trial) {
+    cube96::Permutation step = cube96::identity_permutation();
+    for (std::size_t i = cube96::kPermSize - 1; i > 0; --i) {
+      const std::size_t j = static_cast<std::size_t>(compose_rng.next() % (i + 1));
+      std::swap(step[i], step[j]);
+    }
+    const cube96::Permutation expected = cube96::compose(accum, step);
+    for (auto level : {cube96::SimdLevel::Scalar, cube96::SimdLevel::Ssse3,
+                       cube96::SimdLevel::Avx2}) {
+      if (cube96::compose_vec(accum, step, level) != expected) {
+        std::cerr << "compose_vec mismatch at level " << cube96::simd_level_name(level)
+                  << "\n";
+        return 1;
+      }
+    }
+    accum = expected;
+  }
+
+  // Route arbitrary (not primitive-derived) permutations through the network,
+  // one single-bit probe per source position.
+  cube96::SplitMix64 shuffle_rng(0x5EED5EEDu);
+  for (int trial = 0; trial < 32; ++trial) {
+    cube96::Permutation perm = cube96::identity_permutation();
+    for (std::size_t i = cube96::kPermSize - 1; i > 0; --i) {
+      const std::size_t j = static_cast<std::size_t>(shuffle_rng.next() % (i + 1));
+      std::swap(perm[i], perm[j]);
+    }
+    const cube96::BenesNetwork net = cube96::compile_benes_network(perm);
+    for (std::uint8_t bit = 0; bit < cube96::kPermSize; ++bit) {
+      std::array<std::uint8_t, cube96::kBlockBytes> probe{};
+      cube96::set_bit(probe.data(), bit, 1);
+      std::array<std::uint8_t, cube96::kBlockBytes> out{};
+      cube96::apply_benes_network(net, probe.data(), out.data());
+      std::array<std::uint8_t, cube96::kBlockBytes> expected{};
+      cube96::set_bit(expected.data(), perm[bit], 1);
+      if (out != expected) {
+        std::cerr << "Benes routing failure for shuffled permutation " << trial
+                  << "\n";
+        return 1;
+      }
+    }
+  }
+
   std::cout << "test_permutation: OK\n";
   return 0;
 }
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: MIT
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cube96/cipher.hpp"
+#include "cube96/parallel.hpp"
+#include "cube96/profile.hpp"
+
+namespace {
+
+constexpr std::size_t kBlock = cube96::CubeCipher::BlockBytes;
+constexpr std::size_t kBlocks = 100;
+using Impl = cube96::CubeCipher::Impl;
+
+// Built before main(), so its workers exit during static destruction, after
+// anything the profiler created on first use is gone.
+cube96::ThreadPool static_pool(4);
+
+std::uint64_t total_calls(const cube96::ProfileTable &table) {
+  std::uint64_t calls = 0;
+  for (const auto &slot : table) {
+    for (const cube96::ProfileCounter &c : slot) {
+      calls += c.calls;
+    }
+  }
+  return calls;
+}
+
+// Every round of every direction records at least one stage for each path.
+bool covers_rounds(const cube96::ProfileTable &table) {
+  for (std::size_t r = 0; r < cube96::kRoundCount; ++r) {
+    std::uint64_t calls = 0;
+    for (const cube96::ProfileCounter &c : table[r]) {
+      calls += c.calls;
+    }
+    if (calls == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool check_engine(Impl impl) {
+  cube96::CubeCipher cipher(impl);
+  std::array<std::uint8_t, cube96::CubeCipher::KeyBytes> key{};
+  for (std::size_t i = 0; i < key.size(); ++i) {
+    key[i] = static_cast<std::uint8_t>(i * 5u + 1u);
+  }
+  cipher.setKey(key.data());
+  std::vector<std::uint8_t> data(kBlocks * kBlock, 0x5A);
+
+  for (bool batch : {false, true}) {
+    cube96::profile_reset();
+    if (batch) {
+      cipher.encryptBlocks(data.data(), data.data(), kBlocks);
+      cipher.decryptBlocks(data.data(), data.data(), kBlocks);
+    } else {
+      cipher.encryptBlock(data.data(), data.data());
+      cipher.decryptBlock(data.data(), data.data());
+    }
+    const cube96::ProfileSnapshot snapshot = cube96::profile_snapshot();
+    if (!cube96::profiling_enabled()) {
+      if (total_calls(snapshot.encrypt) != 0 || total_calls(snapshot.decrypt) != 0) {
+        std::cerr << "Counters moved in a build without profiling\n";
+        return false;
+      }
+      continue;
+    }
+    if (!covers_rounds(snapshot.encrypt) || !covers_rounds(snapshot.decrypt)) {
+      std::cerr << cipher.engineName() << (batch ? " batch" : " block")
+                << " path left a round unprofiled\n";
+      return false;
+    }
+  }
+
+  // Counts from other threads, including exited ones, reach the snapshot,
+  // and reset clears them.
+  cube96::profile_reset();
+  std::thread worker([&] {
+    std::array<std::uint8_t, kBlock> block{};
+    cipher.encryptBlock(block.data(), block.data());
+  });
+  worker.join();
+  const bool seen = total_calls(cube96::profile_snapshot().encrypt) != 0;
+  if (seen != cube96::profiling_enabled()) {
+    std::cerr << "Worker thread counts were " << (seen ? "" : "not ") << "reported\n";
+    return false;
+  }
+  cube96::profile_reset();
+  if (total_calls(cube96::profile_snapshot().encrypt) != 0) {
+    std::cerr << "profile_reset left counts behind\n";
+    return false;
+  }
+  return true;
+}
+
+// Every participant of the static pool records profile counts, so each worker
+// owns thread-local cells that are torn down when the pool is destroyed.
+bool profile_static_pool() {
+  cube96::CubeCipher cipher;
+  std::array<std::uint8_t, cube96::CubeCipher::KeyBytes> key{};
+  cipher.setKey(key.data());
+  const std::size_t participants = static_pool.concurrency();
+  std::atomic<std::size_t> started{0};
+  static_pool.run(participants, [&](std::size_t) {
+    std::array<std::uint8_t, kBlock> block{};
+    cipher.encryptBlock(block.data(), block.data());
+    // Hold this thread until every participant has a task.
+    started.fetch_add(1);
+    while (started.load() < participants) {
+      std::this_thread::yield();
+    }
+  });
+  return started.load() == participants;
+}
+
+} // namespace
+
+int main() {
+  if (!profile_static_pool()) {
+    std::cerr << "Static pool did not run every task\n";
+    return 1;
+  }
+  if (cube96::CubeCipher::hasFastImpl() && !check_engine(Impl::Fast)) {
+    return 1;
+  }
+  if (!check_engine(Impl::Hardened)) {
+    return 1;
+  }
+  std::cout << "test_profile: OK\n";
+  return 0;
+}
@@ -0,0 +1,134 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "cube96/bitslice.hpp"
+#include "cube96/impl_dispatch.hpp"
+#include "cube96/sbox.hpp"
+#include "cube96/state.hpp"
+
+namespace {
+
+bool check_level(cube96::SimdLevel level) {
+  // Lengths straddle the 16- and 32-byte vector widths so both the main loop
+  // and the padded tail are exercised; the offset breaks alignment.
+  const std::size_t lengths[] = {1, 12, 15, 16, 17, 31, 32, 33, 48, 96, 256, 300};
+  for (std::size_t len : lengths) {
+    for (std::size_t offset = 0; offset < 2; ++offset) {
+      std::vector<std::uint8_t> buf(len + offset);
+      for (std::size_t start = 0; start < 256; start += 64) {
+        for (std::size_t i = 0; i < len; ++i) {
+          buf[offset + i] = static_cast<std::uint8_t>(start + i * 7);
+        }
+        cube96::sub_bytes_vec(buf.data() + offset, len, level);
+        for (std::size_t i = 0; i < len; ++i) {
+          const auto x = static_cast<std::uint8_t>(start + i * 7);
+          if (buf[offset + i] != cube96::AES_SBOX[x]) {
+            std::cerr << "S-box mismatch at level " << cube96::simd_level_name(level)
+                      << " for input " << static_cast<int>(x) << "\n";
+            return false;
+          }
+        }
+        cube96::inv_sub_bytes_vec(buf.data() + offset, len, level);
+        for (std::size_t i = 0; i < len; ++i) {
+          if (buf[offset + i] != static_cast<std::uint8_t>(start + i * 7)) {
+            std::cerr << "Inverse S-box mismatch at level "
+                      << cube96::simd_level_name(level) << "\n";
+            return false;
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<std::uint8_t> all(256);
+  for (std::size_t i = 0; i < all.size(); ++i) {
+    all[i] = static_cast<std::uint8_t>(i);
+  }
+  cube96::inv_sub_bytes_vec(all.data(), all.size(), level);
+  for (std::size_t i = 0; i < all.size(); ++i) {
+    if (all[i] != cube96::AES_INV_SBOX[i]) {
+      std::cerr << "Inverse S-box table mismatch at level "
+                << cube96::simd_level_name(level) << " for input " << i << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool check_scalar_paths() {
+  for (unsigned x = 0; x < 256; ++x) {
+    const auto v = static_cast<std::uint8_t>(x);
+    if (cube96::aes_sbox_bitsliced(v) != cube96::AES_SBOX[x] ||
+        cube96::aes_inv_sbox_bitsliced(v) != cube96::AES_INV_SBOX[x]) {
+      std::cerr << "Bitsliced scalar S-box mismatch for input " << x << "\n";
+      return false;
+    }
+  }
+
+  // Four 64-lane words carry all 256 inputs through the plane circuits.
+  for (unsigned word = 0; word < 4; ++word) {
+    std::uint64_t u[8] = {};
+    for (unsigned lane = 0; lane < 64; ++lane) {
+      const unsigned x = word * 64 + lane;
+      for (unsigned b = 0; b < 8; ++b) {
+        u[b] |= static_cast<std::uint64_t>((x >> (7 - b)) & 1u) << lane;
+      }
+    }
+    std::uint64_t v[8];
+    for (unsigned b = 0; b < 8; ++b) {
+      v[b] = u[b];
+    }
+    cube96::sbox_bitsliced64(u);
+    cube96::inv_sbox_bitsliced64(v);
+    for (unsigned lane = 0; lane < 64; ++lane) {
+      unsigned fwd = 0;
+      unsigned inv = 0;
+      for (unsigned b = 0; b < 8; ++b) {
+        fwd = (fwd << 1) | static_cast<unsigned>((u[b] >> lane) & 1u);
+        inv = (inv << 1) | static_cast<unsigned>((v[b] >> lane) & 1u);
+      }
+      const unsigned x = word * 64 + lane;
+      if (fwd != cube96::AES_SBOX[x] || inv != cube96::AES_INV_SBOX[x]) {
+        std::cerr << "Plane S-box mismatch for input " << x << "\n";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool check_state_entry_points() {
+  const cube96::State96 s{0x0123456789ABCDEFull, 0xF00DFACEu};
+  const cube96::State96 expected =
+      cube96::map_state_bytes(s, [](std::uint8_t v) { return cube96::AES_SBOX[v]; });
+  const cube96::State96 substituted = cube96::sub_state_hardened(s);
+  if (!(substituted == expected) || !(cube96::inv_sub_state_hardened(substituted) == s)) {
+    std::cerr << "State S-box mismatch\n";
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  if (!check_scalar_paths() || !check_state_entry_points()) {
+    return 1;
+  }
+
+  const cube96::SimdLevel levels[] = {cube96::SimdLevel::Scalar, cube96::SimdLevel::Ssse3,
+                                      cube96::SimdLevel::Avx2};
+  for (auto level : levels) {
+    if (level > cube96::detected_simd_level()) {
+      break;
+    }
+    if (!check_level(level)) {
+      return 1;
+    }
+  }
+
+  std::cout << "test_sbox: OK (" << cube96::simd_level_name(cube96::detected_simd_level())
+            << ")\n";
+  return 0;
+}
@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <array>
 #include <cctype>
 #include <fstream>
+#include <initializer_list>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -38,27 +40,21 @@ struct Vector {
   std::array<std::uint8_t, cube96::CubeCipher::BlockBytes> cipher{};
 };
 
-} // namespace
-
-int main() {
-#if defined(CUBE96_LAYOUT_ROWMAJOR)
-  const std::string kat_path = std::string(CUBE96_PROJECT_ROOT) +
-                               "/vectors/cube96_kats_rowmajor.csv";
-#else
-  const std::string kat_path = std::string(CUBE96_PROJECT_ROOT) +
-                               "/vectors/cube96_kats_zslice.csv";
-#endif
+bool check_layout(cube96::Layout layout,
+                  const std::vector<cube96::CubeCipher::Impl> &implementations) {
+  const std::string kat_path = std::string(CUBE96_PROJECT_ROOT) + "/vectors/cube96_kats_" +
+                               cube96::layout_name(layout) + ".csv";
 
   std::ifstream kat_file(kat_path);
   if (!kat_file) {
     std::cerr << "Unable to open KAT file: " << kat_path << "\n";
-    return 1;
+    return false;
   }
 
   std::string line;
   if (!std::getline(kat_file, line)) {
     std::cerr << "KAT file is empty: " << kat_path << "\n";
-    return 1;
+    return false;
   }
 
   std::vector<Vector> vectors;
@@ -82,55 +78,96 @@ int main() {
     Vector vec;
     if (!parse_hex(key_hex, vec.key)) {
       std::cerr << "Invalid key hex in KAT: " << key_hex << "\n";
-      return 1;
+      return false;
     }
     if (!parse_hex(plain_hex, vec.plain)) {
       std::cerr << "Invalid plaintext hex in KAT: " << plain_hex << "\n";
-      return 1;
+      return false;
     }
     if (!parse_hex(cipher_hex, vec.cipher)) {
       std::cerr << "Invalid ciphertext hex in KAT: " << cipher_hex << "\n";
-      return 1;
+      return false;
     }
     vectors.push_back(vec);
   }
 
   if (vectors.empty()) {
     std::cerr << "No KAT entries found in " << kat_path << "\n";
-    return 1;
-  }
-
-  std::vector<cube96::CubeCipher::Impl> implementations;
-  if (cube96::CubeCipher::hasFastImpl()) {
-    implementations.push_back(cube96::CubeCipher::Impl::Fast);
-  }
-  if (cube96::CubeCipher::hasHardenedImpl()) {
-    implementations.push_back(cube96::CubeCipher::Impl::Hardened);
-  }
-
-  if (implementations.empty()) {
-    std::cerr << "No cipher implementations available for testing\n";
-    return 1;
+    return false;
   }
 
   for (const auto &vec : vectors) {
     for (auto impl : implementations) {
-      cube96::CubeCipher cipher(impl);
+      cube96::CubeCipher cipher(impl, layout);
       cipher.setKey(vec.key.data());
       std::array<std::uint8_t, cube96::CubeCipher::BlockBytes> out{};
       cipher.encryptBlock(vec.plain.data(), out.data());
       if (out != vec.cipher) {
         std::cerr << "Ciphertext mismatch for implementation "
-                  << static_cast<int>(impl) << "\n";
-        return 1;
+                  << static_cast<int>(impl) << " (" << cube96::layout_name(layout)
+                  << ")\n";
+        return false;
       }
       std::array<std::uint8_t, cube96::CubeCipher::BlockBytes> recovered{};
       cipher.decryptBlock(vec.cipher.data(), recovered.data());
       if (recovered != vec.plain) {
         std::cerr << "Decrypt mismatch for implementation "
-                  << static_cast<int>(impl) << "\n";
-        return 1;
+                  << static_cast<int>(impl) << " (" << cube96::layout_name(layout)
+                  << ")\n";
+        return false;
       }
+
+      // Batch path (bitsliced for Impl::Hardened) with the vector in a lane
+      // other than zero.
+      std::array<std::uint8_t, 3 * cube96::CubeCipher::BlockBytes> batch{};
+      std::copy(vec.plain.begin(), vec.plain.end(),
+                batch.begin() + cube96::CubeCipher::BlockBytes);
+      cipher.encryptBlocks(batch.data(), batch.data(), 3);
+      if (!std::equal(vec.cipher.begin(), vec.cipher.end(),
+                      batch.begin() + cube96::CubeCipher::BlockBytes)) {
+        std::cerr << "Batch ciphertext mismatch for implementation "
+                  << static_cast<int>(impl) << " (" << cube96::layout_name(layout)
+                  << ")\n";
+        return false;
+      }
+      cipher.decryptBlocks(batch.data(), batch.data(), 3);
+      if (!std::equal(vec.plain.begin(), vec.plain.end(),
+                      batch.begin() + cube96::CubeCipher::BlockBytes)) {
+        std::cerr << "Batch decrypt mismatch for implementation "
+                  << static_cast<int>(impl) << " (" << cube96::layout_name(layout)
+                  << ")\n";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  std::vector<cube96::CubeCipher::Impl> implementations;
+  if (cube96::CubeCipher::hasFastImpl()) {
+    implementations.push_back(cube96::CubeCipher::Impl::Fast);
+  }
+  if (cube96::CubeCipher::hasHardenedImpl()) {
+    implementations.push_back(cube96::CubeCipher::Impl::Hardened);
+  }
+
+  if (implementations.empty()) {
+    std::cerr << "No cipher implementations available for testing\n";
+    return 1;
+  }
+
+  // One build serves both layouts; the default-constructed cipher follows the
+  // configure-time choice.
+  if (cube96::CubeCipher().layout() != cube96::kDefaultLayout) {
+    std::cerr << "Default layout mismatch\n";
+    return 1;
+  }
+  for (auto layout : {cube96::Layout::ZSlice, cube96::Layout::RowMajor}) {
+    if (!check_layout(layout, implementations)) {
+      return 1;
     }
   }
 
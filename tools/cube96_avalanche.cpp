@@ -0,0 +1,537 @@
+// SPDX-License-Identifier: MIT
+
+// Strict avalanche (SAC) and bit independence (BIC) analyzer.  For random keys
+// and plaintexts it flips each of the 96 plaintext bits, or each of the 96 key
+// bits, and counts which state bits change after every round.  The result is
+// a 96x96 flip-probability matrix per round; a cipher with full diffusion
+// reaches 0.5 in every cell.  For the full cipher it also measures how
+// independently pairs of output bits change (the bit independence criterion).
+//
+// Blocks run 64 at a time through a bitsliced round loop that keeps the state
+// in bit order and records it after each round.  The 64 lanes of a batch share
+// one key (per-lane keys would need per-lane permutations), so a run covers
+// samples / 64 keys, and key flips reuse the batch's plaintexts.  Samples in a
+// batch are therefore not independent; batches are, so |z| takes its standard
+// error from the spread of the per-batch flip counts.  It uses the library's
+// key derivation, round permutations and S-box circuit, and is checked against
+// CubeCipher before any sampling starts.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cube96/bitslice.hpp"
+#include "cube96/cipher.hpp"
+#include "cube96/endian.hpp"
+#include "cube96/key_schedule.hpp"
+#include "cube96/perm.hpp"
+
+namespace {
+
+using cube96::BitPlanes;
+using cube96::kBlockBytes;
+using cube96::kKeyBytes;
+using cube96::kPermSize;
+using cube96::kRoundCount;
+
+constexpr char kWarning[] =
+    "Research cipher — NOT FOR PRODUCTION. Key size chosen for tractability, not "
+    "security.";
+
+constexpr std::size_t kLanes = cube96::kBitsliceLanes;
+constexpr std::size_t kPairs = kPermSize * (kPermSize - 1) / 2;
+constexpr std::size_t kCells = kPermSize * kPermSize;
+constexpr double kPi = 3.14159265358979323846;
+
+enum class Flip { Plaintext, Key };
+constexpr std::size_t kFlips = 2;
+
+const char *flip_name(Flip flip) { return flip == Flip::Plaintext ? "plaintext" : "key"; }
+
+struct Options {
+  std::uint64_t samples = 1u << 20;
+  std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  std::uint64_t seed = 1;
+  std::vector<Flip> flips{Flip::Plaintext, Flip::Key};
+  bool bic = true;
+  std::string matrix_dir;
+};
+
+inline unsigned popcount64(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<unsigned>(__builtin_popcountll(x));
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return static_cast<unsigned>((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// One key's round keys and encryption permutations, as CubeCipher derives
+// them.
+struct Schedule {
+  std::array<cube96::RoundKey, kRoundCount> round_keys{};
+  cube96::RoundKey post{};
+  std::array<cube96::Permutation, kRoundCount> perm{};
+};
+
+Schedule make_schedule(const cube96::DerivedMaterial &material) {
+  Schedule s;
+  s.round_keys = material.round_keys;
+  s.post = material.post_whitening;
+  for (std::size_t r = 0; r < kRoundCount; ++r) {
+    cube96::derive_round_permutation(cube96::load_be64(material.perm_seeds[r].data()),
+                                     cube96::kDefaultLayout, &s.perm[r], nullptr);
+  }
+  return s;
+}
+
+// trace[r][i] holds state bit i of every lane after round r + 1.  The last
+// entry includes the post-whitening key, so it is the ciphertext.
+using Trace = std::array<BitPlanes, kRoundCount>;
+
+void add_key(BitPlanes &planes, const cube96::RoundKey &rk) {
+  for (std::uint8_t i = 0; i < kPermSize; ++i) {
+    planes[i] ^= 0u - static_cast<std::uint64_t>(cube96::get_bit(rk.data(), i));
+  }
+}
+
+// The bitslice engine's round function, except that the permutation moves
+// planes instead of renaming them so every round's state is in bit order.
+void run_rounds(const Schedule &s, BitPlanes planes, Trace &trace) {
+  for (std::size_t r = 0; r < kRoundCount; ++r) {
+    add_key(planes, s.round_keys[r]);
+    for (std::size_t b = 0; b < kBlockBytes; ++b) {
+      cube96::sbox_bitsliced64(&planes[8 * b]);
+    }
+    BitPlanes &next = trace[r];
+    for (std::size_t i = 0; i < kPermSize; ++i) {
+      next[s.perm[r][i]] = planes[i];
+    }
+    planes = next;
+  }
+  add_key(trace[kRoundCount - 1], s.post);
+}
+
+// Flip counts summed over samples.  sac[flip][round][in][out] counts samples
+// where output bit `out` changed after flipping input bit `in`, and sac_sq
+// sums the squares of each batch's count for that cell; bic[flip][in][pair]
+// counts samples where both bits of an output pair changed in the full
+// cipher.
+struct Counts {
+  std::vector<std::uint64_t> sac;
+  std::vector<std::uint64_t> sac_sq;
+  std::vector<std::uint64_t> bic;
+
+  explicit Counts(bool with_bic)
+      : sac(kFlips * kRoundCount * kCells), sac_sq(sac.size()),
+        bic(with_bic ? kFlips * kPermSize * kPairs : 0) {}
+
+  static std::size_t index(Flip flip, std::size_t round, std::size_t in, std::size_t out) {
+    return ((static_cast<std::size_t>(flip) * kRoundCount + round) * kPermSize + in) * kPermSize +
+           out;
+  }
+  std::uint64_t cell(Flip flip, std::size_t round, std::size_t in, std::size_t out) const {
+    return sac[index(flip, round, in, out)];
+  }
+  std::uint64_t cell_sq(Flip flip, std::size_t round, std::size_t in, std::size_t out) const {
+    return sac_sq[index(flip, round, in, out)];
+  }
+  std::uint64_t *pairs(Flip flip, std::size_t in) {
+    return bic.data() + (static_cast<std::size_t>(flip) * kPermSize + in) * kPairs;
+  }
+
+  void add(Flip flip, std::size_t in, const Trace &base, const Trace &flipped) {
+    for (std::size_t r = 0; r < kRoundCount; ++r) {
+      std::uint64_t *row = &sac[index(flip, r, in, 0)];
+      std::uint64_t *row_sq = &sac_sq[index(flip, r, in, 0)];
+      for (std::size_t out = 0; out < kPermSize; ++out) {
+        const std::uint64_t changed = popcount64(base[r][out] ^ flipped[r][out]);
+        row[out] += changed;
+        row_sq[out] += changed * changed;
+      }
+    }
+    if (bic.empty()) {
+      return;
+    }
+    BitPlanes diff;
+    for (std::size_t out = 0; out < kPermSize; ++out) {
+      diff[out] = base[kRoundCount - 1][out] ^ flipped[kRoundCount - 1][out];
+    }
+    std::uint64_t *counts = pairs(flip, in);
+    for (std::size_t j = 0; j < kPermSize; ++j) {
+      for (std::size_t k = j + 1; k < kPermSize; ++k) {
+        *counts++ += popcount64(diff[j] & diff[k]);
+      }
+    }
+  }
+
+  void merge(const Counts &other) {
+    for (std::size_t i = 0; i < sac.size(); ++i) {
+      sac[i] += other.sac[i];
+      sac_sq[i] += other.sac_sq[i];
+    }
+    for (std::size_t i = 0; i < bic.size(); ++i) {
+      bic[i] += other.bic[i];
+    }
+  }
+};
+
+// Draws the base key and kLanes plaintexts of batch `index` from the seed, so
+// results do not depend on how batches are spread over threads.
+void draw_batch(std::uint64_t seed, std::uint64_t index, std::uint8_t key[kKeyBytes],
+                BitPlanes &plain) {
+  cube96::SplitMix64 rng(seed ^ (index * 0x9E3779B97F4A7C15ULL));
+  std::uint8_t bytes[kLanes * kBlockBytes];
+  for (std::size_t i = 0; i < kKeyBytes; ++i) {
+    key[i] = static_cast<std::uint8_t>(rng.next());
+  }
+  for (std::size_t i = 0; i < sizeof(bytes); i += 8) {
+    cube96::store_be64(rng.next(), bytes + i);
+  }
+  cube96::bitslice_pack(bytes, kLanes, plain);
+}
+
+void plaintext_batch(const Schedule &schedule, const BitPlanes &plain, Counts &counts) {
+  Trace base;
+  Trace flipped;
+  run_rounds(schedule, plain, base);
+  for (std::size_t in = 0; in < kPermSize; ++in) {
+    BitPlanes input = plain;
+    input[in] = ~input[in];
+    run_rounds(schedule, input, flipped);
+    counts.add(Flip::Plaintext, in, base, flipped);
+  }
+}
+
+void key_batch(const std::uint8_t key[kKeyBytes], const Schedule &schedule,
+               const BitPlanes &plain, Counts &counts) {
+  std::uint8_t keys[kPermSize * kKeyBytes];
+  for (std::size_t in = 0; in < kPermSize; ++in) {
+    std::memcpy(keys + in * kKeyBytes, key, kKeyBytes);
+    keys[in * kKeyBytes + cube96::byte_index_of_bit(static_cast<std::uint8_t>(in))] ^=
+        static_cast<std::uint8_t>(1u << cube96::bit_offset_in_byte(static_cast<std::uint8_t>(in)));
+  }
+  std::vector<cube96::DerivedMaterial> material(kPermSize);
+  cube96::derive_materials(keys, kPermSize, material.data());
+
+  Trace base;
+  Trace flipped;
+  run_rounds(schedule, plain, base);
+  for (std::size_t in = 0; in < kPermSize; ++in) {
+    run_rounds(make_schedule(material[in]), plain, flipped);
+    counts.add(Flip::Key, in, base, flipped);
+  }
+}
+
+bool wants(const Options &opts, Flip flip) {
+  return std::find(opts.flips.begin(), opts.flips.end(), flip) != opts.flips.end();
+}
+
+Counts run(const Options &opts, std::uint64_t batches) {
+  std::atomic<std::uint64_t> next{0};
+  std::vector<Counts> partial(opts.threads, Counts(opts.bic));
+  auto worker = [&](Counts &counts) {
+    std::uint8_t key[kKeyBytes];
+    BitPlanes plain;
+    for (std::uint64_t b = next.fetch_add(1); b < batches; b = next.fetch_add(1)) {
+      draw_batch(opts.seed, b, key, plain);
+      const Schedule schedule = make_schedule(cube96::derive_material(key));
+      if (wants(opts, Flip::Plaintext)) {
+        plaintext_batch(schedule, plain, counts);
+      }
+      if (wants(opts, Flip::Key)) {
+        key_batch(key, schedule, plain, counts);
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (std::size_t t = 1; t < opts.threads; ++t) {
+    threads.emplace_back(worker, std::ref(partial[t]));
+  }
+  worker(partial[0]);
+  for (std::thread &t : threads) {
+    t.join();
+  }
+  for (std::size_t t = 1; t < opts.threads; ++t) {
+    partial[0].merge(partial[t]);
+  }
+  return std::move(partial[0]);
+}
+
+// The round loop must reproduce CubeCipher exactly, or every matrix describes
+// some other cipher.
+bool round_loop_matches_cipher(std::uint64_t seed) {
+  std::uint8_t key[kKeyBytes];
+  BitPlanes plain;
+  draw_batch(seed, ~0ull, key, plain);
+  std::uint8_t blocks[kLanes * kBlockBytes];
+  std::uint8_t expected[kLanes * kBlockBytes];
+  cube96::bitslice_unpack(plain, blocks, kLanes);
+  cube96::CubeCipher cipher;
+  cipher.setKey(key);
+  cipher.encryptBlocks(blocks, expected, kLanes);
+
+  Trace trace;
+  run_rounds(make_schedule(cube96::derive_material(key)), plain, trace);
+  cube96::bitslice_unpack(trace[kRoundCount - 1], blocks, kLanes);
+  return std::memcmp(blocks, expected, sizeof(blocks)) == 0;
+}
+
+struct RoundStats {
+  double mean = 0.0;
+  double min = 1.0;
+  double max = 0.0;
+  double max_z = 0.0;  // largest |p - 0.5| in standard errors; NaN for one batch
+};
+
+// Batches are the independent units: a cell's standard error comes from the
+// variance of its per-batch counts, floored at the binomial variance of 64
+// independent fair flips so that cells stuck at 0 or 1 still get a finite z.
+RoundStats round_stats(const Counts &counts, Flip flip, std::size_t round, double n) {
+  RoundStats s;
+  const double batches = n / static_cast<double>(kLanes);
+  const double null_var = static_cast<double>(kLanes) * 0.25;
+  if (batches < 2.0) {
+    s.max_z = std::nan("");
+  }
+  for (std::size_t in = 0; in < kPermSize; ++in) {
+    for (std::size_t out = 0; out < kPermSize; ++out) {
+      const double sum = static_cast<double>(counts.cell(flip, round, in, out));
+      const double p = sum / n;
+      s.mean += p;
+      s.min = std::min(s.min, p);
+      s.max = std::max(s.max, p);
+      if (batches >= 2.0) {
+        const double sum_sq = static_cast<double>(counts.cell_sq(flip, round, in, out));
+        const double var = (sum_sq - sum * sum / batches) / (batches - 1.0);
+        const double se = std::sqrt(std::max(var, null_var) / batches) / kLanes;
+        s.max_z = std::max(s.max_z, std::fabs(p - 0.5) / se);
+      }
+    }
+  }
+  s.mean /= static_cast<double>(kCells);
+  return s;
+}
+
+// Correlation between the change indicators of output bits j and k under
+// flips of input bit `in`.  Zero when either bit always or never changes.
+double pair_correlation(const Counts &counts, Flip flip, std::size_t in, std::size_t j,
+                        std::size_t k, std::uint64_t both, double n) {
+  const std::size_t last = kRoundCount - 1;
+  const double a = static_cast<double>(counts.cell(flip, last, in, j));
+  const double b = static_cast<double>(counts.cell(flip, last, in, k));
+  const double var = a * (n - a) * b * (n - b);
+  return var > 0.0 ? (n * static_cast<double>(both) - a * b) / std::sqrt(var) : 0.0;
+}
+
+struct BicStats {
+  double mean_abs = 0.0;
+  double max_abs = 0.0;
+  std::size_t in = 0;
+  std::size_t j = 0;
+  std::size_t k = 0;
+  std::vector<double> worst;  // kCells: max |corr| over input bits per pair
+};
+
+BicStats bic_stats(Counts &counts, Flip flip, double n) {
+  BicStats s;
+  s.worst.assign(kCells, 0.0);
+  for (std::size_t in = 0; in < kPermSize; ++in) {
+    const std::uint64_t *both = counts.pairs(flip, in);
+    for (std::size_t j = 0; j < kPermSize; ++j) {
+      for (std::size_t k = j + 1; k < kPermSize; ++k) {
+        const double c = std::fabs(pair_correlation(counts, flip, in, j, k, *both++, n));
+        s.mean_abs += c;
+        if (c > s.max_abs) {
+          s.max_abs = c;
+          s.in = in;
+          s.j = j;
+          s.k = k;
+        }
+        double &worst = s.worst[j * kPermSize + k];
+        worst = std::max(worst, c);
+        s.worst[k * kPermSize + j] = worst;
+      }
+    }
+  }
+  s.mean_abs /= static_cast<double>(kPermSize * kPairs);
+  return s;
+}
+
+bool write_matrix(const std::string &path, const double *cells) {
+  std::ofstream file(path);
+  if (!file) {
+    std::cerr << "Cannot write " << path << ": " << std::strerror(errno) << '\n';
+    return false;
+  }
+  file << std::setprecision(6);
+  for (std::size_t row = 0; row < kPermSize; ++row) {
+    for (std::size_t col = 0; col < kPermSize; ++col) {
+      file << (col == 0 ? "" : ",") << cells[row * kPermSize + col];
+    }
+    file << '\n';
+  }
+  return static_cast<bool>(file);
+}
+
+bool report(const Options &opts, Counts &counts, double n) {
+  std::cout << std::fixed;
+  for (Flip flip : opts.flips) {
+    std::cout << '\n'
+              << flip_name(flip) << " flips, " << static_cast<std::uint64_t>(n)
+              << " samples per input bit over " << static_cast<std::uint64_t>(n) / kLanes
+              << " keys (expect p = 0.5, |z| < ~4.5 over " << kCells
+              << " cells; z needs at least 2 keys)\n"
+              << "round    mean p     min p     max p   max |z|\n";
+    for (std::size_t r = 0; r < kRoundCount; ++r) {
+      const RoundStats s = round_stats(counts, flip, r, n);
+      std::cout << std::setw(5) << r + 1 << std::setprecision(4) << std::setw(10) << s.mean
+                << std::setw(10) << s.min << std::setw(10) << s.max << std::setprecision(1)
+                << std::setw(10);
+      if (std::isnan(s.max_z)) {
+        std::cout << "n/a" << '\n';
+      } else {
+        std::cout << s.max_z << '\n';
+      }
+      if (!opts.matrix_dir.empty()) {
+        std::vector<double> cells(kCells);
+        for (std::size_t in = 0; in < kPermSize; ++in) {
+          for (std::size_t out = 0; out < kPermSize; ++out) {
+            cells[in * kPermSize + out] = static_cast<double>(counts.cell(flip, r, in, out)) / n;
+          }
+        }
+        if (!write_matrix(opts.matrix_dir + "/sac_" + flip_name(flip) + "_round" +
+                              std::to_string(r + 1) + ".csv",
+                          cells.data())) {
+          return false;
+        }
+      }
+    }
+    if (opts.bic) {
+      const BicStats s = bic_stats(counts, flip, n);
+      std::cout << "bit independence: mean |corr| " << std::setprecision(5) << s.mean_abs
+                << " (noise ~" << std::sqrt(2.0 / (kPi * n)) << "), max |corr| " << s.max_abs
+                << " at input " << s.in << ", outputs " << s.j << "/" << s.k << '\n';
+      if (!opts.matrix_dir.empty() &&
+          !write_matrix(opts.matrix_dir + "/bic_" + flip_name(flip) + ".csv", s.worst.data())) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int usage() {
+  std::cerr << "Usage: cube96_avalanche [options]\n"
+               "  --samples N       random plaintexts per input bit, rounded up to a multiple\n"
+               "                    of 64; each 64 share one random key, so a run uses\n"
+               "                    N / 64 keys (default 1048576)\n"
+               "  --flip LIST       plaintext,key (default both)\n"
+               "  --threads N       worker threads (default: all cores)\n"
+               "  --seed N          sampling seed (default 1)\n"
+               "  --no-bic          skip the bit independence statistics\n"
+               "  --matrix-dir DIR  write sac_<flip>_round<r>.csv and bic_<flip>.csv into DIR\n";
+  return EXIT_FAILURE;
+}
+
+bool parse_count(const std::string &text, std::uint64_t max, std::uint64_t &out) {
+  char *end = nullptr;
+  errno = 0;
+  const unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+  if (text.empty() || end == text.c_str() || *end != '\0' || errno != 0 || value > max) {
+    return false;
+  }
+  out = value;
+  return true;
+}
+
+bool parse_options(int argc, char **argv, Options &opts) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--no-bic") {
+      opts.bic = false;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const std::string value = argv[++i];
+    std::uint64_t n = 0;
+    if (arg == "--samples" && parse_count(value, 1ull << 40, n) && n > 0) {
+      opts.samples = n;
+    } else if (arg == "--threads" && parse_count(value, 1024, n)) {
+      opts.threads = n == 0 ? std::max(1u, std::thread::hardware_concurrency())
+                            : static_cast<std::size_t>(n);
+    } else if (arg == "--seed" && parse_count(value, ~0ull, n)) {
+      opts.seed = n;
+    } else if (arg == "--flip") {
+      opts.flips.clear();
+      std::stringstream ss(value);
+      std::string item;
+      while (std::getline(ss, item, ',')) {
+        if (item == "plaintext" || item == "key") {
+          const Flip flip = item == "key" ? Flip::Key : Flip::Plaintext;
+          if (std::find(opts.flips.begin(), opts.flips.end(), flip) == opts.flips.end()) {
+            opts.flips.push_back(flip);
+          }
+        } else {
+          return false;
+        }
+      }
+      if (opts.flips.empty()) {
+        return false;
+      }
+    } else if (arg == "--matrix-dir" && !value.empty()) {
+      opts.matrix_dir = value;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opts;
+  if (!parse_options(argc, argv, opts)) {
+    return usage();
+  }
+  std::cerr << kWarning << '\n';
+  if (!round_loop_matches_cipher(opts.seed)) {
+    std::cerr << "Round loop disagrees with CubeCipher; refusing to sample.\n";
+    return EXIT_FAILURE;
+  }
+
+  const std::uint64_t batches = (opts.samples + kLanes - 1) / kLanes;
+  const auto start = std::chrono::steady_clock::now();
+  Counts counts = run(opts, batches);
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // Each batch encrypts the base and one variant per input bit, 64 lanes each.
+  const double blocks = static_cast<double>(batches * kLanes * (kPermSize + 1)) *
+                        static_cast<double>(opts.flips.size());
+  std::cout << "Evaluated " << std::fixed << std::setprecision(0) << blocks << " blocks in "
+            << std::setprecision(2) << seconds << " s (" << std::setprecision(2)
+            << blocks / seconds / 1e6 << " M blocks/s, " << opts.threads << " threads)\n";
+  return report(opts, counts, static_cast<double>(batches * kLanes)) ? EXIT_SUCCESS
+                                                                     : EXIT_FAILURE;
+}